@@ -122,14 +122,14 @@ void Application::create() {
    
    PlyDataReader::getSingletonPtr()->readData(vertices.data(), indices.data());
 
-   glm::vec3 center;
+   // Centroid and lowest point of the mesh only, the last 4 vertices are reserved for the ground.
+   glm::vec3 center(0.0f);
    glm::float32 min_y = vertices[0].pos.y;
-   size_t i = 0;
-   for (; i < vertices.size()-4; i++) {
+   for (size_t i = 0; i < nVertices; i++) {
      center += vertices[i].pos;
      min_y = glm::min(min_y, vertices[i].pos.y);
    }
-   center /= vertices.size();
+   center /= static_cast<float>(nVertices);
 
 #ifdef ADD_GROUND
    float width = 400.0f;
@@ -150,19 +150,17 @@ void Application::create() {
    indices[3 * nFaces + 5] = nVertices + 3;
 #endif
 
-   for (size_t i = 0; i < vertices.size(); i++) {
-     vertices[i].pos -= center;
-   }
-
-   for (size_t i = 0; i < vertices.size(); i++) {
-
 #ifdef PORSCHE_MESH
-     vertices[i].pos *= 0.13;
+   const float scale = 0.13f;
 #elif defined(SPHERE_MESH)
-     vertices[i].pos *= m_arcBallRadius;
+   const float scale = static_cast<float>(m_arcBallRadius);
 #else
-     vertices[i].pos *= 5.0;
+   const float scale = 5.0f;
 #endif
+
+   // Recenter and scale in a single pass.
+   for (size_t i = 0; i < vertices.size(); i++) {
+     vertices[i].pos = (vertices[i].pos - center) * scale;
    }
 }
 
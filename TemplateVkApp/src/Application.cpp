@@ -6,6 +6,10 @@
 #include "plydatareader.h"
 #include "GraphicsPipeline.h"
 #include "MeshLoader.h"
+#include "MeshletBuilder.h"
+#include "IndexCodec.h"
+#include "MeshOptimizer.h"
+#include "MeshCache.h"
 
 // STD
 #include <iostream>
@@ -13,6 +17,7 @@
 #include <ctime>
 #include <random>
 #include <array>
+#include <string.h>
 
 // GL
 #include <glm/glm.hpp>
@@ -56,8 +61,13 @@ void Application::init(const unsigned int& width, const unsigned int& height)
 	std::vector<const char*> deviceExtensions;
 	deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 
+	std::vector<const char*> optionalDeviceExtensions;
+	optionalDeviceExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	optionalDeviceExtensions.push_back(VK_KHR_SHADER_ATOMIC_INT64_EXTENSION_NAME);
+
 	// initializes the renderer.
-	renderer.init("VkTemplateApp", extensions, deviceExtensions);
+	renderer.init("VkTemplateApp", extensions, deviceExtensions, optionalDeviceExtensions);
+	ShaderStage::setGLSLTargetApiVersion(renderer.getVkApiVersion());
 	
 	// create a window
     m_window = glfwCreateWindow(width, height, "VkTemplateApp", NULL, NULL);
@@ -105,79 +115,416 @@ void Application::init() {
 
 	cmdPool = renderer.createCommandPool();
 	cmdBuffer = renderer.createCommandBuffer(cmdPool);
+	computeCmdBuffer = renderer.createCommandBuffer(cmdPool);
 	semaphore = renderer.createSemaphore();
+
+	shaderVariants   = std::unique_ptr<ShaderVariantCache>(new ShaderVariantCache(renderer.getVkDevice()));
+	pipelineCache    = std::unique_ptr<GraphicsPipelineCache>(new GraphicsPipelineCache(renderer));
+	pipelineCompiler = std::unique_ptr<AsyncPipelineCompiler>(new AsyncPipelineCompiler());
+	gpuPrimitives    = std::unique_ptr<GpuPrimitives>(new GpuPrimitives(renderer, *shaderVariants));
 }
 
 void Application::create() {
-	MeshLoader meshLoader("data/bunny.ply");
+	const std::string meshFile = "data/bunny.ply";
+	const float meshSize = 5.0f;
+
+	// A streamed mesh is uploaded while the first frames are drawn, see updateMeshStreaming().
+	if (!meshStreaming || !startMeshStreaming(meshFile, meshSize))
+		createMesh(meshFile, meshSize);
+
+	createPointCloud();
+
+	initGraphicsPipeline();
+	if (meshStreamer == nullptr && meshDeformation)
+		initComputePipeline();
+}
+
+void Application::createMesh(const std::string& meshFile, float meshSize) {
+	// ============================================
+	// Processed mesh, cached next to the mesh file
+	// ============================================
+	const std::string meshCacheFile = MeshCache::getCachePath(meshFile);
+	const MeshLoader::ImportProfile meshImportProfile = MeshLoader::ImportProfile::Default;
+	const MeshCache::Options meshCacheOptions = { MeshLoader::getImportFlags(meshImportProfile), IndexCodec::MaxUInt16Vertices, meshOptimization ? 1u : 0u, meshSize };
+	uint64_t meshFileHash = MeshCache::getSourceHash(meshFile);
+
+	MeshCache meshCache;
+	MeshLoader meshLoader;
 	auto& vertices = meshLoader.vertices;
 	auto& indices = meshLoader.indices;
-	
+
+	if (meshCache.open(meshCacheFile, meshFileHash, meshCacheOptions))
+	{
+		meshCache.copyTo(meshLoader);
+		std::cout << "Loaded the mesh from " << meshCacheFile << "\n";
+	}
+	else
+	{
+		meshLoader = MeshLoader(meshFile, meshImportProfile);
+
+		// Sub meshes with more vertices than 16-bit indices address are split.
+		if (meshLoader.splitSubMeshes(IndexCodec::MaxUInt16Vertices))
+			std::cout << "Split the mesh into " << meshLoader.subMeshes.size() << " parts for 16-bit indices.\n";
+
+		// Triangle and vertex order for the post-transform cache, early-Z and vertex fetch. Runs before
+		// the meshlets are built, so the cached meshlets match the optimized order.
+		if (meshOptimization)
+		{
+			MeshOptimizer::CacheStats before = MeshOptimizer::analyzeVertexCache(meshLoader);
+			MeshOptimizer::optimize(meshLoader);
+			MeshOptimizer::CacheStats after = MeshOptimizer::analyzeVertexCache(meshLoader);
+
+			std::cout << "Mesh optimization: ACMR " << before.acmr << " -> " << after.acmr
+				<< ", ATVR " << before.atvr << " -> " << after.atvr << "\n";
+		}
+
+		// Move the mesh to the origin and scale it. One parallel sweep for the box and the centroid,
+		// one which recenters and scales.
+		MeshBounds meshBounds = MeshBounds::compute(vertices);
+		MeshBounds::normalize(vertices, meshBounds.centroid, meshSize);
+
+		if (meshFileHash != 0 && MeshCache::save(meshCacheFile, meshFileHash, meshCacheOptions, meshLoader, {}))
+			meshCache.open(meshCacheFile, meshFileHash, meshCacheOptions);
+	}
+
 	uint32_t nVertices = static_cast<uint32_t>(vertices.size());
 	uint32_t nFaces = static_cast<uint32_t>(indices.size() / 3);
 
 	assert(nVertices > 0);
 	assert(nFaces > 0);
 
-	glm::vec3 center;
-	glm::float32 min_y = vertices[0].position.y;
-	size_t i = 0;
-	for (; i < vertices.size()-4; i++)
+	// ============================================
+	// Create Vulkan Buffer for the mesh vertices
+	// ============================================
+	// Two buffers: the compute pass writes one while the other one is drawn.
+	for (auto& vertexBuffer : vertexBuffers)
 	{
-		center += vertices[i].position;
-		min_y = glm::min(min_y, vertices[i].position.y);
+		vertexBuffer = renderer.createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vertices.size() * sizeof(PlyObjVertex));
 	}
-	center /= vertices.size();
+   
+	// =============================
+	// Fill Vertex Buffer
+	// =============================
+	void* verticesData = renderer.getBufferAllocator()->mapBuffer(vertexBuffers[0]);
 
+	// The cache holds the vertices in this layout already.
+	static_assert(sizeof(PlyObjVertex) == sizeof(MeshLoader::Vertex), "The cached vertices are uploaded as they are");
+	if (meshCache.isOpen())
+	{
+		memcpy(verticesData, meshCache.getVertices(), meshCache.getVertexCount() * sizeof(PlyObjVertex));
+	}
+	else
+	{
+		for (size_t i = 0; i < vertices.size(); i++) {
+			PlyObjVertex& vertex = ((PlyObjVertex*)verticesData)[i];
+			vertex.pos		= vertices[i].position;
+			vertex.normal	= glm::normalize(vertices[i].normal);
+		}
+	}
+	renderer.getBufferAllocator()->unmapBuffer(vertexBuffers[0]);
 
-	for (size_t i = 0; i < vertices.size(); i++)
+	// =============================
+	// Quantized Vertex Buffer
+	// =============================
+	if (vertexQuantizationNormalBits > 0)
 	{
-		vertices[i].position -= center;
+		VertexQuantizer::NormalEncoding normalEncoding = vertexQuantizationNormalBits <= 8 ? VertexQuantizer::NormalOct8 : VertexQuantizer::NormalOct16;
+		vertexQuantizer = std::unique_ptr<VertexQuantizer>(new VertexQuantizer(MeshBounds::compute(vertices).aabb, normalEncoding));
+
+		std::vector<uint8_t> quantizedVertices = vertexQuantizer->quantize(vertices);
+		quantizedVertexBuffer = renderer.createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, quantizedVertices.size());
+
+		void* quantizedVerticesData = renderer.getBufferAllocator()->mapBuffer(quantizedVertexBuffer);
+		memcpy(quantizedVerticesData, quantizedVertices.data(), quantizedVertices.size());
+		renderer.getBufferAllocator()->unmapBuffer(quantizedVertexBuffer);
+
+		VertexQuantizer::Error quantizationError = vertexQuantizer->measureError(vertices, quantizedVertices);
+		std::cout << "Quantized vertices: " << vertexQuantizer->getVertexSize() << " instead of " << sizeof(PlyObjVertex) << " bytes"
+			<< ", position error max " << quantizationError.maxPositionError << " mean " << quantizationError.meanPositionError
+			<< ", normal error max " << quantizationError.maxNormalError << " degrees\n";
 	}
 
-	for (size_t i = 0; i < vertices.size(); i++)
+	this->nVertices = static_cast<uint32_t>(vertices.size());
+	this->nIndices = static_cast<uint32_t>(indices.size());
+
+	// ============================================
+	// 16-bit draw indices when every sub mesh fits
+	// ============================================
+	subMeshes = meshLoader.subMeshes;
+	drawIndexType = VK_INDEX_TYPE_UINT16;
+	for (auto& subMesh : subMeshes)
 	{
-		vertices[i].position *= 5.0;
+		if (subMesh.vertexCount > IndexCodec::MaxUInt16Vertices)
+			drawIndexType = VK_INDEX_TYPE_UINT32;
 	}
 
 	// ============================================
-	// Create Vulkan Buffer for the mesh vertices
+	// Culling objects, one per sub mesh
 	// ============================================
-	vertexBuffer = renderer.createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, vertices.size() * sizeof(PlyObjVertex));
-   
-	// =============================
-	// Fill Vertex Buffer
-	// =============================
-	void* verticesData = renderer.getBufferAllocator()->mapBuffer(vertexBuffer);
-	
-	for (size_t i = 0; i < vertices.size(); i++) {
-		PlyObjVertex& vertex = ((PlyObjVertex*)verticesData)[i];
-		vertex.pos		= vertices[i].position;
-		vertex.normal	= glm::normalize(vertices[i].normal);
+	// The compute deformation moves the vertices a bit along their normals, the margin keeps them inside.
+	const float deformationMargin = 0.1f;
+
+	std::vector<CullObject> cullObjects;
+	for (auto& subMesh : meshLoader.subMeshes)
+	{
+		glm::vec3 minPos = vertices[subMesh.firstVertex].position;
+		glm::vec3 maxPos = minPos;
+		for (uint32_t v = subMesh.firstVertex; v < subMesh.firstVertex + subMesh.vertexCount; v++)
+		{
+			minPos = glm::min(minPos, vertices[v].position);
+			maxPos = glm::max(maxPos, vertices[v].position);
+		}
+
+		glm::vec3 sphereCenter = 0.5f * (minPos + maxPos);
+		float sphereRadius = 0.0f;
+		for (uint32_t v = subMesh.firstVertex; v < subMesh.firstVertex + subMesh.vertexCount; v++)
+			sphereRadius = glm::max(sphereRadius, glm::length(vertices[v].position - sphereCenter));
+
+		CullObject cullObject{};
+		cullObject.boundingSphere = glm::vec4(sphereCenter, sphereRadius + deformationMargin);
+		cullObject.transform      = glm::mat4(1.0f);
+		cullObject.firstIndex     = subMesh.firstIndex;
+		cullObject.indexCount     = subMesh.indexCount;
+		cullObject.vertexOffset   = drawIndexType == VK_INDEX_TYPE_UINT16 ? static_cast<int32_t>(subMesh.firstVertex) : 0;
+		cullObjects.push_back(cullObject);
+	}
+
+	gpuCuller = std::unique_ptr<GpuCuller>(new GpuCuller(renderer, *shaderVariants));
+	if (!gpuCuller->isSupported())
+		std::cout << "GPU culling is not supported, drawing without culling.\n";
+
+	hiZPyramid = std::unique_ptr<HiZPyramid>(new HiZPyramid(renderer, *shaderVariants));
+	if (hiZPyramid->isSupported())
+		gpuCuller->setOcclusionPyramid(hiZPyramid.get());
+	else
+		std::cout << "The depth buffer cannot be sampled, drawing without occlusion culling.\n";
+
+	// ============================================
+	// Meshlets, cached next to the mesh file
+	// ============================================
+	if (gpuCuller->isSupported())
+	{
+		const std::string meshletFile = meshFile + ".meshlets";
+		uint64_t meshSourceHash = MeshletBuilder::getSourceHash(vertices, indices);
+
+		MeshletBuilder meshletBuilder;
+		if (!meshletBuilder.load(meshletFile, meshSourceHash))
+		{
+			meshletBuilder.build(meshLoader);
+			meshletBuilder.save(meshletFile, meshSourceHash);
+		}
+
+		// Meshlets are drawn with the vertexOffset of their object, like the whole sub meshes.
+		std::vector<uint32_t> meshletIndices = meshletBuilder.buildIndexBuffer();
+		size_t meshletIndexSize = drawIndexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+		meshletIndexBuffer = renderer.createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, meshletIndices.size() * meshletIndexSize);
+		hasMeshletIndexBuffer = true;
+
+		void* meshletIndicesData = renderer.getBufferAllocator()->mapBuffer(meshletIndexBuffer);
+		if (drawIndexType == VK_INDEX_TYPE_UINT16)
+		{
+			for (auto& meshlet : meshletBuilder.getMeshlets())
+			{
+				uint32_t firstIndex = MeshletBuilder::getFirstIndex(meshlet);
+				IndexCodec::toUInt16(meshletIndices.data() + firstIndex, MeshletBuilder::getIndexCount(meshlet),
+					subMeshes[meshlet.objectIndex].firstVertex, static_cast<uint16_t*>(meshletIndicesData) + firstIndex);
+			}
+		}
+		else
+		{
+			memcpy(meshletIndicesData, meshletIndices.data(), meshletIndices.size() * sizeof(uint32_t));
+		}
+		renderer.getBufferAllocator()->unmapBuffer(meshletIndexBuffer);
+
+		std::vector<CullMeshlet> cullMeshlets(meshletBuilder.getMeshlets().size());
+		for (size_t m = 0; m < cullMeshlets.size(); m++)
+		{
+			const MeshletBuilder::Meshlet& meshlet = meshletBuilder.getMeshlets()[m];
+			const MeshletBuilder::Bounds&  bounds  = meshletBuilder.getBounds()[m];
+
+			cullMeshlets[m].boundingSphere = glm::vec4(bounds.center, bounds.radius + deformationMargin);
+			cullMeshlets[m].cone           = glm::vec4(bounds.coneAxis, bounds.coneCutoff);
+			cullMeshlets[m].firstIndex     = MeshletBuilder::getFirstIndex(meshlet);
+			cullMeshlets[m].indexCount     = MeshletBuilder::getIndexCount(meshlet);
+			cullMeshlets[m].objectIndex    = meshlet.objectIndex;
+		}
+
+		gpuCuller->setMeshlets(cullMeshlets);
+
+		// The objects are drawn from the meshlet indices as well. The meshlets of an object are
+		// contiguous, but leave out its degenerate triangles.
+		for (auto& cullObject : cullObjects)
+			cullObject.indexCount = 0;
+		for (auto& meshlet : meshletBuilder.getMeshlets())
+		{
+			CullObject& cullObject = cullObjects[meshlet.objectIndex];
+			if (cullObject.indexCount == 0)
+				cullObject.firstIndex = MeshletBuilder::getFirstIndex(meshlet);
+			cullObject.indexCount += MeshletBuilder::getIndexCount(meshlet);
+		}
+		gpuCuller->setObjects(cullObjects);
+
+		if (meshletBackfaceCulling && meshDeformation)
+			std::cout << "Meshlet back-face culling is off while the mesh is deformed\n";
+		gpuCuller->setBackfaceCulling(meshletBackfaceCulling && !meshDeformation);
+
+		std::cout << "Meshlets: " << cullMeshlets.size() << "\n";
 	}
-	renderer.getBufferAllocator()->unmapBuffer(vertexBuffer);
 
 	// ============================================
-	// Create Vulkan Buffer for the mesh indices
+	// Draw indices, unless the meshlet indices are drawn
 	// ============================================
-	indexBuffer = renderer.createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indices.size() * sizeof(unsigned int));
+	if (!hasMeshletIndexBuffer && drawIndexType == VK_INDEX_TYPE_UINT16)
+	{
+		drawIndexBuffer = renderer.createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indices.size() * sizeof(uint16_t));
+
+		uint16_t* drawIndicesData = static_cast<uint16_t*>(renderer.getBufferAllocator()->mapBuffer(drawIndexBuffer));
+		if (meshCache.isOpen() && meshCache.getDrawIndices() != nullptr)
+		{
+			memcpy(drawIndicesData, meshCache.getDrawIndices(), indices.size() * sizeof(uint16_t));
+		}
+		else
+		{
+			for (auto& subMesh : subMeshes)
+				IndexCodec::toUInt16(indices.data() + subMesh.firstIndex, subMesh.indexCount, subMesh.firstVertex, drawIndicesData + subMesh.firstIndex);
+		}
+		renderer.getBufferAllocator()->unmapBuffer(drawIndexBuffer);
+		hasDrawIndexBuffer = true;
+	}
 
-	// =============================
-	// Fill Index Buffer
-	// =============================
-	void* indicesData = renderer.getBufferAllocator()->mapBuffer(indexBuffer);
-	for (size_t i = 0; i < indices.size(); i++) {
-		unsigned int& index = ((unsigned int*)indicesData)[i];
-		index = indices[i];
+	// ============================================
+	// 32-bit indices, for the compute passes or when the draws need them
+	// ============================================
+	if (meshDeformation || (!hasMeshletIndexBuffer && drawIndexType == VK_INDEX_TYPE_UINT32))
+	{
+		indexBuffer = renderer.createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, indices.size() * sizeof(unsigned int));
+
+		// =============================
+		// Fill Index Buffer
+		// =============================
+		void* indicesData = renderer.getBufferAllocator()->mapBuffer(indexBuffer);
+		if (meshCache.isOpen())
+		{
+			memcpy(indicesData, meshCache.getIndices(), meshCache.getIndexCount() * sizeof(unsigned int));
+		}
+		else
+		{
+			for (size_t i = 0; i < indices.size(); i++) {
+				unsigned int& index = ((unsigned int*)indicesData)[i];
+				index = indices[i];
+			}
+		}
+		renderer.getBufferAllocator()->unmapBuffer(indexBuffer);
+		hasIndexBuffer = true;
 	}
-	renderer.getBufferAllocator()->unmapBuffer(indexBuffer);
+}
 
-	this->nVertices = static_cast<uint32_t>(vertices.size());
-	this->nIndices = static_cast<uint32_t>(indices.size());
+void Application::createPointCloud() {
+	// ============================================
+	// Point cloud, drawn next to the mesh
+	// ============================================
+	// Optional, a PLY file with vertices only. The points are rasterized in compute.
+	const std::string pointCloudFile = "data/points.ply";
+	pointCloudRenderer = std::unique_ptr<PointCloudRenderer>(new PointCloudRenderer(renderer, *shaderVariants, *pipelineCache));
 
+	PlyDataReader plyReader;
+	if (pointCloudRenderer->isSupported() && std::ifstream(pointCloudFile).good() &&
+		plyReader.readDataInfo(pointCloudFile.c_str()) && plyReader.getNumVertices() > 0)
+	{
+		std::vector<PointCloudRenderer::Point> points(static_cast<size_t>(plyReader.getNumVertices()));
+		plyReader.readPointData(points.data(), sizeof(PointCloudRenderer::Point));
+
+		// Centered and scaled into the size of the mesh.
+		glm::vec3 minPos = points[0].position;
+		glm::vec3 maxPos = minPos;
+		for (auto& point : points)
+		{
+			minPos = glm::min(minPos, point.position);
+			maxPos = glm::max(maxPos, point.position);
+		}
+
+		glm::vec3 pointsCenter = 0.5f * (minPos + maxPos);
+		float pointsExtent = glm::max(glm::max(maxPos.x - minPos.x, maxPos.y - minPos.y), maxPos.z - minPos.z);
+		float pointsScale = pointsExtent > 0.0f ? 1.0f / pointsExtent : 1.0f;
+		for (auto& point : points)
+			point.position = (point.position - pointsCenter) * pointsScale;
+
+		pointCloudRenderer->addPoints(points.data(), points.size());
+
+		std::cout << "Points: " << pointCloudRenderer->getNumPoints()
+			<< (pointCloudRenderer->usesInt64Atomics() ? " (64-bit atomics)" : " (two pass)") << "\n";
+	}
+}
 
-	initGraphicsPipeline();
-	initComputePipeline();
+bool Application::startMeshStreaming(const std::string& meshFile, float meshSize) {
+	meshStreamer = std::unique_ptr<MeshStreamer>(new MeshStreamer(meshFile, meshSize));
+	if (!meshStreamer->isStarted())
+	{
+		std::cout << "[ERROR] Cannot stream " << meshFile << ", loading it as a whole." << std::endl;
+		meshStreamer.reset(nullptr);
+		return false;
+	}
+
+	// Full size from the header, the chunks are copied into place as they arrive. Nothing is drawn
+	// before the first indices.
+	nVertices = meshStreamer->getNumVertices();
+	nIndices  = 0;
+
+	for (auto& vertexBuffer : vertexBuffers)
+		vertexBuffer = renderer.createBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, nVertices * sizeof(PlyObjVertex));
+	indexBuffer = renderer.createBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshStreamer->getNumIndices() * sizeof(unsigned int));
+	hasIndexBuffer = true;
+
+	std::cout << "Streaming " << meshFile << ": " << nVertices << " vertices, " << meshStreamer->getNumIndices() / 3 << " triangles\n";
+	return true;
+}
+
+void Application::updateMeshStreaming() {
+	// A frame copies at most this much, the worker may be far ahead.
+	const size_t maxUploadBytes = 16 << 20;
+
+	// The ranges are written before the frame which draws them is submitted and are not read by the
+	// frames in flight: the draw count only covers indices which arrived before, and every vertex
+	// arrives before the first index.
+	size_t uploadedBytes = 0;
+	MeshStreamer::Chunk chunk;
+	while (uploadedBytes < maxUploadBytes && meshStreamer->pop(chunk))
+	{
+		if (!chunk.vertices.empty())
+		{
+			static_assert(sizeof(PlyObjVertex) == sizeof(MeshLoader::Vertex), "The streamed vertices are uploaded as they are");
+			void* verticesData = renderer.getBufferAllocator()->mapBuffer(vertexBuffers[0]);
+			memcpy(static_cast<PlyObjVertex*>(verticesData) + chunk.firstVertex, chunk.vertices.data(), chunk.vertices.size() * sizeof(PlyObjVertex));
+			renderer.getBufferAllocator()->unmapBuffer(vertexBuffers[0]);
+			uploadedBytes += chunk.vertices.size() * sizeof(PlyObjVertex);
+		}
+
+		if (!chunk.indices.empty())
+		{
+			void* indicesData = renderer.getBufferAllocator()->mapBuffer(indexBuffer);
+			memcpy(static_cast<unsigned int*>(indicesData) + chunk.firstIndex, chunk.indices.data(), chunk.indices.size() * sizeof(unsigned int));
+			renderer.getBufferAllocator()->unmapBuffer(indexBuffer);
+			uploadedBytes += chunk.indices.size() * sizeof(unsigned int);
+
+			nIndices = chunk.firstIndex + static_cast<uint32_t>(chunk.indices.size());
+		}
+	}
+
+	if (!meshStreamer->isFinished())
+		return;
+
+	if (meshStreamer->hasFailed())
+		std::cout << "[ERROR] Streaming the mesh stopped after " << nIndices / 3 << " triangles." << std::endl;
+	meshStreamer.reset(nullptr);
+
+	// The compute passes need the whole mesh. They recompute the normals, which replaces the
+	// preliminary ones of files without normals. The setup records into cmdBuffer, which the last
+	// frame may still be executing.
+	if (nIndices > 0 && meshDeformation)
+	{
+		vkQueueWaitIdle(renderer.getVkQueue());
+		initComputePipeline();
+	}
 }
 
 void Application::update(float time, float timeSinceLastFrame) {
@@ -187,7 +534,8 @@ void Application::update(float time, float timeSinceLastFrame) {
 	// ===========================================
 	glm::mat4 identity(1.0f);
 
-	glm::mat4 viewMatrix = glm::lookAt(glm::vec3(sin(time), 0.0f, cos(time)), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+	glm::vec3 cameraPosition = glm::vec3(sin(time), 0.0f, cos(time));
+	glm::mat4 viewMatrix = glm::lookAt(cameraPosition, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f));
 	//glm::mat4 projMatrix = glm::ortho(-1.0f, 1.0f, 1.0f, -1.0f, -20.0f, 20.0f);
 	glm::mat4 projMatrix = glm::perspectiveFov(glm::pi<float>() / 2.0f, (float)renderer.getVkSurfaceWidth(), (float)renderer.getVkSurfaceHeight(), 0.001f, 1000.0f);
 
@@ -198,19 +546,32 @@ void Application::update(float time, float timeSinceLastFrame) {
 	transformations[1] = viewMatrix;
 	transformations[2] = identity;
 
+	cullingMatrix = projMatrix * viewMatrix * identity;
+	cullingCameraPosition = glm::vec3(glm::inverse(identity) * glm::vec4(cameraPosition, 1.0f));
+
 	renderer.getBufferAllocator()->unmapBuffer(transformationBuffer);
 }
 
 void Application::draw(float elapsedTime, float elapsedSinceLastFrame) {
-	computeLoop(elapsedTime, elapsedSinceLastFrame);
+	// Graphics draws the vertices of the last compute pass while compute writes the other buffer,
+	// so both submissions can overlap.
 	graphicsLoop(elapsedTime, elapsedSinceLastFrame);
+	computeLoop(elapsedTime, elapsedSinceLastFrame);
 }
 
 void Application::freeVkMemory()
 {
-	renderer.destroyBuffer(vertexBuffer);
-	renderer.destroyBuffer(indexBuffer);
+	renderer.destroyBuffer(vertexBuffers[0]);
+	renderer.destroyBuffer(vertexBuffers[1]);
+	if (hasIndexBuffer)
+		renderer.destroyBuffer(indexBuffer);
+	if (hasDrawIndexBuffer)
+		renderer.destroyBuffer(drawIndexBuffer);
 	renderer.destroyBuffer(transformationBuffer);
+	if (hasMeshletIndexBuffer)
+		renderer.destroyBuffer(meshletIndexBuffer);
+	if (vertexQuantizer != nullptr)
+		renderer.destroyBuffer(quantizedVertexBuffer);
 }
 
 void Application::computeLoop(float elapsedTime, float elapsedSinceLastFrame)
@@ -226,14 +587,20 @@ void Application::computeLoop(float elapsedTime, float elapsedSinceLastFrame)
 	if (i < -10) increase = true;
 	if (increase) i++; else i--;
 
-	vkBeginCommandBuffer(cmdBuffer, &cmdBufferBeginInfo);
+	// The deformation starts once a streamed mesh is complete.
+	if (meshProcessor == nullptr)
+		return;
 
-	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline->getPipelineLayout(), 0, 1, &computeDescriptorSet, 0, nullptr);
-	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline->getPipeline());
-	vkCmdPushConstants(cmdBuffer, computePipeline->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, 4, &i);
-	vkCmdDispatch(cmdBuffer, (nVertices + localWorkGroupSize[0] - 1) / localWorkGroupSize[0], 1, 1);
+	vkBeginCommandBuffer(computeCmdBuffer, &cmdBufferBeginInfo);
 
-	vkEndCommandBuffer(cmdBuffer);
+	// Reads the buffer drawn this frame and writes the other one, which is drawn next frame.
+	// Writing it is safe: the frame that drew it has completed in VkRenderer::beginRender.
+	// Displacing moves the surface, so the normals are recomputed right after on the GPU.
+	meshProcessor->displace(computeCmdBuffer, i * 0.001f);
+	meshProcessor->recomputeNormals(computeCmdBuffer);
+	meshProcessor->barrierForVertexInput(computeCmdBuffer);
+
+	vkEndCommandBuffer(computeCmdBuffer);
 
 	// ========================
 	// Submit Command Buffer
@@ -244,13 +611,11 @@ void Application::computeLoop(float elapsedTime, float elapsedSinceLastFrame)
 	submitInfo.pWaitSemaphores = nullptr;
 	submitInfo.pWaitDstStageMask = nullptr;
 	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &cmdBuffer;
+	submitInfo.pCommandBuffers = &computeCmdBuffer;
 	submitInfo.signalSemaphoreCount = 0;
 	submitInfo.pSignalSemaphores = nullptr;
 
 	vkQueueSubmit(renderer.getVkQueue(), 1, &submitInfo, VK_NULL_HANDLE);
-
-	vkQueueWaitIdle(renderer.getVkQueue());
 }
 
 void Application::graphicsLoop(float elapsedTime, float elapsedSinceLastFrame)
@@ -273,6 +638,13 @@ void Application::graphicsLoop(float elapsedTime, float elapsedSinceLastFrame)
 		cmdBuffer, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
 		0, 1, &transformationMemBarrier, 0, nullptr, 0, nullptr);
 
+	// Writes the indirect draws for the visible objects.
+	if (usesGpuCulling())
+		gpuCuller->cull(cmdBuffer, cullingMatrix, cullingCameraPosition);
+
+	// Points are rasterized in compute, the images are composed inside the render pass.
+	pointCloudRenderer->render(cmdBuffer, cullingMatrix);
+
 	VkRect2D renderArea{};
 	renderArea.offset.x = 0;
 	renderArea.offset.y = 0;
@@ -299,7 +671,9 @@ void Application::graphicsLoop(float elapsedTime, float elapsedSinceLastFrame)
 
 	vkCmdBeginRenderPass(cmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->getPipeline());
+	// Never wait for the material pipeline: draw with the fallback until it is compiled.
+	GraphicsPipeline* activeGraphicsPipeline = graphicsPipeline->get();
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, activeGraphicsPipeline->getPipeline());
 
 	VkViewport viewport{};
 	viewport.x = 0;
@@ -318,17 +692,56 @@ void Application::graphicsLoop(float elapsedTime, float elapsedSinceLastFrame)
 	vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
 	vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
-	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline->getPipelineLayout(), 0, 1, &graphicsDescriptorSet, 0, nullptr);
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, activeGraphicsPipeline->getPipelineLayout(), 0, 1, &graphicsDescriptorSet, 0, nullptr);
 
-	VkDeviceSize noOffset = 0;
-	VkBuffer bufferToDraw[] = { vertexBuffer.getVkBuffer() };
-	vkCmdBindVertexBuffers(cmdBuffer, 0, sizeof(bufferToDraw) / sizeof(bufferToDraw[0]), bufferToDraw, &noOffset);
-	vkCmdBindIndexBuffer(cmdBuffer, indexBuffer.getVkBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	if (vertexQuantizer != nullptr)
+	{
+		glm::vec4 dequantization[2] = { glm::vec4(vertexQuantizer->getPositionScale(), 0.0f), glm::vec4(vertexQuantizer->getPositionOffset(), 0.0f) };
+		vkCmdPushConstants(cmdBuffer, activeGraphicsPipeline->getPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(dequantization), dequantization);
 
-	vkCmdDrawIndexed(cmdBuffer, nIndices, 1, 0, 0, 0);
+		VkDeviceSize noOffset = 0;
+		VkBuffer quantizedBuffer = quantizedVertexBuffer.getVkBuffer();
+		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &quantizedBuffer, &noOffset);
+	}
+	else if (vertexPulling)
+	{
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, activeGraphicsPipeline->getPipelineLayout(), 1, 1, &vertexStreamDescriptorSets[getCurrentVertexBuffer()], 0, nullptr);
+	}
+	else
+	{
+		VkDeviceSize noOffset = 0;
+		VkBuffer bufferToDraw[] = { vertexBuffers[getCurrentVertexBuffer()].getVkBuffer() };
+		vkCmdBindVertexBuffers(cmdBuffer, 0, sizeof(bufferToDraw) / sizeof(bufferToDraw[0]), bufferToDraw, &noOffset);
+	}
+	if (hasMeshletIndexBuffer)
+		vkCmdBindIndexBuffer(cmdBuffer, meshletIndexBuffer.getVkBuffer(), 0, drawIndexType);
+	else if (drawIndexType == VK_INDEX_TYPE_UINT16)
+		vkCmdBindIndexBuffer(cmdBuffer, drawIndexBuffer.getVkBuffer(), 0, VK_INDEX_TYPE_UINT16);
+	else
+		vkCmdBindIndexBuffer(cmdBuffer, indexBuffer.getVkBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+	if (usesGpuCulling())
+	{
+		gpuCuller->draw(cmdBuffer);
+	}
+	else if (drawIndexType == VK_INDEX_TYPE_UINT16)
+	{
+		for (auto& subMesh : subMeshes)
+			vkCmdDrawIndexed(cmdBuffer, subMesh.indexCount, 1, subMesh.firstIndex, static_cast<int32_t>(subMesh.firstVertex), 0);
+	}
+	else
+	{
+		vkCmdDrawIndexed(cmdBuffer, nIndices, 1, 0, 0, 0);
+	}
+
+	pointCloudRenderer->draw(cmdBuffer);
 
 	vkCmdEndRenderPass(cmdBuffer);
 
+	// Depth of this frame for the occlusion test of the next one.
+	if (usesGpuCulling() && hiZPyramid->isSupported())
+		hiZPyramid->build(cmdBuffer, cullingMatrix);
+
 	vkEndCommandBuffer(cmdBuffer);
 
 	// ========================
@@ -363,6 +776,9 @@ void Application::run() {
 		// Process OS events.
 		glfwPollEvents();
 
+		if (meshStreamer != nullptr)
+			updateMeshStreaming();
+
 		frame_counter++;
 		double now_time = glfwGetTime();
 		if (frame_counter % 100 == 0) std::cout << "FPS = " << 1.0 / (end_frame - start_frame) << std::endl;
@@ -382,6 +798,44 @@ void Application::run() {
 	}	
 }
 
+bool Application::usesGpuCulling() const {
+	return gpuCuller != nullptr && gpuCuller->isSupported();
+}
+
+uint32_t Application::getCurrentVertexBuffer() const {
+	return meshProcessor != nullptr ? meshProcessor->getCurrentVertexBuffer() : 0;
+}
+
+bool Application::testGpuPrimitives(uint32_t count) {
+	return gpuPrimitives->runSelfTest(count);
+}
+
+void Application::setVertexPulling(bool enabled) {
+	vertexPulling = enabled;
+}
+
+void Application::setMeshOptimization(bool enabled) {
+	meshOptimization = enabled;
+}
+
+void Application::setMeshDeformation(bool enabled) {
+	meshDeformation = enabled;
+}
+
+void Application::setMeshletBackfaceCulling(bool enabled) {
+	meshletBackfaceCulling = enabled;
+}
+
+void Application::setMeshStreaming(bool enabled) {
+	meshStreaming = enabled;
+}
+
+void Application::setVertexQuantization(uint32_t normalBits) {
+	vertexQuantizationNormalBits = normalBits;
+	if (normalBits > 0)
+		vertexPulling = false;
+}
+
 void Application::shutdown() {
 
 	// Wait until the commands in the queue are done before starting the deinitialization.
@@ -390,11 +844,20 @@ void Application::shutdown() {
 	vkDestroySemaphore(renderer.getVkDevice(), semaphore, nullptr);
 	vkDestroyCommandPool(renderer.getVkDevice(), cmdPool, nullptr);
 
+	// Stop the compiler thread before the pipelines it may still be creating are destroyed.
+	pipelineCompiler.reset(nullptr);
+	meshStreamer.reset(nullptr);
+
 	deinitComputePipeline();
 	deInitGraphicsPipeline();
+	gpuCuller.reset(nullptr);
+	hiZPyramid.reset(nullptr);
+	pointCloudRenderer.reset(nullptr);
+	gpuPrimitives.reset(nullptr);
+	pipelineCache.reset(nullptr);
+	shaderVariants.reset(nullptr);
 	freeVkMemory();
 	deInitGraphicsDescriptor();
-	deInitComputeDescriptor();
 
 	renderer.deInit();
 	glfwDestroyWindow(m_window);
@@ -12,13 +12,26 @@
 
 #include "GraphicsPipeline.h"
 #include "ComputePipeline.h"
+#include "AsyncPipelineCompiler.h"
+#include "GraphicsPipelineCache.h"
 #include "Shader.h"
+#include "ShaderVariantCache.h"
+#include "MeshProcessor.h"
+#include "MeshBounds.h"
+#include "GpuCuller.h"
+#include "HiZPyramid.h"
+#include "GpuPrimitives.h"
+#include "PointCloudRenderer.h"
+#include "VertexQuantizer.h"
+#include "MeshLoader.h"
+#include "MeshStreamer.h"
 
 // STD
 #include <string>
 #include <stdlib.h>
 #include <stdio.h>
 #include <mutex>
+#include <array>
 
 //#include "Navigation.h"
 
@@ -54,6 +67,39 @@ public:
 	void run();
     void shutdown();
 
+	// Checks the GPU primitives against their CPU references and prints their timings.
+	bool testGpuPrimitives(uint32_t count);
+
+	// Vertex shaders fetch the vertices from storage buffers instead of the vertex input stage. On by
+	// default, has to be set before run().
+	void setVertexPulling(bool enabled);
+
+	// Reorders the triangles and vertices of the mesh for the vertex cache, overdraw and vertex
+	// fetch when it is loaded. On by default, has to be set before run().
+	void setMeshOptimization(bool enabled);
+
+	// Loads the mesh on a background thread and draws the triangles which are uploaded already, so
+	// the first frame does not wait for the file. The mesh is drawn without culling, meshlets,
+	// quantization and mesh optimization, the compute deformation starts once it is complete. PLY
+	// triangle meshes only, others are loaded as a whole. Off by default, has to be set before run().
+	void setMeshStreaming(bool enabled);
+
+	// Deforms the mesh and recomputes its normals with compute passes every frame. These passes read a
+	// 32-bit copy of the indices next to the ones which are drawn. Without them that copy is only
+	// created for 32-bit draws without meshlets, and a streamed file without normals keeps the
+	// preliminary ones. On by default, has to be set before run().
+	void setMeshDeformation(bool enabled);
+
+	// Rejects the meshlets whose faces all point away from the camera. The pipeline draws both sides,
+	// so this is only valid for closed meshes, and the cones are built from the rest pose, so it is
+	// ignored while the mesh deformation runs. Off by default, has to be set before run().
+	void setMeshletBackfaceCulling(bool enabled);
+
+	// Draws the mesh from 16-bit positions and octahedral normals with 16 or 8 bits per component,
+	// 0 draws the float vertices. Turns vertex pulling off. The compute deformation is not shown, it
+	// writes the float vertices. Has to be set before run().
+	void setVertexQuantization(uint32_t normalBits);
+
     ~Application();
 
 	void EventMouseButton(GLFWwindow* window, int button, int action, int mods);
@@ -69,6 +115,10 @@ public:
 private:
 	void init();
     void create();
+	void createMesh(const std::string& meshFile, float meshSize);
+	void createPointCloud();
+	bool startMeshStreaming(const std::string& meshFile, float meshSize);
+	void updateMeshStreaming();
     void update(float elapsedTime, float elapsedSinceLastFrame);
     void draw(float elapsedTime, float elapsedSinceLastFrame);
 
@@ -78,15 +128,18 @@ private:
 	void initGraphicsDescriptor();
 	void updateGraphicsDescriptorSets();
 	void deInitGraphicsDescriptor();
+	void initVertexStreamDescriptor();
+	void deInitVertexStreamDescriptor();
 	void initGraphicsPipeline();
 	void deInitGraphicsPipeline();
 
-	void initComputeDescriptor();
-	void updateComputeDescriptorSets();
-	void deInitComputeDescriptor();
 	void initComputePipeline();
 	void deinitComputePipeline();
 
+	// The culler is missing while a mesh streams, the mesh processor until it is complete.
+	bool     usesGpuCulling() const;
+	uint32_t getCurrentVertexBuffer() const;
+
 private:
 	// Key bindings
     bool m_controlKeyHold;
@@ -105,30 +158,78 @@ private:
 	VkRenderer renderer;
 
 	// Mesh Info
-	Buffer vertexBuffer;
+	std::array<Buffer, 2> vertexBuffers;
+
+	// 32-bit indices for the compute passes, and for drawing when drawIndexType is 32-bit and there
+	// are no meshlets.
 	Buffer indexBuffer;
+	bool   hasIndexBuffer = false;
+
+	// See setMeshDeformation().
+	bool meshDeformation = true;
+
+	// See setMeshOptimization().
+	bool meshOptimization = true;
+
+	// See setMeshletBackfaceCulling().
+	bool meshletBackfaceCulling = false;
+
+	// See setMeshStreaming(). Set while chunks are still arriving, nIndices grows with them.
+	bool                          meshStreaming = false;
+	std::unique_ptr<MeshStreamer> meshStreamer;
+
+	// The indices for drawing, relative to the first vertex of their sub mesh and 16 bits wide when
+	// every sub mesh fits (see IndexCodec). Only created without meshlets, which are drawn instead.
+	std::vector<MeshLoader::SubMesh> subMeshes;
+	VkIndexType drawIndexType = VK_INDEX_TYPE_UINT32;
+	Buffer      drawIndexBuffer;
+	bool        hasDrawIndexBuffer = false;
 	Buffer transformationBuffer;
 
-	VkShaderModule computeShader = VK_NULL_HANDLE;
+	// The mesh in the compressed format of vertexQuantizer, see setVertexQuantization().
+	uint32_t                         vertexQuantizationNormalBits = 0;
+	std::unique_ptr<VertexQuantizer> vertexQuantizer;
+	Buffer                           quantizedVertexBuffer;
+
+	// The triangles reordered into meshlets, in drawIndexType. Every draw uses them when they exist,
+	// the culling objects point to the meshlets of their sub mesh.
+	Buffer meshletIndexBuffer;
+	bool   hasMeshletIndexBuffer = false;
 
 	VkDescriptorPool graphicsDescriptorPool	= VK_NULL_HANDLE;
 	VkDescriptorSet	graphicsDescriptorSet = VK_NULL_HANDLE;
 	VkDescriptorSetLayout graphicsDescriptorSetLayout = VK_NULL_HANDLE;
 
-	VkDescriptorPool computeDescriptorPool = VK_NULL_HANDLE;
-	VkDescriptorSet	computeDescriptorSet = VK_NULL_HANDLE;
-	VkDescriptorSetLayout computeDescriptorSetLayout = VK_NULL_HANDLE;
+	// Vertex pulling: set 1 of the mesh pipelines, binding 0 positions and 1 normals. One set per
+	// vertex buffer, both bindings point to the interleaved vertices.
+	bool vertexPulling = true;
+	VkDescriptorPool vertexStreamDescriptorPool = VK_NULL_HANDLE;
+	std::array<VkDescriptorSet, 2> vertexStreamDescriptorSets{};
+	VkDescriptorSetLayout vertexStreamDescriptorSetLayout = VK_NULL_HANDLE;
 
 	VkSemaphore semaphore;
 	VkCommandBuffer cmdBuffer;
+	VkCommandBuffer computeCmdBuffer;
 	VkCommandPool cmdPool;
 
-	std::unique_ptr<GraphicsPipeline> graphicsPipeline;
-	std::unique_ptr<ComputePipeline>  computePipeline;
+	std::unique_ptr<ShaderVariantCache>     shaderVariants;
+	std::unique_ptr<GraphicsPipelineCache>  pipelineCache;
+	std::unique_ptr<AsyncPipelineCompiler>  pipelineCompiler;
+	std::shared_ptr<GraphicsPipeline>       fallbackGraphicsPipeline;
+	std::shared_ptr<GraphicsPipelineHandle> graphicsPipeline;
+	std::unique_ptr<MeshProcessor>          meshProcessor;
+	std::unique_ptr<GpuCuller>              gpuCuller;
+	std::unique_ptr<HiZPyramid>             hiZPyramid;
+	std::unique_ptr<GpuPrimitives>          gpuPrimitives;
+	std::unique_ptr<PointCloudRenderer>     pointCloudRenderer;
+
+	// projection * view * world, the frustum the objects are culled against, and the camera position
+	// in the same space for the meshlet normal cones.
+	glm::mat4 cullingMatrix = glm::mat4(1.0f);
+	glm::vec3 cullingCameraPosition = glm::vec3(0.0f);
 
 	uint32_t nVertices;
 	uint32_t nIndices;
-	const uint32_t localWorkGroupSize[3] = { 128, 1, 1 };
 
 	void freeVkMemory();
 };
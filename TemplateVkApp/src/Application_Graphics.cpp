@@ -4,29 +4,38 @@
 
 void Application::initGraphicsDescriptor()
 {
-	std::array<VkDescriptorSetLayoutBinding, 1> bindings{};
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
 	bindings[0].binding = 0;
 	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	bindings[0].descriptorCount = 1;
 	bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 	bindings[0].pImmutableSamplers = nullptr;
 
+	// Object transforms of the GPU culler.
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	bindings[1].pImmutableSamplers = nullptr;
+
 	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
 	descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	descriptorSetLayoutCreateInfo.bindingCount = 1;
+	descriptorSetLayoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
 	descriptorSetLayoutCreateInfo.pBindings = bindings.data();
 	vkCreateDescriptorSetLayout(renderer.getVkDevice(), &descriptorSetLayoutCreateInfo, nullptr, &graphicsDescriptorSetLayout);
 
-	VkDescriptorPoolSize descriptorSetPoolSize{};
-	descriptorSetPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	descriptorSetPoolSize.descriptorCount = 1;
+	std::array<VkDescriptorPoolSize, 2> descriptorSetPoolSizes{};
+	descriptorSetPoolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descriptorSetPoolSizes[0].descriptorCount = 1;
+	descriptorSetPoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorSetPoolSizes[1].descriptorCount = 1;
 
 	VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
 	descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	descriptorPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
 	descriptorPoolCreateInfo.maxSets = 1;
-	descriptorPoolCreateInfo.poolSizeCount = 1;
-	descriptorPoolCreateInfo.pPoolSizes = &descriptorSetPoolSize;
+	descriptorPoolCreateInfo.poolSizeCount = static_cast<uint32_t>(descriptorSetPoolSizes.size());
+	descriptorPoolCreateInfo.pPoolSizes = descriptorSetPoolSizes.data();
 	vkCreateDescriptorPool(renderer.getVkDevice(), &descriptorPoolCreateInfo, nullptr, &graphicsDescriptorPool);
 
 	VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{};
@@ -58,6 +67,26 @@ void Application::updateGraphicsDescriptorSets()
 	descriptorWrite.pTexelBufferView = nullptr;
 
 	vkUpdateDescriptorSets(renderer.getVkDevice(), 1, &descriptorWrite, 0, nullptr);
+
+	// Only read by the OBJECT_TRANSFORMS variant of ply.vert.
+	if (usesGpuCulling())
+	{
+		VkDescriptorBufferInfo objectBufferInfo{};
+		objectBufferInfo.buffer = gpuCuller->getObjectBuffer().getVkBuffer();
+		objectBufferInfo.offset = 0;
+		objectBufferInfo.range = VK_WHOLE_SIZE;
+
+		VkWriteDescriptorSet objectDescriptorWrite{};
+		objectDescriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		objectDescriptorWrite.dstSet = graphicsDescriptorSet;
+		objectDescriptorWrite.dstBinding = 1;
+		objectDescriptorWrite.dstArrayElement = 0;
+		objectDescriptorWrite.descriptorCount = 1;
+		objectDescriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		objectDescriptorWrite.pBufferInfo = &objectBufferInfo;
+
+		vkUpdateDescriptorSets(renderer.getVkDevice(), 1, &objectDescriptorWrite, 0, nullptr);
+	}
 }
 
 void Application::deInitGraphicsDescriptor()
@@ -68,6 +97,77 @@ void Application::deInitGraphicsDescriptor()
 	vkDestroyDescriptorSetLayout(renderer.getVkDevice(), graphicsDescriptorSetLayout, nullptr);
 }
 
+void Application::initVertexStreamDescriptor()
+{
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+	for (uint32_t b = 0; b < bindings.size(); b++)
+	{
+		bindings[b].binding = b;
+		bindings[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[b].descriptorCount = 1;
+		bindings[b].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		bindings[b].pImmutableSamplers = nullptr;
+	}
+
+	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
+	descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	descriptorSetLayoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	descriptorSetLayoutCreateInfo.pBindings = bindings.data();
+	vkCreateDescriptorSetLayout(renderer.getVkDevice(), &descriptorSetLayoutCreateInfo, nullptr, &vertexStreamDescriptorSetLayout);
+
+	uint32_t nSets = static_cast<uint32_t>(vertexStreamDescriptorSets.size());
+
+	VkDescriptorPoolSize descriptorSetPoolSize{};
+	descriptorSetPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorSetPoolSize.descriptorCount = nSets * static_cast<uint32_t>(bindings.size());
+
+	VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+	descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descriptorPoolCreateInfo.maxSets = nSets;
+	descriptorPoolCreateInfo.poolSizeCount = 1;
+	descriptorPoolCreateInfo.pPoolSizes = &descriptorSetPoolSize;
+	vkCreateDescriptorPool(renderer.getVkDevice(), &descriptorPoolCreateInfo, nullptr, &vertexStreamDescriptorPool);
+
+	std::array<VkDescriptorSetLayout, 2> setLayouts = { vertexStreamDescriptorSetLayout, vertexStreamDescriptorSetLayout };
+
+	VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+	descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	descriptorSetAllocateInfo.descriptorSetCount = nSets;
+	descriptorSetAllocateInfo.pSetLayouts = setLayouts.data();
+	descriptorSetAllocateInfo.descriptorPool = vertexStreamDescriptorPool;
+	vkAllocateDescriptorSets(renderer.getVkDevice(), &descriptorSetAllocateInfo, vertexStreamDescriptorSets.data());
+
+	// The compute passes write the same buffers, so the deformed vertices are drawn without a copy.
+	for (uint32_t i = 0; i < nSets; i++)
+	{
+		VkDescriptorBufferInfo vertexBufferInfo{};
+		vertexBufferInfo.buffer = vertexBuffers[i].getVkBuffer();
+		vertexBufferInfo.offset = 0;
+		vertexBufferInfo.range = VK_WHOLE_SIZE;
+
+		std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+		for (uint32_t b = 0; b < descriptorWrites.size(); b++)
+		{
+			descriptorWrites[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[b].dstSet = vertexStreamDescriptorSets[i];
+			descriptorWrites[b].dstBinding = b;
+			descriptorWrites[b].descriptorCount = 1;
+			descriptorWrites[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[b].pBufferInfo = &vertexBufferInfo;
+		}
+
+		vkUpdateDescriptorSets(renderer.getVkDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void Application::deInitVertexStreamDescriptor()
+{
+	if (vertexStreamDescriptorPool != VK_NULL_HANDLE)
+		vkDestroyDescriptorPool(renderer.getVkDevice(), vertexStreamDescriptorPool, nullptr);
+	if (vertexStreamDescriptorSetLayout != VK_NULL_HANDLE)
+		vkDestroyDescriptorSetLayout(renderer.getVkDevice(), vertexStreamDescriptorSetLayout, nullptr);
+}
+
 void Application::initGraphicsPipeline()
 {
 	// ======================================
@@ -77,17 +177,8 @@ void Application::initGraphicsPipeline()
 	transformationBuffer = renderer.createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 3 * sizeof(glm::mat4));
 
 	initGraphicsDescriptor();
-
-	// ============================
-	// Pipeline Preparation
-	// ============================
-	ShaderStage vertexShader;
-	ShaderStage fragmentShader;
-
-	vertexShader.fromGLSLFile(renderer.getVkDevice(), "glsl/ply.vert", VK_SHADER_STAGE_VERTEX_BIT, "main");
-	assert(vertexShader.getVkShaderType() == VK_SHADER_STAGE_VERTEX_BIT);
-	fragmentShader.fromGLSLFile(renderer.getVkDevice(), "glsl/ply.frag", VK_SHADER_STAGE_FRAGMENT_BIT, "main");
-	assert(fragmentShader.getVkShaderType() == VK_SHADER_STAGE_FRAGMENT_BIT);
+	if (vertexPulling)
+		initVertexStreamDescriptor();
 
 	// position:
 	std::vector<VkVertexInputAttributeDescription> inputAttribDescription(2);
@@ -108,14 +199,82 @@ void Application::initGraphicsPipeline()
 	inputBindingDescription.stride = sizeof(PlyObjVertex);
 	inputBindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-	graphicsPipeline =
-		std::unique_ptr<GraphicsPipeline>(
-			new GraphicsPipeline(renderer, { graphicsDescriptorSetLayout }, { vertexShader, fragmentShader },
-				inputAttribDescription, { inputBindingDescription }, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
-			);
+	// ============================
+	// Fallback Pipeline
+	// ============================
+	// Compiled synchronously: it is cheap and has to exist before the first frame.
+	ShaderStage vertexShader;
+	ShaderStage fallbackFragmentShader;
+
+	// With GPU culling the object transforms come from the culler's object buffer.
+	ShaderDefines vertexDefines;
+	vertexDefines.set("OBJECT_TRANSFORMS", usesGpuCulling());
+	vertexDefines.set("VERTEX_PULLING", vertexPulling);
+	vertexDefines.set("POSITION_STRIDE", 6).set("POSITION_OFFSET", 0);
+	vertexDefines.set("NORMAL_STRIDE", 6).set("NORMAL_OFFSET", 3);
+	vertexDefines.set("QUANTIZED_VERTICES", vertexQuantizer != nullptr);
+
+	bool shadersCompiled =
+		shaderVariants->getVariant("glsl/ply.vert", VK_SHADER_STAGE_VERTEX_BIT, "main", vertexDefines, vertexShader) &&
+		shaderVariants->getVariant("glsl/fallback.frag", VK_SHADER_STAGE_FRAGMENT_BIT, "main", ShaderDefines(), fallbackFragmentShader);
+	assert(shadersCompiled);
+
+	GraphicsPipelineDescription pipelineDescription;
+	pipelineDescription.descriptorSetLayouts           = { graphicsDescriptorSetLayout };
+	pipelineDescription.shaderStages                   = { vertexShader, fallbackFragmentShader };
+	pipelineDescription.vertexInputAttribDescriptions  = inputAttribDescription;
+	pipelineDescription.vertexInputBindingDescriptions = { inputBindingDescription };
+	pipelineDescription.primitiveTopology              = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	pipelineDescription.setRenderPass(renderer);
+
+	// No vertex input state, the streams are bound as set 1.
+	if (vertexPulling)
+	{
+		pipelineDescription.descriptorSetLayouts.push_back(vertexStreamDescriptorSetLayout);
+		pipelineDescription.vertexInputAttribDescriptions.clear();
+		pipelineDescription.vertexInputBindingDescriptions.clear();
+	}
+
+	// Compressed vertices, dequantized with the scale and offset in the push constants.
+	if (vertexQuantizer != nullptr)
+	{
+		VkPushConstantRange dequantizationRange{};
+		dequantizationRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		dequantizationRange.offset     = 0;
+		dequantizationRange.size       = 2 * sizeof(glm::vec4);
+
+		pipelineDescription.pushConstantRanges             = { dequantizationRange };
+		pipelineDescription.vertexInputAttribDescriptions  = vertexQuantizer->getAttributeDescriptions(0);
+		pipelineDescription.vertexInputBindingDescriptions = { vertexQuantizer->getBindingDescription(0) };
+	}
+
+	fallbackGraphicsPipeline = pipelineCache->getOrCreate(pipelineDescription);
+
+	// ============================
+	// Material Pipeline
+	// ============================
+	// Shader compilation and pipeline creation run on the compiler thread.
+	// Material features are compiled into a specialized variant instead of being branched on per fragment.
+	ShaderDefines materialDefines;
+	materialDefines.set("SHADING_ENABLED", true).set("NORMAL_AS_COLOR", false);
+
+	graphicsPipeline = pipelineCompiler->requestGraphicsPipeline(
+		[this, pipelineDescription, vertexShader, materialDefines]()
+		{
+			ShaderStage fragmentShader;
+			if (!shaderVariants->getVariant("glsl/ply.frag", VK_SHADER_STAGE_FRAGMENT_BIT, "main", materialDefines, fragmentShader))
+				return std::shared_ptr<GraphicsPipeline>();
+
+			GraphicsPipelineDescription materialDescription = pipelineDescription;
+			materialDescription.shaderStages = { vertexShader, fragmentShader };
+			return pipelineCache->getOrCreate(materialDescription);
+		},
+		fallbackGraphicsPipeline.get());
 }
 
 void Application::deInitGraphicsPipeline()
 {
-	graphicsPipeline.reset(nullptr);
+	graphicsPipeline.reset();
+	fallbackGraphicsPipeline.reset();
+	deInitVertexStreamDescriptor();
 }
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "AsyncPipelineCompiler.h"
+
+#include <iostream>
+
+GraphicsPipelineHandle::GraphicsPipelineHandle(GraphicsPipeline* fallback): m_fallback(fallback), m_ready(nullptr), m_failed(false)
+{
+}
+
+bool GraphicsPipelineHandle::isReady() const
+{
+	return m_ready.load(std::memory_order_acquire) != nullptr;
+}
+
+bool GraphicsPipelineHandle::hasFailed() const
+{
+	return m_failed.load(std::memory_order_acquire);
+}
+
+GraphicsPipeline* GraphicsPipelineHandle::get() const
+{
+	GraphicsPipeline* ready = m_ready.load(std::memory_order_acquire);
+	return ready ? ready : m_fallback;
+}
+
+AsyncPipelineCompiler::AsyncPipelineCompiler(): m_numPending(0)
+{
+	m_thread = std::thread(&AsyncPipelineCompiler::compilerLoop, this);
+}
+
+AsyncPipelineCompiler::~AsyncPipelineCompiler()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+		m_requests.clear();
+	}
+	m_wakeUp.notify_all();
+
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+std::shared_ptr<GraphicsPipelineHandle> AsyncPipelineCompiler::requestGraphicsPipeline(GraphicsPipelineBuilder builder, GraphicsPipeline* fallback)
+{
+	auto handle = std::make_shared<GraphicsPipelineHandle>(fallback);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_requests.push_back({ std::move(builder), handle });
+		m_numPending++;
+	}
+	m_wakeUp.notify_one();
+
+	return handle;
+}
+
+uint32_t AsyncPipelineCompiler::getNumPendingRequests() const
+{
+	return m_numPending.load();
+}
+
+void AsyncPipelineCompiler::compilerLoop()
+{
+	for (;;)
+	{
+		Request request;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeUp.wait(lock, [this]() { return m_stop || !m_requests.empty(); });
+			if (m_stop)
+				return;
+
+			request = std::move(m_requests.front());
+			m_requests.pop_front();
+		}
+
+		std::shared_ptr<GraphicsPipeline> pipeline = request.builder();
+		if (pipeline && pipeline->getPipeline() != VK_NULL_HANDLE)
+		{
+			// The handle owns the pipeline; only publish it after ownership is settled.
+			request.handle->m_compiled = std::move(pipeline);
+			request.handle->m_ready.store(request.handle->m_compiled.get(), std::memory_order_release);
+		}
+		else
+		{
+			std::cout << "[ERROR] Asynchronous pipeline compilation failed, keeping the fallback pipeline." << std::endl;
+			request.handle->m_failed.store(true, std::memory_order_release);
+		}
+
+		m_numPending--;
+	}
+}
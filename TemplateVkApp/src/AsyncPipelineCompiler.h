@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <vulkan/vulkan.h>
+
+#include "GraphicsPipeline.h"
+
+// A graphics pipeline which may still be compiling on the background thread.
+// Until the real pipeline is ready, get() returns the fallback pipeline, so the
+// frame loop can always draw something without waiting for the driver.
+class GraphicsPipelineHandle
+{
+	friend class AsyncPipelineCompiler;
+public:
+	GraphicsPipelineHandle(GraphicsPipeline* fallback);
+
+	bool              isReady() const;
+	bool              hasFailed() const;
+
+	// Returns the compiled pipeline when ready, the fallback one otherwise.
+	// Both have to be created with compatible descriptor set layouts.
+	GraphicsPipeline* get() const;
+
+private:
+	GraphicsPipeline*                 m_fallback;
+	std::shared_ptr<GraphicsPipeline> m_compiled;
+	std::atomic<GraphicsPipeline*>    m_ready;
+	std::atomic<bool>                 m_failed;
+};
+
+class AsyncPipelineCompiler
+{
+public:
+	// Creates the pipeline (and usually loads its shaders). Runs on the compiler thread.
+	// The pipeline is shared, so builders can return pipelines from a GraphicsPipelineCache.
+	using GraphicsPipelineBuilder = std::function<std::shared_ptr<GraphicsPipeline>()>;
+
+	AsyncPipelineCompiler();
+	~AsyncPipelineCompiler();
+
+	// Returns immediately. The handle switches from the fallback to the compiled pipeline
+	// once the builder has finished on the compiler thread.
+	std::shared_ptr<GraphicsPipelineHandle> requestGraphicsPipeline(GraphicsPipelineBuilder builder, GraphicsPipeline* fallback);
+
+	// Number of requests which are still waiting or compiling.
+	uint32_t getNumPendingRequests() const;
+
+private:
+	struct Request
+	{
+		GraphicsPipelineBuilder                 builder;
+		std::shared_ptr<GraphicsPipelineHandle> handle;
+	};
+
+	void compilerLoop();
+
+	std::thread             m_thread;
+	mutable std::mutex      m_mutex;
+	std::condition_variable m_wakeUp;
+	std::deque<Request>     m_requests;
+	std::atomic<uint32_t>   m_numPending;
+	bool                    m_stop = false;
+};
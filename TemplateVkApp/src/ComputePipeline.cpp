@@ -5,14 +5,15 @@
 ComputePipeline::ComputePipeline(
 	const VkRenderer& renderer,
 	const std::vector<VkDescriptorSetLayout>& descriptorLayouts,
-	const ShaderStage& shaderStage): renderer(renderer)
+	const ShaderStage& shaderStage,
+	uint32_t pushConstantSize): renderer(renderer)
 {
 	// ============================
 	// Create Pipeline layout
 	// ============================
 	VkPushConstantRange pushConstantRange{};
 	pushConstantRange.offset = 0;
-	pushConstantRange.size = sizeof(int);
+	pushConstantRange.size = pushConstantSize;
 	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
 	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
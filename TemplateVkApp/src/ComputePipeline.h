@@ -14,7 +14,8 @@ public:
 	ComputePipeline(
 		const VkRenderer& renderer,
 		const std::vector<VkDescriptorSetLayout>& descriptorLayouts,
-		const ShaderStage& shaderStage
+		const ShaderStage& shaderStage,
+		uint32_t pushConstantSize = sizeof(int)
 	);
 
 	VkPipelineLayout getPipelineLayout();
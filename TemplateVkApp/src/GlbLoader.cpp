@@ -0,0 +1,644 @@
+#include "GlbLoader.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <utility>
+
+static const uint32_t GlbMagic     = 0x46546c67;   // "glTF"
+static const uint32_t GlbVersion   = 2;
+static const uint32_t GlbChunkJson = 0x4e4f534a;   // "JSON"
+static const uint32_t GlbChunkBin  = 0x004e4942;   // "BIN\0"
+
+// glTF component types, the GL enums.
+static const uint32_t ComponentByte          = 5120;
+static const uint32_t ComponentUnsignedByte  = 5121;
+static const uint32_t ComponentShort         = 5122;
+static const uint32_t ComponentUnsignedShort = 5123;
+static const uint32_t ComponentUnsignedInt   = 5125;
+static const uint32_t ComponentFloat         = 5126;
+
+static const uint32_t ModeTriangles = 4;
+
+namespace
+{
+	// ======================================
+	// Just enough JSON for the glTF header
+	// ======================================
+	struct JsonValue
+	{
+		enum class Type { Null, Bool, Number, String, Array, Object };
+
+		Type                                           type    = Type::Null;
+		bool                                           boolean = false;
+		double                                         number  = 0.0;
+		std::string                                    string;
+		std::vector<JsonValue>                         items;
+		std::vector<std::pair<std::string, JsonValue>> members;
+
+		const JsonValue* find(const char* key) const
+		{
+			for (const auto& member : members)
+			{
+				if (member.first == key)
+					return &member.second;
+			}
+			return nullptr;
+		}
+
+		const JsonValue* at(size_t index) const
+		{
+			return type == Type::Array && index < items.size() ? &items[index] : nullptr;
+		}
+	};
+
+	class JsonParser
+	{
+	public:
+		JsonParser(const char* begin, const char* end) : m_cur(begin), m_end(end)
+		{
+		}
+
+		bool parse(JsonValue& value)
+		{
+			if (!parseValue(value, 0))
+				return false;
+			skipSpace();
+			return m_cur == m_end;
+		}
+
+	private:
+		static const int MaxDepth = 64;
+
+		void skipSpace()
+		{
+			while (m_cur < m_end && (*m_cur == ' ' || *m_cur == '\t' || *m_cur == '\n' || *m_cur == '\r'))
+				m_cur++;
+		}
+
+		bool consume(const char* literal)
+		{
+			size_t length = std::strlen(literal);
+			if (static_cast<size_t>(m_end - m_cur) < length || std::memcmp(m_cur, literal, length) != 0)
+				return false;
+			m_cur += length;
+			return true;
+		}
+
+		bool parseValue(JsonValue& value, int depth)
+		{
+			skipSpace();
+			if (m_cur == m_end || depth > MaxDepth)
+				return false;
+
+			switch (*m_cur)
+			{
+			case '{':
+				return parseObject(value, depth);
+			case '[':
+				return parseArray(value, depth);
+			case '"':
+				value.type = JsonValue::Type::String;
+				return parseString(value.string);
+			case 't':
+				value.type    = JsonValue::Type::Bool;
+				value.boolean = true;
+				return consume("true");
+			case 'f':
+				value.type    = JsonValue::Type::Bool;
+				value.boolean = false;
+				return consume("false");
+			case 'n':
+				value.type = JsonValue::Type::Null;
+				return consume("null");
+			default:
+				value.type = JsonValue::Type::Number;
+				return parseNumber(value.number);
+			}
+		}
+
+		bool parseObject(JsonValue& value, int depth)
+		{
+			value.type = JsonValue::Type::Object;
+			m_cur++;
+			skipSpace();
+			if (m_cur < m_end && *m_cur == '}')
+			{
+				m_cur++;
+				return true;
+			}
+
+			while (true)
+			{
+				std::string key;
+				skipSpace();
+				if (m_cur == m_end || *m_cur != '"' || !parseString(key))
+					return false;
+
+				skipSpace();
+				if (m_cur == m_end || *m_cur++ != ':')
+					return false;
+
+				value.members.emplace_back(std::move(key), JsonValue());
+				if (!parseValue(value.members.back().second, depth + 1))
+					return false;
+
+				skipSpace();
+				if (m_cur == m_end)
+					return false;
+				if (*m_cur == '}')
+				{
+					m_cur++;
+					return true;
+				}
+				if (*m_cur++ != ',')
+					return false;
+			}
+		}
+
+		bool parseArray(JsonValue& value, int depth)
+		{
+			value.type = JsonValue::Type::Array;
+			m_cur++;
+			skipSpace();
+			if (m_cur < m_end && *m_cur == ']')
+			{
+				m_cur++;
+				return true;
+			}
+
+			while (true)
+			{
+				value.items.emplace_back();
+				if (!parseValue(value.items.back(), depth + 1))
+					return false;
+
+				skipSpace();
+				if (m_cur == m_end)
+					return false;
+				if (*m_cur == ']')
+				{
+					m_cur++;
+					return true;
+				}
+				if (*m_cur++ != ',')
+					return false;
+			}
+		}
+
+		// Escaped code points other than ASCII become '?', the names which are read are ASCII.
+		bool parseString(std::string& string)
+		{
+			m_cur++;
+			while (m_cur < m_end && *m_cur != '"')
+			{
+				char c = *m_cur++;
+				if (c != '\\')
+				{
+					string += c;
+					continue;
+				}
+
+				if (m_cur == m_end)
+					return false;
+
+				switch (*m_cur++)
+				{
+				case '"':  string += '"';  break;
+				case '\\': string += '\\'; break;
+				case '/':  string += '/';  break;
+				case 'b':  string += '\b'; break;
+				case 'f':  string += '\f'; break;
+				case 'n':  string += '\n'; break;
+				case 'r':  string += '\r'; break;
+				case 't':  string += '\t'; break;
+				case 'u':
+				{
+					if (m_end - m_cur < 4)
+						return false;
+
+					uint32_t codePoint = 0;
+					for (int i = 0; i < 4; i++)
+					{
+						char digit = *m_cur++;
+						if (!std::isxdigit(static_cast<unsigned char>(digit)))
+							return false;
+						codePoint = codePoint * 16 + static_cast<uint32_t>(std::isdigit(static_cast<unsigned char>(digit)) ? digit - '0' : std::tolower(digit) - 'a' + 10);
+					}
+					string += codePoint < 0x80 ? static_cast<char>(codePoint) : '?';
+					break;
+				}
+				default:
+					return false;
+				}
+			}
+
+			if (m_cur == m_end)
+				return false;
+			m_cur++;
+			return true;
+		}
+
+		bool parseNumber(double& number)
+		{
+			const char* begin = m_cur;
+			while (m_cur < m_end && (std::isdigit(static_cast<unsigned char>(*m_cur)) || *m_cur == '-' || *m_cur == '+' || *m_cur == '.' || *m_cur == 'e' || *m_cur == 'E'))
+				m_cur++;
+
+			std::string text(begin, m_cur);
+			char* parsedEnd = nullptr;
+			number = std::strtod(text.c_str(), &parsedEnd);
+			return !text.empty() && parsedEnd == text.c_str() + text.size();
+		}
+
+		const char* m_cur;
+		const char* m_end;
+	};
+
+	// Non negative integers up to max, false for anything else.
+	bool getUInt(const JsonValue* value, uint64_t max, uint64_t& result)
+	{
+		if (value == nullptr || value->type != JsonValue::Type::Number || value->number < 0.0 || value->number > static_cast<double>(max) || value->number != static_cast<double>(static_cast<uint64_t>(value->number)))
+			return false;
+		result = static_cast<uint64_t>(value->number);
+		return true;
+	}
+
+	// An optional integer, defaultValue if the key is missing.
+	bool getUInt(const JsonValue& object, const char* key, uint64_t max, uint64_t defaultValue, uint64_t& result)
+	{
+		const JsonValue* value = object.find(key);
+		if (value == nullptr)
+		{
+			result = defaultValue;
+			return true;
+		}
+		return getUInt(value, max, result);
+	}
+
+	uint32_t getComponentSize(uint32_t componentType)
+	{
+		switch (componentType)
+		{
+		case ComponentByte:
+		case ComponentUnsignedByte:
+			return 1;
+		case ComponentShort:
+		case ComponentUnsignedShort:
+			return 2;
+		case ComponentUnsignedInt:
+		case ComponentFloat:
+			return 4;
+		default:
+			return 0;
+		}
+	}
+
+	uint32_t getComponentCount(const std::string& type)
+	{
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2")   return 2;
+		if (type == "VEC3")   return 3;
+		if (type == "VEC4")   return 4;
+		return 0;
+	}
+
+	// The views resolve against the binary chunk, the only buffer a GLB file holds itself.
+	struct Document
+	{
+		JsonValue      root;
+		const uint8_t* bin     = nullptr;
+		uint64_t       binSize = 0;
+	};
+
+	bool resolveAccessor(const Document& document, uint64_t accessorIndex, GlbLoader::Stream& stream)
+	{
+		const JsonValue* accessors = document.root.find("accessors");
+		const JsonValue* accessor  = accessors != nullptr ? accessors->at(static_cast<size_t>(accessorIndex)) : nullptr;
+		if (accessor == nullptr || accessor->find("sparse") != nullptr)
+			return false;
+
+		const JsonValue* type = accessor->find("type");
+		uint64_t bufferViewIndex, accessorOffset, componentType, count;
+		if (type == nullptr || type->type != JsonValue::Type::String ||
+			!getUInt(accessor->find("bufferView"), std::numeric_limits<uint32_t>::max(), bufferViewIndex) ||
+			!getUInt(*accessor, "byteOffset", std::numeric_limits<uint32_t>::max(), 0, accessorOffset) ||
+			!getUInt(accessor->find("componentType"), std::numeric_limits<uint32_t>::max(), componentType) ||
+			!getUInt(accessor->find("count"), std::numeric_limits<uint32_t>::max(), count))
+			return false;
+
+		const JsonValue* bufferViews = document.root.find("bufferViews");
+		const JsonValue* bufferView  = bufferViews != nullptr ? bufferViews->at(static_cast<size_t>(bufferViewIndex)) : nullptr;
+		if (bufferView == nullptr)
+			return false;
+
+		uint64_t bufferIndex, viewOffset, viewLength, viewStride;
+		if (!getUInt(bufferView->find("buffer"), std::numeric_limits<uint32_t>::max(), bufferIndex) ||
+			!getUInt(*bufferView, "byteOffset", std::numeric_limits<uint64_t>::max() / 2, 0, viewOffset) ||
+			!getUInt(bufferView->find("byteLength"), std::numeric_limits<uint64_t>::max() / 2, viewLength) ||
+			!getUInt(*bufferView, "byteStride", 252, 0, viewStride))
+			return false;
+
+		// The binary chunk is the first buffer, without a uri.
+		const JsonValue* buffers = document.root.find("buffers");
+		const JsonValue* buffer  = buffers != nullptr ? buffers->at(static_cast<size_t>(bufferIndex)) : nullptr;
+		if (bufferIndex != 0 || buffer == nullptr || buffer->find("uri") != nullptr || document.bin == nullptr)
+			return false;
+
+		uint32_t componentSize = getComponentSize(static_cast<uint32_t>(componentType));
+		uint32_t components    = getComponentCount(type->string);
+		uint64_t elementSize   = componentSize * components;
+		uint64_t stride        = viewStride != 0 ? viewStride : elementSize;
+		if (elementSize == 0 || stride < elementSize || viewOffset + viewLength > document.binSize)
+			return false;
+
+		// The last element ends inside the view.
+		if (count > 0 && accessorOffset + stride * (count - 1) + elementSize > viewLength)
+			return false;
+
+		const JsonValue* normalized = accessor->find("normalized");
+		stream.data          = document.bin + viewOffset + accessorOffset;
+		stream.count         = static_cast<uint32_t>(count);
+		stream.stride        = static_cast<uint32_t>(stride);
+		stream.componentType = static_cast<uint32_t>(componentType);
+		stream.components    = components;
+		stream.normalized    = normalized != nullptr && normalized->type == JsonValue::Type::Bool && normalized->boolean;
+		return true;
+	}
+
+	bool isFloatVec3(const GlbLoader::Stream& stream)
+	{
+		return stream.componentType == ComponentFloat && stream.components == 3;
+	}
+
+	// Components as glTF defines them, normalized integers map to [0, 1] or [-1, 1].
+	float readComponent(const uint8_t* data, uint32_t componentType, bool normalized)
+	{
+		switch (componentType)
+		{
+		case ComponentByte:
+		{
+			int8_t value;
+			std::memcpy(&value, data, sizeof(value));
+			return normalized ? (std::max)(value / 127.0f, -1.0f) : static_cast<float>(value);
+		}
+		case ComponentUnsignedByte:
+			return normalized ? data[0] / 255.0f : static_cast<float>(data[0]);
+		case ComponentShort:
+		{
+			int16_t value;
+			std::memcpy(&value, data, sizeof(value));
+			return normalized ? (std::max)(value / 32767.0f, -1.0f) : static_cast<float>(value);
+		}
+		case ComponentUnsignedShort:
+		{
+			uint16_t value;
+			std::memcpy(&value, data, sizeof(value));
+			return normalized ? value / 65535.0f : static_cast<float>(value);
+		}
+		case ComponentUnsignedInt:
+		{
+			uint32_t value;
+			std::memcpy(&value, data, sizeof(value));
+			return static_cast<float>(value);
+		}
+		default:
+		{
+			float value;
+			std::memcpy(&value, data, sizeof(value));
+			return value;
+		}
+		}
+	}
+
+	glm::vec3 readVec3(const GlbLoader::Stream& stream, size_t index)
+	{
+		const uint8_t* element = stream.data + index * stream.stride;
+
+		glm::vec3 value;
+		if (isFloatVec3(stream))
+		{
+			std::memcpy(&value, element, sizeof(value));
+			return value;
+		}
+
+		uint32_t componentSize = getComponentSize(stream.componentType);
+		for (int c = 0; c < 3; c++)
+			value[c] = readComponent(element + c * componentSize, stream.componentType, stream.normalized);
+		return value;
+	}
+
+	uint32_t readIndex(const GlbLoader::Stream& stream, size_t index)
+	{
+		const uint8_t* element = stream.data + index * stream.stride;
+		switch (stream.componentType)
+		{
+		case ComponentUnsignedByte:
+			return element[0];
+		case ComponentUnsignedShort:
+		{
+			uint16_t value;
+			std::memcpy(&value, element, sizeof(value));
+			return value;
+		}
+		default:
+		{
+			uint32_t value;
+			std::memcpy(&value, element, sizeof(value));
+			return value;
+		}
+		}
+	}
+}
+
+bool GlbLoader::isGlbFile(const std::string& path)
+{
+	if (path.size() < 4)
+		return false;
+
+	std::string extension = path.substr(path.size() - 4);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+	return extension == ".glb";
+}
+
+bool GlbLoader::open(const std::string& path)
+{
+	close();
+
+	if (!m_file.open(path))
+		return false;
+
+	// ======================================
+	// Header and chunks
+	// ======================================
+	const uint8_t* data = m_file.data();
+	uint64_t       size = m_file.size();
+
+	uint32_t header[3];
+	if (size < sizeof(header))
+	{
+		close();
+		return false;
+	}
+	std::memcpy(header, data, sizeof(header));
+	if (header[0] != GlbMagic || header[1] != GlbVersion || header[2] > size)
+	{
+		close();
+		return false;
+	}
+
+	// The JSON chunk comes first, an optional binary chunk after it. Unknown chunks are skipped.
+	Document       document;
+	const char*    json     = nullptr;
+	uint64_t       jsonSize = 0;
+	for (uint64_t offset = sizeof(header); offset + 8 <= header[2];)
+	{
+		uint32_t chunk[2];
+		std::memcpy(chunk, data + offset, sizeof(chunk));
+		offset += sizeof(chunk);
+		if (chunk[0] > header[2] - offset)
+			break;
+
+		if (chunk[1] == GlbChunkJson && json == nullptr)
+		{
+			json     = reinterpret_cast<const char*>(data + offset);
+			jsonSize = chunk[0];
+		}
+		else if (chunk[1] == GlbChunkBin && document.bin == nullptr)
+		{
+			document.bin     = data + offset;
+			document.binSize = chunk[0];
+		}
+
+		// Chunks are 4 byte aligned.
+		offset += (static_cast<uint64_t>(chunk[0]) + 3) & ~3ull;
+	}
+
+	if (json == nullptr || !JsonParser(json, json + jsonSize).parse(document.root) || document.root.type != JsonValue::Type::Object)
+	{
+		std::cout << "[ERROR] " << path << " has no valid glTF JSON chunk" << std::endl;
+		close();
+		return false;
+	}
+
+	// ======================================
+	// Triangle primitives of every mesh
+	// ======================================
+	const JsonValue* meshes = document.root.find("meshes");
+	for (size_t m = 0; meshes != nullptr && m < meshes->items.size(); m++)
+	{
+		const JsonValue* primitives = meshes->items[m].find("primitives");
+		for (size_t p = 0; primitives != nullptr && p < primitives->items.size(); p++)
+		{
+			const JsonValue& primitive = primitives->items[p];
+
+			uint64_t mode;
+			if (!getUInt(primitive, "mode", 6, ModeTriangles, mode) || mode != ModeTriangles)
+				continue;
+
+			const JsonValue* attributes = primitive.find("attributes");
+			uint64_t         positionAccessor, normalAccessor, indexAccessor;
+
+			Primitive resolved;
+			bool valid = attributes != nullptr && getUInt(attributes->find("POSITION"), std::numeric_limits<uint32_t>::max(), positionAccessor) &&
+				resolveAccessor(document, positionAccessor, resolved.positions) && resolved.positions.components == 3;
+
+			if (valid && attributes->find("NORMAL") != nullptr)
+			{
+				valid = getUInt(attributes->find("NORMAL"), std::numeric_limits<uint32_t>::max(), normalAccessor) &&
+					resolveAccessor(document, normalAccessor, resolved.normals) && resolved.normals.components == 3 &&
+					resolved.normals.count == resolved.positions.count;
+			}
+
+			if (valid && primitive.find("indices") != nullptr)
+			{
+				valid = getUInt(primitive.find("indices"), std::numeric_limits<uint32_t>::max(), indexAccessor) &&
+					resolveAccessor(document, indexAccessor, resolved.indices) && resolved.indices.components == 1 &&
+					(resolved.indices.componentType == ComponentUnsignedByte || resolved.indices.componentType == ComponentUnsignedShort || resolved.indices.componentType == ComponentUnsignedInt);
+			}
+
+			if (!valid)
+			{
+				std::cout << "[ERROR] " << path << ": primitive " << p << " of mesh " << m << " uses accessors which cannot be read" << std::endl;
+				close();
+				return false;
+			}
+
+			if (resolved.positions.count > 0)
+				m_primitives.push_back(resolved);
+		}
+	}
+
+	return true;
+}
+
+void GlbLoader::close()
+{
+	m_primitives.clear();
+	m_file.close();
+}
+
+const std::vector<GlbLoader::Primitive>& GlbLoader::getPrimitives() const
+{
+	return m_primitives;
+}
+
+uint32_t GlbLoader::getIndexCount(const Primitive& primitive)
+{
+	uint32_t count = primitive.indices.count > 0 ? primitive.indices.count : primitive.positions.count;
+	return count - count % 3;
+}
+
+bool GlbLoader::isVertexLayout(const Primitive& primitive)
+{
+	return isFloatVec3(primitive.positions) && primitive.positions.stride == sizeof(MeshLoader::Vertex) &&
+		isFloatVec3(primitive.normals) && primitive.normals.stride == sizeof(MeshLoader::Vertex) &&
+		primitive.normals.data == primitive.positions.data + offsetof(MeshLoader::Vertex, normal);
+}
+
+void GlbLoader::writeVertices(const Primitive& primitive, MeshLoader::Vertex* dst, size_t begin, size_t end)
+{
+	if (isVertexLayout(primitive))
+	{
+		std::memcpy(dst + begin, primitive.positions.data + begin * sizeof(MeshLoader::Vertex), (end - begin) * sizeof(MeshLoader::Vertex));
+		return;
+	}
+
+	for (size_t v = begin; v < end; v++)
+	{
+		dst[v].position = readVec3(primitive.positions, v);
+		dst[v].normal   = primitive.normals.count > 0 ? readVec3(primitive.normals, v) : glm::vec3(0.0f);
+	}
+}
+
+bool GlbLoader::writeIndices(const Primitive& primitive, uint32_t vertexOffset, uint32_t* dst, size_t begin, size_t end)
+{
+	const uint32_t nVertices = primitive.positions.count;
+	if (primitive.indices.count == 0)
+	{
+		for (size_t i = begin; i < end; i++)
+			dst[i] = vertexOffset + static_cast<uint32_t>(i);
+		return true;
+	}
+
+	bool inRange = true;
+	if (primitive.indices.componentType == ComponentUnsignedInt && primitive.indices.stride == sizeof(uint32_t) && vertexOffset == 0)
+	{
+		std::memcpy(dst + begin, primitive.indices.data + begin * sizeof(uint32_t), (end - begin) * sizeof(uint32_t));
+		for (size_t i = begin; i < end; i++)
+			inRange &= dst[i] < nVertices;
+		return inRange;
+	}
+
+	for (size_t i = begin; i < end; i++)
+	{
+		uint32_t index = readIndex(primitive.indices, i);
+		inRange &= index < nVertices;
+		dst[i] = vertexOffset + index;
+	}
+	return inRange;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "MeshLoader.h"
+
+// Reads the triangle meshes of a binary glTF 2.0 file (.glb) straight from a mapping of the file,
+// without an intermediate scene.
+//
+// open() parses the JSON chunk and resolves the POSITION, NORMAL and indices accessors of every
+// triangle primitive into views of the binary chunk, nothing is copied yet. The write functions then
+// fill the MeshLoader streams: positions and normals interleaved as floats with the stride of
+// MeshLoader::Vertex and 32-bit indices are copied as they are, any other layout or component type
+// is converted. Like the assimp import, the primitives are taken as they are stored, without the
+// node transforms.
+class GlbLoader
+{
+public:
+	// A typed view of an accessor inside the mapped binary chunk.
+	struct Stream
+	{
+		const uint8_t* data          = nullptr;
+		uint32_t       count         = 0;
+		uint32_t       stride        = 0;
+		uint32_t       componentType = 0;   // the GL enum of the accessor
+		uint32_t       components    = 0;
+		bool           normalized    = false;
+	};
+
+	struct Primitive
+	{
+		Stream positions;
+		Stream normals;   // count 0 if the primitive has none
+		Stream indices;   // count 0 if the primitive is not indexed
+	};
+
+	GlbLoader() = default;
+	~GlbLoader() = default;
+
+	GlbLoader(const GlbLoader&) = delete;
+	GlbLoader& operator=(const GlbLoader&) = delete;
+
+	static bool isGlbFile(const std::string& path);
+
+	// Maps the file and resolves the primitives. False if it is no GLB 2.0 file or uses what is not
+	// read here: external buffers, sparse accessors. Points, lines, strips and fans are skipped.
+	bool open(const std::string& path);
+	void close();
+
+	const std::vector<Primitive>& getPrimitives() const;
+
+	// Of a primitive in the MeshLoader streams, the vertices of a primitive without indices are
+	// drawn as a triangle list.
+	static uint32_t getIndexCount(const Primitive& primitive);
+
+	// True if writeVertices() copies the vertices as they are.
+	static bool isVertexLayout(const Primitive& primitive);
+
+	// Writes the vertices [begin, end) of a primitive to dst[begin, end) as MeshLoader::Vertex.
+	// Normals are zero if the primitive has none.
+	static void writeVertices(const Primitive& primitive, MeshLoader::Vertex* dst, size_t begin, size_t end);
+
+	// Writes the indices [begin, end) of a primitive plus vertexOffset to dst[begin, end). False if
+	// one of them is not a vertex of the primitive.
+	static bool writeIndices(const Primitive& primitive, uint32_t vertexOffset, uint32_t* dst, size_t begin, size_t end);
+
+private:
+	MappedFile             m_file;
+	std::vector<Primitive> m_primitives;
+};
@@ -0,0 +1,390 @@
+#include "GpuCuller.h"
+
+#include "VkRenderer.h"
+
+#include <array>
+#include <iostream>
+#include <string.h>
+
+static const uint32_t CullWorkGroupSize = 128;
+
+GpuCuller::GpuCuller(VkRenderer& renderer, ShaderVariantCache& shaders): renderer(renderer)
+{
+	initDescriptors();
+
+	m_occlusionParamsBuffer = renderer.createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, sizeof(OcclusionParams));
+
+	// Every pass in a variant without and with the depth pyramid test.
+	const std::array<const char*, PassCount> shaderFiles =
+	{
+		"glsl/cullObjects.comp", "glsl/cullMeshlets.comp", "glsl/cullObjects.comp", "glsl/cullMeshlets.comp"
+	};
+
+	for (uint32_t pass = 0; pass < PassCount; pass++)
+	{
+		ShaderDefines defines;
+		defines.set("OCCLUSION_CULLING", pass == PassObjectsOcclusion || pass == PassMeshletsOcclusion);
+
+		ShaderStage computeShader;
+		if (!shaders.getVariant(shaderFiles[pass], VK_SHADER_STAGE_COMPUTE_BIT, "main", defines, computeShader))
+		{
+			std::cout << "[ERROR] Cannot compile the culling shader " << shaderFiles[pass] << "." << std::endl;
+			continue;
+		}
+
+		m_pipelines[pass] =
+			std::unique_ptr<ComputePipeline>(
+				new ComputePipeline(renderer, { m_descriptorSetLayout }, computeShader, sizeof(CullParams))
+				);
+	}
+
+	if (renderer.isDeviceExtensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+	{
+		m_vkCmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+			vkGetDeviceProcAddr(renderer.getVkDevice(), "vkCmdDrawIndexedIndirectCountKHR"));
+	}
+}
+
+GpuCuller::~GpuCuller()
+{
+	for (auto& pipeline : m_pipelines)
+		pipeline.reset(nullptr);
+	destroyBuffers();
+	renderer.destroyBuffer(m_occlusionParamsBuffer);
+
+	vkDestroyDescriptorPool(renderer.getVkDevice(), m_descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(renderer.getVkDevice(), m_descriptorSetLayout, nullptr);
+}
+
+bool GpuCuller::isSupported() const
+{
+	return m_pipelines[PassObjects] != nullptr && renderer.getVkEnabledFeatures().drawIndirectFirstInstance == VK_TRUE;
+}
+
+void GpuCuller::initDescriptors()
+{
+	// 0 objects, 1 draw commands, 2 draw count, 3 meshlets, 4 depth pyramid, 5 occlusion parameters
+	std::array<VkDescriptorSetLayoutBinding, 6> bindings{};
+	for (uint32_t i = 0; i < bindings.size(); i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		bindings[i].pImmutableSamplers = nullptr;
+	}
+	bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
+	descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	descriptorSetLayoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	descriptorSetLayoutCreateInfo.pBindings = bindings.data();
+	vkCreateDescriptorSetLayout(renderer.getVkDevice(), &descriptorSetLayoutCreateInfo, nullptr, &m_descriptorSetLayout);
+
+	std::array<VkDescriptorPoolSize, 3> descriptorSetPoolSizes{};
+	descriptorSetPoolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorSetPoolSizes[0].descriptorCount = 4;
+	descriptorSetPoolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorSetPoolSizes[1].descriptorCount = 1;
+	descriptorSetPoolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descriptorSetPoolSizes[2].descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+	descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descriptorPoolCreateInfo.maxSets = 1;
+	descriptorPoolCreateInfo.poolSizeCount = static_cast<uint32_t>(descriptorSetPoolSizes.size());
+	descriptorPoolCreateInfo.pPoolSizes = descriptorSetPoolSizes.data();
+	vkCreateDescriptorPool(renderer.getVkDevice(), &descriptorPoolCreateInfo, nullptr, &m_descriptorPool);
+
+	VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+	descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	descriptorSetAllocateInfo.descriptorSetCount = 1;
+	descriptorSetAllocateInfo.pSetLayouts = &m_descriptorSetLayout;
+	descriptorSetAllocateInfo.descriptorPool = m_descriptorPool;
+	vkAllocateDescriptorSets(renderer.getVkDevice(), &descriptorSetAllocateInfo, &m_descriptorSet);
+}
+
+void GpuCuller::updateDescriptorSet()
+{
+	// Bindings whose buffer does not exist yet are left out, the meshlets are optional.
+	std::array<VkBuffer, 4> buffers =
+	{
+		m_objectCapacity  > 0 ? m_objectBuffer.getVkBuffer()      : VK_NULL_HANDLE,
+		m_commandCapacity > 0 ? m_drawCommandBuffer.getVkBuffer() : VK_NULL_HANDLE,
+		m_commandCapacity > 0 ? m_drawCountBuffer.getVkBuffer()   : VK_NULL_HANDLE,
+		m_meshletCapacity > 0 ? m_meshletBuffer.getVkBuffer()     : VK_NULL_HANDLE
+	};
+
+	std::array<VkDescriptorBufferInfo, 4> descriptorBufferInfos{};
+	std::array<VkWriteDescriptorSet, 4>   descriptorWrites{};
+	uint32_t nDescriptorWrites = 0;
+	for (uint32_t i = 0; i < buffers.size(); i++)
+	{
+		if (buffers[i] == VK_NULL_HANDLE)
+			continue;
+
+		descriptorBufferInfos[i].buffer = buffers[i];
+		descriptorBufferInfos[i].offset = 0;
+		descriptorBufferInfos[i].range = VK_WHOLE_SIZE;
+
+		VkWriteDescriptorSet& descriptorWrite = descriptorWrites[nDescriptorWrites++];
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = m_descriptorSet;
+		descriptorWrite.dstBinding = i;
+		descriptorWrite.dstArrayElement = 0;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrite.pBufferInfo = &descriptorBufferInfos[i];
+	}
+
+	vkUpdateDescriptorSets(renderer.getVkDevice(), nDescriptorWrites, descriptorWrites.data(), 0, nullptr);
+}
+
+void GpuCuller::reserveDrawCommands(uint32_t nDrawCommands)
+{
+	if (nDrawCommands <= m_commandCapacity)
+		return;
+
+	if (m_commandCapacity > 0)
+	{
+		renderer.destroyBuffer(m_drawCommandBuffer);
+		renderer.destroyBuffer(m_drawCountBuffer);
+	}
+
+	m_commandCapacity   = nDrawCommands;
+	m_drawCommandBuffer = renderer.createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, m_commandCapacity * sizeof(VkDrawIndexedIndirectCommand));
+	m_drawCountBuffer   = renderer.createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(uint32_t));
+}
+
+void GpuCuller::destroyBuffers()
+{
+	if (m_objectCapacity > 0)
+		renderer.destroyBuffer(m_objectBuffer);
+	if (m_meshletCapacity > 0)
+		renderer.destroyBuffer(m_meshletBuffer);
+	if (m_commandCapacity > 0)
+	{
+		renderer.destroyBuffer(m_drawCommandBuffer);
+		renderer.destroyBuffer(m_drawCountBuffer);
+	}
+
+	m_objectCapacity  = 0;
+	m_meshletCapacity = 0;
+	m_commandCapacity = 0;
+}
+
+void GpuCuller::setObjects(const std::vector<CullObject>& objects)
+{
+	m_nObjects = static_cast<uint32_t>(objects.size());
+	if (m_nObjects == 0)
+		return;
+
+	if (m_nObjects > m_objectCapacity)
+	{
+		if (m_objectCapacity > 0)
+			renderer.destroyBuffer(m_objectBuffer);
+
+		m_objectCapacity = m_nObjects;
+		m_objectBuffer   = renderer.createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_objectCapacity * sizeof(CullObject));
+
+		reserveDrawCommands(m_nObjects);
+		updateDescriptorSet();
+	}
+
+	void* objectData = renderer.getBufferAllocator()->mapBuffer(m_objectBuffer);
+	memcpy(objectData, objects.data(), objects.size() * sizeof(CullObject));
+	renderer.getBufferAllocator()->unmapBuffer(m_objectBuffer);
+}
+
+uint32_t GpuCuller::getNumObjects() const
+{
+	return m_nObjects;
+}
+
+const Buffer& GpuCuller::getObjectBuffer() const
+{
+	return m_objectBuffer;
+}
+
+void GpuCuller::setMeshlets(const std::vector<CullMeshlet>& meshlets)
+{
+	m_nMeshlets = static_cast<uint32_t>(meshlets.size());
+	if (m_nMeshlets == 0)
+		return;
+
+	if (m_nMeshlets > m_meshletCapacity)
+	{
+		if (m_meshletCapacity > 0)
+			renderer.destroyBuffer(m_meshletBuffer);
+
+		m_meshletCapacity = m_nMeshlets;
+		m_meshletBuffer   = renderer.createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_meshletCapacity * sizeof(CullMeshlet));
+
+		reserveDrawCommands(m_nMeshlets);
+		updateDescriptorSet();
+	}
+
+	void* meshletData = renderer.getBufferAllocator()->mapBuffer(m_meshletBuffer);
+	memcpy(meshletData, meshlets.data(), meshlets.size() * sizeof(CullMeshlet));
+	renderer.getBufferAllocator()->unmapBuffer(m_meshletBuffer);
+}
+
+uint32_t GpuCuller::getNumMeshlets() const
+{
+	return m_nMeshlets;
+}
+
+bool GpuCuller::isCullingMeshlets() const
+{
+	return m_pipelines[PassMeshlets] != nullptr && m_nMeshlets > 0;
+}
+
+void GpuCuller::setBackfaceCulling(bool enabled)
+{
+	m_backfaceCulling = enabled;
+}
+
+void GpuCuller::setOcclusionPyramid(const HiZPyramid* pyramid)
+{
+	m_occlusionPyramid = pyramid != nullptr && pyramid->isSupported() ? pyramid : nullptr;
+	if (m_occlusionPyramid == nullptr)
+		return;
+
+	VkDescriptorImageInfo pyramidImageInfo{};
+	pyramidImageInfo.sampler     = m_occlusionPyramid->getSampler();
+	pyramidImageInfo.imageView   = m_occlusionPyramid->getImageView();
+	pyramidImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	VkDescriptorBufferInfo occlusionParamsInfo{};
+	occlusionParamsInfo.buffer = m_occlusionParamsBuffer.getVkBuffer();
+	occlusionParamsInfo.offset = 0;
+	occlusionParamsInfo.range  = sizeof(OcclusionParams);
+
+	std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+	descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[0].dstSet = m_descriptorSet;
+	descriptorWrites[0].dstBinding = 4;
+	descriptorWrites[0].descriptorCount = 1;
+	descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorWrites[0].pImageInfo = &pyramidImageInfo;
+
+	descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[1].dstSet = m_descriptorSet;
+	descriptorWrites[1].dstBinding = 5;
+	descriptorWrites[1].descriptorCount = 1;
+	descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descriptorWrites[1].pBufferInfo = &occlusionParamsInfo;
+
+	vkUpdateDescriptorSets(renderer.getVkDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
+uint32_t GpuCuller::getNumDrawCommands() const
+{
+	return isCullingMeshlets() ? m_nMeshlets : m_nObjects;
+}
+
+void GpuCuller::cull(VkCommandBuffer cmdBuffer, const glm::mat4& viewProjMatrix, const glm::vec3& cameraPosition)
+{
+	if (!isSupported() || m_nObjects == 0)
+		return;
+
+	// ======================================
+	// Frustum planes (Gribb/Hartmann)
+	// ======================================
+	CullParams params{};
+	glm::mat4 m = glm::transpose(viewProjMatrix);
+	params.frustumPlanes[0] = m[3] + m[0];   // left
+	params.frustumPlanes[1] = m[3] - m[0];   // right
+	params.frustumPlanes[2] = m[3] + m[1];   // bottom
+	params.frustumPlanes[3] = m[3] - m[1];   // top
+	params.frustumPlanes[4] = m[3] + m[2];   // near
+	params.frustumPlanes[5] = m[3] - m[2];   // far
+	for (auto& plane : params.frustumPlanes)
+		plane /= glm::length(glm::vec3(plane));
+
+	params.count           = getNumDrawCommands();
+	params.compact         = m_vkCmdDrawIndexedIndirectCount != nullptr ? 1 : 0;
+	params.backfaceCulling = m_backfaceCulling ? 1 : 0;
+	params.cameraPosition  = glm::vec4(cameraPosition, 1.0f);
+
+	// ======================================
+	// Occlusion against last frame's depth
+	// ======================================
+	bool occlusionCulling =
+		m_occlusionPyramid != nullptr && m_occlusionPyramid->isBuilt() &&
+		m_pipelines[isCullingMeshlets() ? PassMeshletsOcclusion : PassObjectsOcclusion] != nullptr;
+
+	if (occlusionCulling)
+	{
+		OcclusionParams occlusionParams{};
+		occlusionParams.viewProjMatrix = m_occlusionPyramid->getViewProjMatrix();
+		occlusionParams.pyramidSize    = glm::vec4(
+			static_cast<float>(m_occlusionPyramid->getWidth()),
+			static_cast<float>(m_occlusionPyramid->getHeight()),
+			static_cast<float>(m_occlusionPyramid->getNumLevels()), 0.0f);
+
+		void* occlusionData = renderer.getBufferAllocator()->mapBuffer(m_occlusionParamsBuffer);
+		memcpy(occlusionData, &occlusionParams, sizeof(OcclusionParams));
+		renderer.getBufferAllocator()->unmapBuffer(m_occlusionParamsBuffer);
+	}
+
+	Pass pass = isCullingMeshlets() ?
+		(occlusionCulling ? PassMeshletsOcclusion : PassMeshlets) :
+		(occlusionCulling ? PassObjectsOcclusion : PassObjects);
+	ComputePipeline* pipeline = m_pipelines[pass].get();
+
+	// The commands and the count of the previous frame may still be read by its indirect draw.
+	vkCmdPipelineBarrier(cmdBuffer,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		0, nullptr, 0, nullptr, 0, nullptr);
+
+	vkCmdFillBuffer(cmdBuffer, m_drawCountBuffer.getVkBuffer(), 0, sizeof(uint32_t), 0);
+
+	VkMemoryBarrier clearBarrier{};
+	clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(cmdBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipeline());
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipelineLayout(), 0, 1, &m_descriptorSet, 0, nullptr);
+	vkCmdPushConstants(cmdBuffer, pipeline->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullParams), &params);
+	vkCmdDispatch(cmdBuffer, (params.count + CullWorkGroupSize - 1) / CullWorkGroupSize, 1, 1);
+
+	VkMemoryBarrier drawBarrier{};
+	drawBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	drawBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	drawBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+	vkCmdPipelineBarrier(cmdBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0,
+		1, &drawBarrier, 0, nullptr, 0, nullptr);
+}
+
+void GpuCuller::draw(VkCommandBuffer cmdBuffer)
+{
+	if (!isSupported() || m_nObjects == 0)
+		return;
+
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	const uint32_t nDrawCommands = getNumDrawCommands();
+
+	if (m_vkCmdDrawIndexedIndirectCount != nullptr)
+	{
+		m_vkCmdDrawIndexedIndirectCount(cmdBuffer, m_drawCommandBuffer.getVkBuffer(), 0, m_drawCountBuffer.getVkBuffer(), 0, nDrawCommands, stride);
+	}
+	else if (renderer.getVkEnabledFeatures().multiDrawIndirect == VK_TRUE)
+	{
+		vkCmdDrawIndexedIndirect(cmdBuffer, m_drawCommandBuffer.getVkBuffer(), 0, nDrawCommands, stride);
+	}
+	else
+	{
+		// Without multi draw indirect every command needs its own draw call.
+		for (uint32_t i = 0; i < nDrawCommands; i++)
+			vkCmdDrawIndexedIndirect(cmdBuffer, m_drawCommandBuffer.getVkBuffer(), i * stride, 1, stride);
+	}
+}
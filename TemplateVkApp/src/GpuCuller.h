@@ -0,0 +1,146 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <memory>
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include "Buffer.h"
+#include "ComputePipeline.h"
+#include "ShaderVariantCache.h"
+#include "HiZPyramid.h"
+
+class VkRenderer;
+
+// Matches CullObject in cullObjects.comp and ply.vert (std430).
+struct CullObject
+{
+	glm::vec4 boundingSphere;   // object space center, radius
+	glm::mat4 transform;
+	uint32_t  firstIndex;
+	uint32_t  indexCount;
+	int32_t   vertexOffset;
+	uint32_t  unused;
+};
+
+// Matches CullMeshlet in cullMeshlets.comp (std430). A cluster of triangles of one object, drawn as
+// an index range.
+struct CullMeshlet
+{
+	glm::vec4 boundingSphere;   // object space center, radius
+	glm::vec4 cone;             // object space axis, cutoff, see MeshletBuilder::Bounds
+	uint32_t  firstIndex;
+	uint32_t  indexCount;
+	uint32_t  objectIndex;
+	uint32_t  unused;
+};
+
+// Frustum culling on the GPU. Object bounds and transforms live in a storage buffer, a compute pass
+// writes one VkDrawIndexedIndirectCommand per visible object and graphics draws them with a single
+// indirect draw, so the CPU cost does not grow with the number of objects.
+//
+// Uses vkCmdDrawIndexedIndirectCountKHR when VK_KHR_draw_indirect_count is enabled. Otherwise every
+// object keeps a command and culled ones are drawn with zero instances.
+//
+// With meshlets set the pass culls meshlets instead of whole objects: each one is tested against the
+// frustum and, with back-face culling on, against its normal cone. The draws then index the meshlet
+// index buffer (MeshletBuilder::buildIndexBuffer()), objects are still needed for the transforms.
+//
+// With a depth pyramid set, objects and meshlets which were hidden behind the depth of the previous
+// frame are rejected as well, see HiZPyramid.
+class GpuCuller
+{
+public:
+	GpuCuller(VkRenderer& renderer, ShaderVariantCache& shaders);
+	~GpuCuller();
+
+	// The object index is passed as firstInstance, which needs the drawIndirectFirstInstance feature.
+	bool isSupported() const;
+
+	// Uploads the objects, reallocating the buffers if they grew.
+	void setObjects(const std::vector<CullObject>& objects);
+	uint32_t getNumObjects() const;
+
+	// Bound by the vertex shader to fetch the object transforms.
+	const Buffer& getObjectBuffer() const;
+
+	// Uploads the meshlets and switches to meshlet culling. An empty list switches back to objects.
+	void setMeshlets(const std::vector<CullMeshlet>& meshlets);
+	uint32_t getNumMeshlets() const;
+	bool isCullingMeshlets() const;
+
+	// Rejects meshlets whose faces all point away from the camera. Only valid for closed meshes, like
+	// back-face culling in the rasterizer. Off by default.
+	void setBackfaceCulling(bool enabled);
+
+	// Enables occlusion culling against the pyramid once it has been built. Not owned, nullptr disables it.
+	void setOcclusionPyramid(const HiZPyramid* pyramid);
+
+	// Records the culling pass. Has to be outside of a render pass. The planes are extracted from
+	// viewProjMatrix, so they are in the space the object transforms map to, and so is cameraPosition.
+	void cull(VkCommandBuffer cmdBuffer, const glm::mat4& viewProjMatrix, const glm::vec3& cameraPosition);
+
+	// Records the indirect draw. Has to be inside the render pass with vertex and index buffers bound.
+	void draw(VkCommandBuffer cmdBuffer);
+
+private:
+	enum Pass
+	{
+		PassObjects,
+		PassMeshlets,
+		PassObjectsOcclusion,
+		PassMeshletsOcclusion,
+		PassCount
+	};
+
+	// Matches the Occlusion uniform block of the culling shaders (std140).
+	struct OcclusionParams
+	{
+		glm::mat4 viewProjMatrix;   // the matrix the pyramid's depth was rendered with
+		glm::vec4 pyramidSize;      // width, height of level 0, number of levels, unused
+	};
+
+	// Matches the push constants of cullObjects.comp and cullMeshlets.comp.
+	struct CullParams
+	{
+		glm::vec4 frustumPlanes[6];
+		uint32_t  count;
+		uint32_t  compact;
+		uint32_t  backfaceCulling;
+		uint32_t  unused;
+		glm::vec4 cameraPosition;
+	};
+
+	void initDescriptors();
+	void updateDescriptorSet();
+	void reserveDrawCommands(uint32_t nDrawCommands);
+	void destroyBuffers();
+
+	uint32_t getNumDrawCommands() const;
+
+	VkRenderer&                      renderer;
+	std::array<std::unique_ptr<ComputePipeline>, PassCount> m_pipelines;
+
+	VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool      m_descriptorPool      = VK_NULL_HANDLE;
+	VkDescriptorSet       m_descriptorSet       = VK_NULL_HANDLE;
+
+	PFN_vkCmdDrawIndexedIndirectCountKHR m_vkCmdDrawIndexedIndirectCount = nullptr;
+
+	bool     m_backfaceCulling = false;
+
+	const HiZPyramid* m_occlusionPyramid = nullptr;
+	Buffer            m_occlusionParamsBuffer;
+
+	uint32_t m_nObjects        = 0;
+	uint32_t m_nMeshlets       = 0;
+	uint32_t m_objectCapacity  = 0;
+	uint32_t m_meshletCapacity = 0;
+	uint32_t m_commandCapacity = 0;
+	Buffer   m_objectBuffer;
+	Buffer   m_meshletBuffer;
+	Buffer   m_drawCommandBuffer;
+	Buffer   m_drawCountBuffer;
+};
@@ -0,0 +1,397 @@
+#include "GpuPrimitives.h"
+
+#include "VkRenderer.h"
+
+#include <algorithm>
+#include <iostream>
+
+static const uint32_t LocalWorkGroupSize = 128;
+
+// Elements per workgroup of the scan and reduction kernels, and of the radix sort kernels.
+static const uint32_t ScanTileSize  = 4 * LocalWorkGroupSize;
+static const uint32_t RadixTileSize = LocalWorkGroupSize;
+static const uint32_t RadixDigits   = 16;
+static const uint32_t RadixBits     = 4;
+
+static const uint32_t DescriptorSetsPerPool = 32;
+
+static uint32_t divideRoundUp(uint32_t a, uint32_t b)
+{
+	return (a + b - 1) / b;
+}
+
+GpuPrimitives::GpuPrimitives(VkRenderer& renderer, ShaderVariantCache& shaders): renderer(renderer)
+{
+	initDescriptors();
+
+	m_dummyBuffer = renderer.createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, 16);
+
+	// Subgroup arithmetic needs SPIR-V 1.3, so Vulkan 1.1, and has to be supported in compute shaders.
+	const VkPhysicalDeviceSubgroupProperties& subgroups = renderer.getVkSubgroupProperties();
+	const VkSubgroupFeatureFlags requiredOperations = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
+	m_useSubgroups =
+		renderer.getVkApiVersion() >= VK_API_VERSION_1_1 &&
+		(subgroups.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) != 0 &&
+		(subgroups.supportedOperations & requiredOperations) == requiredOperations;
+
+	struct KernelSource
+	{
+		const char* file;
+		int         reduceOp;
+		bool        floatElements;
+		bool        key64;
+	};
+
+	const std::array<KernelSource, KernelCount> kernelSources =
+	{ {
+		{ "glsl/scanBlocks.comp",     0, false, false },
+		{ "glsl/scanAddOffsets.comp", 0, false, false },
+		{ "glsl/compactScatter.comp", 0, false, false },
+		{ "glsl/reduce.comp",         ReduceSum, false, false },
+		{ "glsl/reduce.comp",         ReduceMin, false, false },
+		{ "glsl/reduce.comp",         ReduceMax, false, false },
+		{ "glsl/reduce.comp",         ReduceSum, true,  false },
+		{ "glsl/reduce.comp",         ReduceMin, true,  false },
+		{ "glsl/reduce.comp",         ReduceMax, true,  false },
+		{ "glsl/radixHistogram.comp", 0, false, false },
+		{ "glsl/radixHistogram.comp", 0, false, true  },
+		{ "glsl/radixScatter.comp",   0, false, false },
+		{ "glsl/radixScatter.comp",   0, false, true  }
+	} };
+
+	for (uint32_t kernel = 0; kernel < KernelCount; kernel++)
+	{
+		const KernelSource& source = kernelSources[kernel];
+
+		// Shaders ignore the defines they do not know.
+		ShaderDefines defines;
+		defines.set("SUBGROUP_OPS", m_useSubgroups);
+		defines.set("REDUCE_OP", source.reduceOp);
+		defines.set("FLOAT_ELEMENTS", source.floatElements);
+		defines.set("KEY64", source.key64);
+
+		ShaderStage computeShader;
+		if (!shaders.getVariant(source.file, VK_SHADER_STAGE_COMPUTE_BIT, "main", defines, computeShader))
+		{
+			std::cout << "[ERROR] Cannot compile GPU primitive kernel " << source.file << std::endl;
+			continue;
+		}
+
+		m_pipelines[kernel] =
+			std::unique_ptr<ComputePipeline>(
+				new ComputePipeline(renderer, { m_descriptorSetLayout }, computeShader, sizeof(KernelParams))
+				);
+	}
+}
+
+GpuPrimitives::~GpuPrimitives()
+{
+	for (auto& pipeline : m_pipelines)
+		pipeline.reset(nullptr);
+
+	destroyScratchBuffers();
+	renderer.destroyBuffer(m_dummyBuffer);
+
+	for (VkDescriptorPool descriptorPool : m_descriptorPools)
+		vkDestroyDescriptorPool(renderer.getVkDevice(), descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(renderer.getVkDevice(), m_descriptorSetLayout, nullptr);
+}
+
+bool GpuPrimitives::isSupported() const
+{
+	for (const auto& pipeline : m_pipelines)
+	{
+		if (pipeline == nullptr)
+			return false;
+	}
+	return true;
+}
+
+bool GpuPrimitives::usesSubgroups() const
+{
+	return m_useSubgroups;
+}
+
+void GpuPrimitives::initDescriptors()
+{
+	// All kernels share one layout of storage buffers, what they hold depends on the kernel.
+	std::array<VkDescriptorSetLayoutBinding, NumBindings> bindings{};
+	for (uint32_t i = 0; i < NumBindings; i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		bindings[i].pImmutableSamplers = nullptr;
+	}
+
+	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
+	descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	descriptorSetLayoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	descriptorSetLayoutCreateInfo.pBindings = bindings.data();
+	vkCreateDescriptorSetLayout(renderer.getVkDevice(), &descriptorSetLayoutCreateInfo, nullptr, &m_descriptorSetLayout);
+}
+
+VkDescriptorSet GpuPrimitives::getDescriptorSet(const Bindings& buffers)
+{
+	auto it = m_descriptorSets.find(buffers);
+	if (it != m_descriptorSets.end())
+		return it->second;
+
+	// Pools are never freed one by one, a new one is added when the last one is full.
+	if (m_setsLeftInPool == 0)
+	{
+		VkDescriptorPoolSize descriptorSetPoolSize{};
+		descriptorSetPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorSetPoolSize.descriptorCount = NumBindings * DescriptorSetsPerPool;
+
+		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+		descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		descriptorPoolCreateInfo.maxSets = DescriptorSetsPerPool;
+		descriptorPoolCreateInfo.poolSizeCount = 1;
+		descriptorPoolCreateInfo.pPoolSizes = &descriptorSetPoolSize;
+
+		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+		vkCreateDescriptorPool(renderer.getVkDevice(), &descriptorPoolCreateInfo, nullptr, &descriptorPool);
+		m_descriptorPools.push_back(descriptorPool);
+		m_setsLeftInPool = DescriptorSetsPerPool;
+	}
+
+	VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+	descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	descriptorSetAllocateInfo.descriptorSetCount = 1;
+	descriptorSetAllocateInfo.pSetLayouts = &m_descriptorSetLayout;
+	descriptorSetAllocateInfo.descriptorPool = m_descriptorPools.back();
+
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	vkAllocateDescriptorSets(renderer.getVkDevice(), &descriptorSetAllocateInfo, &descriptorSet);
+	m_setsLeftInPool--;
+
+	std::array<VkDescriptorBufferInfo, NumBindings> descriptorBufferInfos{};
+	std::array<VkWriteDescriptorSet, NumBindings>   descriptorWrites{};
+	for (uint32_t i = 0; i < NumBindings; i++)
+	{
+		descriptorBufferInfos[i].buffer = buffers[i] != VK_NULL_HANDLE ? buffers[i] : m_dummyBuffer.getVkBuffer();
+		descriptorBufferInfos[i].offset = 0;
+		descriptorBufferInfos[i].range = VK_WHOLE_SIZE;
+
+		descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[i].dstSet = descriptorSet;
+		descriptorWrites[i].dstBinding = i;
+		descriptorWrites[i].dstArrayElement = 0;
+		descriptorWrites[i].descriptorCount = 1;
+		descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[i].pBufferInfo = &descriptorBufferInfos[i];
+	}
+	vkUpdateDescriptorSets(renderer.getVkDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+	m_descriptorSets[buffers] = descriptorSet;
+	return descriptorSet;
+}
+
+void GpuPrimitives::releaseDescriptorSets()
+{
+	m_descriptorSets.clear();
+	if (m_descriptorPools.empty())
+		return;
+
+	// Keep the first pool for the sets to come.
+	vkResetDescriptorPool(renderer.getVkDevice(), m_descriptorPools[0], 0);
+	for (size_t i = 1; i < m_descriptorPools.size(); i++)
+		vkDestroyDescriptorPool(renderer.getVkDevice(), m_descriptorPools[i], nullptr);
+
+	m_descriptorPools.resize(1);
+	m_setsLeftInPool = DescriptorSetsPerPool;
+}
+
+// ============================
+// Scratch memory
+// ============================
+void GpuPrimitives::reserve(uint32_t maxElements)
+{
+	if (maxElements <= m_capacity)
+		return;
+
+	destroyScratchBuffers();
+
+	// The sets may point to the old scratch buffers.
+	releaseDescriptorSets();
+
+	const VkBufferUsageFlags storageUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+	// The histogram of a radix sort pass is scanned too, it can be longer than the keys for few keys.
+	const uint32_t histogramSize = RadixDigits * divideRoundUp(maxElements, RadixTileSize);
+	const uint32_t scanSize      = std::max(maxElements, histogramSize);
+
+	uint32_t levelSize = scanSize;
+	do
+	{
+		levelSize = divideRoundUp(levelSize, ScanTileSize);
+		m_levelBuffers.push_back(renderer.createBuffer(storageUsage, levelSize * sizeof(uint32_t)));
+	} while (levelSize > 1);
+
+	m_offsetBuffer    = renderer.createBuffer(storageUsage, maxElements * sizeof(uint32_t));
+	m_histogramBuffer = renderer.createBuffer(storageUsage, histogramSize * sizeof(uint32_t));
+	m_sortKeyBuffer   = renderer.createBuffer(storageUsage, maxElements * sizeof(uint64_t));
+	m_sortValueBuffer = renderer.createBuffer(storageUsage, maxElements * sizeof(uint32_t));
+
+	m_capacity = maxElements;
+}
+
+uint32_t GpuPrimitives::getCapacity() const
+{
+	return m_capacity;
+}
+
+void GpuPrimitives::destroyScratchBuffers()
+{
+	if (m_capacity == 0)
+		return;
+
+	for (Buffer& buffer : m_levelBuffers)
+		renderer.destroyBuffer(buffer);
+	m_levelBuffers.clear();
+
+	renderer.destroyBuffer(m_offsetBuffer);
+	renderer.destroyBuffer(m_histogramBuffer);
+	renderer.destroyBuffer(m_sortKeyBuffer);
+	renderer.destroyBuffer(m_sortValueBuffer);
+	m_capacity = 0;
+}
+
+bool GpuPrimitives::checkCapacity(uint32_t count, const char* primitive) const
+{
+	if (count <= m_capacity)
+		return true;
+
+	std::cout << "[ERROR] GpuPrimitives::" << primitive << " on " << count << " elements, only " << m_capacity << " are reserved." << std::endl;
+	return false;
+}
+
+// ============================
+// Primitives
+// ============================
+void GpuPrimitives::exclusiveScan(VkCommandBuffer cmdBuffer, VkBuffer input, VkBuffer output, uint32_t count)
+{
+	if (count == 0 || !checkCapacity(count, "exclusiveScan"))
+		return;
+
+	scanLevel(cmdBuffer, input, output, count, 0);
+}
+
+void GpuPrimitives::scanLevel(VkCommandBuffer cmdBuffer, VkBuffer input, VkBuffer output, uint32_t count, uint32_t level)
+{
+	const uint32_t nBlocks   = divideRoundUp(count, ScanTileSize);
+	const VkBuffer blockSums = m_levelBuffers[level].getVkBuffer();
+
+	dispatch(cmdBuffer, KernelScanBlocks, { input, output, blockSums, VK_NULL_HANDLE, VK_NULL_HANDLE }, count, nBlocks, 0);
+
+	if (nBlocks > 1)
+	{
+		// The tile totals become the tile offsets.
+		scanLevel(cmdBuffer, blockSums, blockSums, nBlocks, level + 1);
+		dispatch(cmdBuffer, KernelScanAddOffsets, { VK_NULL_HANDLE, output, blockSums, VK_NULL_HANDLE, VK_NULL_HANDLE }, count, nBlocks, 0);
+	}
+}
+
+void GpuPrimitives::compact(VkCommandBuffer cmdBuffer, VkBuffer values, VkBuffer flags, VkBuffer output, VkBuffer compactedCount, uint32_t count)
+{
+	if (count == 0 || !checkCapacity(count, "compact"))
+		return;
+
+	const VkBuffer offsets = m_offsetBuffer.getVkBuffer();
+
+	exclusiveScan(cmdBuffer, flags, offsets, count);
+	dispatch(cmdBuffer, KernelCompactScatter, { values, flags, offsets, output, compactedCount }, count, divideRoundUp(count, LocalWorkGroupSize), 0);
+}
+
+void GpuPrimitives::reduce(VkCommandBuffer cmdBuffer, VkBuffer input, VkBuffer result, uint32_t count, ReduceOp op, ElementType type)
+{
+	if (count == 0 || !checkCapacity(count, "reduce"))
+		return;
+
+	// The reduce kernels are in ReduceOp order.
+	const Kernel kernel = static_cast<Kernel>((type == ElementFloat ? KernelReduceSumFloat : KernelReduceSumUint) + op);
+
+	// Every level reduces the partial results of the previous one, the last one writes the result.
+	VkBuffer source = input;
+	for (uint32_t level = 0; ; level++)
+	{
+		const uint32_t nBlocks = divideRoundUp(count, ScanTileSize);
+		const VkBuffer target  = nBlocks == 1 ? result : m_levelBuffers[level].getVkBuffer();
+
+		dispatch(cmdBuffer, kernel, { source, target, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE }, count, nBlocks, 0);
+		if (nBlocks == 1)
+			break;
+
+		source = target;
+		count  = nBlocks;
+	}
+}
+
+void GpuPrimitives::sortKeyValues(VkCommandBuffer cmdBuffer, VkBuffer keys, VkBuffer values, uint32_t count, uint32_t keyBits)
+{
+	if (count == 0 || !checkCapacity(count, "sortKeyValues"))
+		return;
+
+	if (keyBits != 32 && keyBits != 64)
+	{
+		std::cout << "[ERROR] GpuPrimitives::sortKeyValues supports 32 and 64-bit keys, not " << keyBits << "." << std::endl;
+		return;
+	}
+
+	const Kernel histogramKernel = keyBits == 64 ? KernelRadixHistogram64 : KernelRadixHistogram32;
+	const Kernel scatterKernel   = keyBits == 64 ? KernelRadixScatter64   : KernelRadixScatter32;
+
+	const uint32_t nTiles    = divideRoundUp(count, RadixTileSize);
+	const VkBuffer histogram = m_histogramBuffer.getVkBuffer();
+
+	// Ping-pong between the input and the scratch buffers. The number of passes is even, so the
+	// last one writes back to the input.
+	std::array<VkBuffer, 2> keyBuffers   = { keys,   m_sortKeyBuffer.getVkBuffer() };
+	std::array<VkBuffer, 2> valueBuffers = { values, m_sortValueBuffer.getVkBuffer() };
+
+	for (uint32_t shift = 0; shift < keyBits; shift += RadixBits)
+	{
+		const uint32_t source = (shift / RadixBits) % 2;
+		const uint32_t target = 1 - source;
+
+		dispatch(cmdBuffer, histogramKernel, { keyBuffers[source], VK_NULL_HANDLE, histogram, VK_NULL_HANDLE, VK_NULL_HANDLE }, count, nTiles, shift);
+		scanLevel(cmdBuffer, histogram, histogram, RadixDigits * nTiles, 0);
+		dispatch(cmdBuffer, scatterKernel, { keyBuffers[source], valueBuffers[source], histogram, keyBuffers[target], valueBuffers[target] }, count, nTiles, shift);
+	}
+}
+
+void GpuPrimitives::dispatch(VkCommandBuffer cmdBuffer, Kernel kernel, const Bindings& buffers, uint32_t count, uint32_t nGroups, uint32_t shift)
+{
+	ComputePipeline* pipeline = m_pipelines[kernel].get();
+	if (pipeline == nullptr || nGroups == 0)
+		return;
+
+	KernelParams params{};
+	params.count      = count;
+	params.shift      = shift;
+	params.blockCount = nGroups;
+
+	VkDescriptorSet descriptorSet = getDescriptorSet(buffers);
+
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipeline());
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipelineLayout(), 0, 1, &descriptorSet, 0, nullptr);
+	vkCmdPushConstants(cmdBuffer, pipeline->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(KernelParams), &params);
+	vkCmdDispatch(cmdBuffer, nGroups, 1, 1);
+
+	// Every kernel consumes the output of the previous one.
+	computeBarrier(cmdBuffer);
+}
+
+void GpuPrimitives::computeBarrier(VkCommandBuffer cmdBuffer)
+{
+	VkMemoryBarrier memoryBarrier{};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(cmdBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <array>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "Buffer.h"
+#include "ComputePipeline.h"
+#include "ShaderVariantCache.h"
+
+class VkRenderer;
+
+// Data parallel building blocks for GPU driven work: exclusive prefix sum, stream compaction,
+// reductions and a key/value radix sort, all on 32-bit elements in storage buffers.
+//
+// The scan is a block scan (reduce-then-scan): every workgroup scans a tile and writes its total,
+// the totals are scanned recursively and added back. It needs a few more passes than a single pass
+// decoupled look-back scan, but does not rely on forward progress between workgroups, which Vulkan
+// does not guarantee. Scan, reductions and the local sort of the radix sort use subgroup arithmetic
+// when the device supports it (Vulkan 1.1), shared memory otherwise.
+//
+// All functions only record commands. The inputs have to be visible to compute shaders, the results
+// are visible to compute shaders afterwards, other consumers need their own barrier. Scratch memory
+// comes from reserve(), so primitives recorded into command buffers which execute at the same time
+// must not use the same GpuPrimitives.
+//
+// Descriptor sets are cached per combination of buffers. Call releaseDescriptorSets() after
+// destroying buffers which were passed in, before creating new ones.
+class GpuPrimitives
+{
+public:
+	enum ReduceOp
+	{
+		ReduceSum,
+		ReduceMin,
+		ReduceMax
+	};
+
+	enum ElementType
+	{
+		ElementUint,
+		ElementFloat
+	};
+
+	GpuPrimitives(VkRenderer& renderer, ShaderVariantCache& shaders);
+	~GpuPrimitives();
+
+	// False if a kernel failed to compile.
+	bool isSupported() const;
+
+	// True if the kernels were built with subgroup operations.
+	bool usesSubgroups() const;
+
+	// Allocates the scratch buffers for up to maxElements elements. Must not be called while
+	// recorded primitives are still executing.
+	void reserve(uint32_t maxElements);
+	uint32_t getCapacity() const;
+
+	// output[i] = input[0] + ... + input[i - 1]. Input and output may be the same buffer.
+	void exclusiveScan(VkCommandBuffer cmdBuffer, VkBuffer input, VkBuffer output, uint32_t count);
+
+	// Copies values[i] with flags[i] == 1 to the front of output, keeping their order, and writes
+	// their number to compactedCount. Flags have to be 0 or 1.
+	void compact(VkCommandBuffer cmdBuffer, VkBuffer values, VkBuffer flags, VkBuffer output, VkBuffer compactedCount, uint32_t count);
+
+	// Writes the sum, minimum or maximum of the elements to the first element of result.
+	void reduce(VkCommandBuffer cmdBuffer, VkBuffer input, VkBuffer result, uint32_t count, ReduceOp op, ElementType type);
+
+	// Stable ascending sort of the keys, the 32-bit values move with them. keyBits is 32, or 64 for
+	// little endian 64-bit keys. The result is in the input buffers.
+	void sortKeyValues(VkCommandBuffer cmdBuffer, VkBuffer keys, VkBuffer values, uint32_t count, uint32_t keyBits);
+
+	void releaseDescriptorSets();
+
+	// CPU references of the primitives, what the GPU results are compared against.
+	static std::vector<uint32_t> exclusiveScanReference(const std::vector<uint32_t>& input);
+	static std::vector<uint32_t> compactReference(const std::vector<uint32_t>& values, const std::vector<uint32_t>& flags);
+	static uint32_t reduceReference(const std::vector<uint32_t>& input, ReduceOp op);
+	static float    reduceReference(const std::vector<float>& input, ReduceOp op);
+	static void     sortKeyValuesReference(std::vector<uint32_t>& keys, std::vector<uint32_t>& values);
+	static void     sortKeyValuesReference(std::vector<uint64_t>& keys, std::vector<uint32_t>& values);
+
+	// Runs every primitive on random data of the given size, compares it with the CPU reference and
+	// prints the GPU time. Returns false if a result is wrong. Waits for the queue to be idle.
+	bool runSelfTest(uint32_t count);
+
+private:
+	enum Kernel
+	{
+		KernelScanBlocks,
+		KernelScanAddOffsets,
+		KernelCompactScatter,
+		KernelReduceSumUint,
+		KernelReduceMinUint,
+		KernelReduceMaxUint,
+		KernelReduceSumFloat,
+		KernelReduceMinFloat,
+		KernelReduceMaxFloat,
+		KernelRadixHistogram32,
+		KernelRadixHistogram64,
+		KernelRadixScatter32,
+		KernelRadixScatter64,
+		KernelCount
+	};
+
+	static const uint32_t NumBindings = 5;
+	typedef std::array<VkBuffer, NumBindings> Bindings;
+
+	// Matches the push constants of the primitive kernels.
+	struct KernelParams
+	{
+		uint32_t count;
+		uint32_t shift;
+		uint32_t blockCount;
+		uint32_t unused;
+	};
+
+	void initDescriptors();
+	VkDescriptorSet getDescriptorSet(const Bindings& buffers);
+	void destroyScratchBuffers();
+
+	void scanLevel(VkCommandBuffer cmdBuffer, VkBuffer input, VkBuffer output, uint32_t count, uint32_t level);
+	void dispatch(VkCommandBuffer cmdBuffer, Kernel kernel, const Bindings& buffers, uint32_t count, uint32_t nGroups, uint32_t shift);
+	bool checkCapacity(uint32_t count, const char* primitive) const;
+
+	static void computeBarrier(VkCommandBuffer cmdBuffer);
+
+	VkRenderer& renderer;
+
+	std::array<std::unique_ptr<ComputePipeline>, KernelCount> m_pipelines;
+	bool m_useSubgroups = false;
+
+	VkDescriptorSetLayout               m_descriptorSetLayout = VK_NULL_HANDLE;
+	std::vector<VkDescriptorPool>       m_descriptorPools;
+	uint32_t                            m_setsLeftInPool = 0;
+	std::map<Bindings, VkDescriptorSet> m_descriptorSets;
+
+	// Bound to the bindings a kernel does not use.
+	Buffer m_dummyBuffer;
+
+	// Scratch, see reserve(). Level i holds the tile totals of the i-th scan level, or the partial
+	// results of the i-th reduction level.
+	uint32_t            m_capacity = 0;
+	std::vector<Buffer> m_levelBuffers;
+	Buffer              m_offsetBuffer;
+	Buffer              m_histogramBuffer;
+	Buffer              m_sortKeyBuffer;
+	Buffer              m_sortValueBuffer;
+};
@@ -0,0 +1,335 @@
+#include "GpuPrimitives.h"
+
+#include "VkRenderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <string.h>
+
+// ============================
+// CPU references
+// ============================
+std::vector<uint32_t> GpuPrimitives::exclusiveScanReference(const std::vector<uint32_t>& input)
+{
+	std::vector<uint32_t> output(input.size());
+	uint32_t sum = 0;
+	for (size_t i = 0; i < input.size(); i++)
+	{
+		output[i] = sum;
+		sum += input[i];
+	}
+	return output;
+}
+
+std::vector<uint32_t> GpuPrimitives::compactReference(const std::vector<uint32_t>& values, const std::vector<uint32_t>& flags)
+{
+	std::vector<uint32_t> output;
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		if (flags[i] != 0)
+			output.push_back(values[i]);
+	}
+	return output;
+}
+
+uint32_t GpuPrimitives::reduceReference(const std::vector<uint32_t>& input, ReduceOp op)
+{
+	switch (op)
+	{
+	case ReduceMin: return input.empty() ? std::numeric_limits<uint32_t>::max() : *std::min_element(input.begin(), input.end());
+	case ReduceMax: return input.empty() ? 0 : *std::max_element(input.begin(), input.end());
+	default:        return std::accumulate(input.begin(), input.end(), 0u);
+	}
+}
+
+float GpuPrimitives::reduceReference(const std::vector<float>& input, ReduceOp op)
+{
+	switch (op)
+	{
+	case ReduceMin: return input.empty() ?  std::numeric_limits<float>::infinity() : *std::min_element(input.begin(), input.end());
+	case ReduceMax: return input.empty() ? -std::numeric_limits<float>::infinity() : *std::max_element(input.begin(), input.end());
+	default:        return static_cast<float>(std::accumulate(input.begin(), input.end(), 0.0));   // in double, the GPU sums in a different order
+	}
+}
+
+template <typename Key>
+static void stableSortKeyValues(std::vector<Key>& keys, std::vector<uint32_t>& values)
+{
+	std::vector<uint32_t> order(keys.size());
+	std::iota(order.begin(), order.end(), 0u);
+	std::stable_sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+
+	std::vector<Key>      sortedKeys(keys.size());
+	std::vector<uint32_t> sortedValues(values.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		sortedKeys[i]   = keys[order[i]];
+		sortedValues[i] = values[order[i]];
+	}
+	keys.swap(sortedKeys);
+	values.swap(sortedValues);
+}
+
+void GpuPrimitives::sortKeyValuesReference(std::vector<uint32_t>& keys, std::vector<uint32_t>& values)
+{
+	stableSortKeyValues(keys, values);
+}
+
+void GpuPrimitives::sortKeyValuesReference(std::vector<uint64_t>& keys, std::vector<uint32_t>& values)
+{
+	stableSortKeyValues(keys, values);
+}
+
+// ============================
+// Self test and benchmark
+// ============================
+template <typename T>
+static void uploadBuffer(const VkRenderer& renderer, const Buffer& buffer, const std::vector<T>& data)
+{
+	void* bufferData = renderer.getBufferAllocator()->mapBuffer(buffer);
+	memcpy(bufferData, data.data(), data.size() * sizeof(T));
+	renderer.getBufferAllocator()->unmapBuffer(buffer);
+}
+
+template <typename T>
+static std::vector<T> downloadBuffer(const VkRenderer& renderer, const Buffer& buffer, size_t count)
+{
+	std::vector<T> data(count);
+	void* bufferData = renderer.getBufferAllocator()->mapBuffer(buffer);
+	memcpy(data.data(), bufferData, count * sizeof(T));
+	renderer.getBufferAllocator()->unmapBuffer(buffer);
+	return data;
+}
+
+bool GpuPrimitives::runSelfTest(uint32_t count)
+{
+	if (!isSupported() || count == 0)
+	{
+		std::cout << "[ERROR] GPU primitives are not available." << std::endl;
+		return false;
+	}
+
+	reserve(count);
+
+	const VkDevice device = renderer.getVkDevice();
+	const VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+	Buffer keyBuffer    = renderer.createBuffer(usage, count * sizeof(uint64_t));
+	Buffer valueBuffer  = renderer.createBuffer(usage, count * sizeof(uint32_t));
+	Buffer flagBuffer   = renderer.createBuffer(usage, count * sizeof(uint32_t));
+	Buffer outputBuffer = renderer.createBuffer(usage, count * sizeof(uint32_t));
+	Buffer resultBuffer = renderer.createBuffer(usage, 4 * sizeof(uint32_t));
+
+	VkCommandPool   cmdPool   = renderer.createCommandPool();
+	VkCommandBuffer cmdBuffer = renderer.createCommandBuffer(cmdPool);
+
+	// GPU time from timestamps if the queue supports them, otherwise the time of the submission.
+	const VkPhysicalDeviceLimits& limits = renderer.getVkPhysicalDeviceProperties().limits;
+	VkQueryPool queryPool = VK_NULL_HANDLE;
+	if (limits.timestampComputeAndGraphics)
+	{
+		VkQueryPoolCreateInfo queryPoolCreateInfo{};
+		queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCreateInfo.queryCount = 2;
+		vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &queryPool);
+	}
+
+	// Records, runs and times one primitive. The results are made visible to the host.
+	auto execute = [&](const std::function<void(VkCommandBuffer)>& record) -> double
+	{
+		VkCommandBufferBeginInfo cmdBufferBeginInfo{};
+		cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		cmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(cmdBuffer, &cmdBufferBeginInfo);
+
+		if (queryPool != VK_NULL_HANDLE)
+		{
+			vkCmdResetQueryPool(cmdBuffer, queryPool, 0, 2);
+			vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+		}
+
+		record(cmdBuffer);
+
+		if (queryPool != VK_NULL_HANDLE)
+			vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+
+		VkMemoryBarrier memoryBarrier{};
+		memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(cmdBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+			1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+		vkEndCommandBuffer(cmdBuffer);
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &cmdBuffer;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		vkQueueSubmit(renderer.getVkQueue(), 1, &submitInfo, VK_NULL_HANDLE);
+		vkQueueWaitIdle(renderer.getVkQueue());
+		auto end = std::chrono::high_resolution_clock::now();
+
+		if (queryPool == VK_NULL_HANDLE)
+			return std::chrono::duration<double, std::milli>(end - start).count();
+
+		uint64_t timestamps[2] = {};
+		vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+		return (timestamps[1] - timestamps[0]) * limits.timestampPeriod * 1e-6;
+	};
+
+	bool allPassed = true;
+	auto report = [&](const char* name, bool passed, double milliseconds)
+	{
+		allPassed = allPassed && passed;
+		std::cout << "  " << std::left << std::setw(24) << name << (passed ? "ok    " : "FAILED")
+			<< std::right << std::fixed << std::setprecision(3) << std::setw(10) << milliseconds << " ms"
+			<< std::setprecision(1) << std::setw(10) << count / (milliseconds * 1e3) << " M elements/s" << std::endl;
+	};
+
+	std::cout << "GPU primitives on " << count << " elements" << (usesSubgroups() ? ", subgroup operations" : "")
+		<< (queryPool != VK_NULL_HANDLE ? "" : ", CPU timer") << ":" << std::endl;
+
+	std::mt19937 random(1234);
+
+	// ============================
+	// Exclusive scan
+	// ============================
+	{
+		std::vector<uint32_t> values(count);
+		for (uint32_t& value : values)
+			value = random() % 16;
+		uploadBuffer(renderer, valueBuffer, values);
+
+		double time = execute([&](VkCommandBuffer cmd) { exclusiveScan(cmd, valueBuffer.getVkBuffer(), outputBuffer.getVkBuffer(), count); });
+		report("exclusive scan", downloadBuffer<uint32_t>(renderer, outputBuffer, count) == exclusiveScanReference(values), time);
+	}
+
+	// ============================
+	// Stream compaction
+	// ============================
+	{
+		std::vector<uint32_t> values(count);
+		std::vector<uint32_t> flags(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			values[i] = random();
+			flags[i]  = random() % 3 == 0 ? 1 : 0;
+		}
+		uploadBuffer(renderer, valueBuffer, values);
+		uploadBuffer(renderer, flagBuffer, flags);
+
+		double time = execute([&](VkCommandBuffer cmd)
+		{
+			compact(cmd, valueBuffer.getVkBuffer(), flagBuffer.getVkBuffer(), outputBuffer.getVkBuffer(), resultBuffer.getVkBuffer(), count);
+		});
+
+		std::vector<uint32_t> expected = compactReference(values, flags);
+		uint32_t compactedCount = downloadBuffer<uint32_t>(renderer, resultBuffer, 1)[0];
+		bool passed =
+			compactedCount == expected.size() &&
+			downloadBuffer<uint32_t>(renderer, outputBuffer, compactedCount) == expected;
+		report("compaction", passed, time);
+	}
+
+	// ============================
+	// Reductions
+	// ============================
+	{
+		const char* uintNames[]  = { "reduce sum (uint)",  "reduce min (uint)",  "reduce max (uint)" };
+		const char* floatNames[] = { "reduce sum (float)", "reduce min (float)", "reduce max (float)" };
+
+		std::vector<uint32_t> values(count);
+		for (uint32_t& value : values)
+			value = random() % 1024;   // the sum fits in 32 bits for up to 4M elements
+
+		std::vector<float> floatValues(count);
+		for (float& value : floatValues)
+			value = std::uniform_real_distribution<float>(-1.0f, 1.0f)(random);
+
+		for (uint32_t op = ReduceSum; op <= ReduceMax; op++)
+		{
+			uploadBuffer(renderer, valueBuffer, values);
+			double time = execute([&](VkCommandBuffer cmd) { reduce(cmd, valueBuffer.getVkBuffer(), resultBuffer.getVkBuffer(), count, ReduceOp(op), ElementUint); });
+			report(uintNames[op], downloadBuffer<uint32_t>(renderer, resultBuffer, 1)[0] == reduceReference(values, ReduceOp(op)), time);
+
+			uploadBuffer(renderer, valueBuffer, floatValues);
+			time = execute([&](VkCommandBuffer cmd) { reduce(cmd, valueBuffer.getVkBuffer(), resultBuffer.getVkBuffer(), count, ReduceOp(op), ElementFloat); });
+
+			// Min and max are exact, the sum depends on the order of the additions.
+			float result   = downloadBuffer<float>(renderer, resultBuffer, 1)[0];
+			float expected = reduceReference(floatValues, ReduceOp(op));
+			float tolerance = op == ReduceSum ? 1e-5f * count : 0.0f;
+			report(floatNames[op], std::abs(result - expected) <= tolerance, time);
+		}
+	}
+
+	// ============================
+	// Radix sort
+	// ============================
+	{
+		std::vector<uint32_t> keys(count);
+		std::vector<uint32_t> values(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			keys[i]   = random();
+			values[i] = i;
+		}
+		uploadBuffer(renderer, keyBuffer, keys);
+		uploadBuffer(renderer, valueBuffer, values);
+
+		double time = execute([&](VkCommandBuffer cmd) { sortKeyValues(cmd, keyBuffer.getVkBuffer(), valueBuffer.getVkBuffer(), count, 32); });
+
+		sortKeyValuesReference(keys, values);
+		bool passed =
+			downloadBuffer<uint32_t>(renderer, keyBuffer, count) == keys &&
+			downloadBuffer<uint32_t>(renderer, valueBuffer, count) == values;
+		report("radix sort (32-bit keys)", passed, time);
+	}
+
+	{
+		std::vector<uint64_t> keys(count);
+		std::vector<uint32_t> values(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			// Few distinct high words, so the stability of the sort is tested as well.
+			keys[i]   = (static_cast<uint64_t>(random() % 64) << 32) | (random() % 4096);
+			values[i] = i;
+		}
+		uploadBuffer(renderer, keyBuffer, keys);
+		uploadBuffer(renderer, valueBuffer, values);
+
+		double time = execute([&](VkCommandBuffer cmd) { sortKeyValues(cmd, keyBuffer.getVkBuffer(), valueBuffer.getVkBuffer(), count, 64); });
+
+		sortKeyValuesReference(keys, values);
+		bool passed =
+			downloadBuffer<uint64_t>(renderer, keyBuffer, count) == keys &&
+			downloadBuffer<uint32_t>(renderer, valueBuffer, count) == values;
+		report("radix sort (64-bit keys)", passed, time);
+	}
+
+	if (queryPool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(device, queryPool, nullptr);
+	vkDestroyCommandPool(device, cmdPool, nullptr);
+
+	// The sets refer to the buffers destroyed below.
+	releaseDescriptorSets();
+	renderer.destroyBuffer(keyBuffer);
+	renderer.destroyBuffer(valueBuffer);
+	renderer.destroyBuffer(flagBuffer);
+	renderer.destroyBuffer(outputBuffer);
+	renderer.destroyBuffer(resultBuffer);
+
+	return allPassed;
+}
@@ -2,11 +2,143 @@
 
 #include "VkRenderer.h"
 #include "Shader.h"
+#include "helper.h"
 
 #include <array>
+#include <string.h>
 
 #include <glm/glm.hpp>
 
+GraphicsPipelineDescription::GraphicsPipelineDescription()
+{
+	primitiveTopology       = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	primitiveRestartEnable  = VK_FALSE;
+
+	polygonMode             = VK_POLYGON_MODE_FILL;
+	cullMode                = VK_CULL_MODE_NONE;
+	frontFace               = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	depthBiasEnable         = VK_FALSE;
+	depthBiasConstantFactor = 0.0f;
+	depthBiasClamp          = 0.0f;
+	depthBiasSlopeFactor    = 0.0f;
+	lineWidth               = 1.0f;
+
+	rasterizationSamples    = VK_SAMPLE_COUNT_1_BIT;
+
+	depthTestEnable         = VK_TRUE;
+	depthWriteEnable        = VK_TRUE;
+	depthCompareOp          = VK_COMPARE_OP_LESS;
+	stencilTestEnable       = VK_FALSE;
+	stencilFront            = VkStencilOpState{};
+	stencilBack             = VkStencilOpState{};
+
+	colorBlendAttachment                     = VkPipelineColorBlendAttachmentState{};
+	colorBlendAttachment.blendEnable         = VK_FALSE;
+	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_COLOR;
+	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_DST_COLOR;
+	colorBlendAttachment.colorBlendOp        = VK_BLEND_OP_ADD;
+	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	colorBlendAttachment.alphaBlendOp        = VK_BLEND_OP_ADD;
+	colorBlendAttachment.colorWriteMask      = 0xf;
+
+	renderPass                   = VK_NULL_HANDLE;
+	subpass                      = 0;
+	depthStencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+}
+
+void GraphicsPipelineDescription::setRenderPass(const VkRenderer& renderer)
+{
+	renderPass                   = renderer.getVkRenderPass();
+	subpass                      = 0;
+	colorAttachmentFormats       = { renderer.getVkSurfaceFormat() };
+	depthStencilAttachmentFormat = renderer.getVkDepthStencilFormat();
+	rasterizationSamples         = VK_SAMPLE_COUNT_1_BIT;
+}
+
+uint64_t GraphicsPipelineDescription::hash() const
+{
+	// All hashed Vulkan structs only consist of 32-bit members, so they contain no padding bytes.
+	uint64_t h = HashSeed;
+	for (auto& layout : descriptorSetLayouts)            h = hashValue(layout, h);
+	for (auto& range : pushConstantRanges)               h = hashValue(range, h);
+	for (auto& stage : shaderStages)                     h = hashValue(stage.getCodeHash(), h);
+	for (auto& attrib : vertexInputAttribDescriptions)   h = hashValue(attrib, h);
+	for (auto& binding : vertexInputBindingDescriptions) h = hashValue(binding, h);
+
+	h = hashValue(primitiveTopology, h);
+	h = hashValue(primitiveRestartEnable, h);
+	h = hashValue(polygonMode, h);
+	h = hashValue(cullMode, h);
+	h = hashValue(frontFace, h);
+	h = hashValue(depthBiasEnable, h);
+	h = hashValue(depthBiasConstantFactor, h);
+	h = hashValue(depthBiasClamp, h);
+	h = hashValue(depthBiasSlopeFactor, h);
+	h = hashValue(lineWidth, h);
+	h = hashValue(rasterizationSamples, h);
+	h = hashValue(depthTestEnable, h);
+	h = hashValue(depthWriteEnable, h);
+	h = hashValue(depthCompareOp, h);
+	h = hashValue(stencilTestEnable, h);
+	h = hashValue(stencilFront, h);
+	h = hashValue(stencilBack, h);
+	h = hashValue(colorBlendAttachment, h);
+	h = hashValue(subpass, h);
+	for (auto& format : colorAttachmentFormats)          h = hashValue(format, h);
+	h = hashValue(depthStencilAttachmentFormat, h);
+
+	return h;
+}
+
+template<typename T>
+static bool equalMemory(const std::vector<T>& a, const std::vector<T>& b)
+{
+	return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+template<typename T>
+static bool equalMemory(const T& a, const T& b)
+{
+	return memcmp(&a, &b, sizeof(T)) == 0;
+}
+
+bool GraphicsPipelineDescription::operator==(const GraphicsPipelineDescription& other) const
+{
+	if (shaderStages.size() != other.shaderStages.size())
+		return false;
+	for (size_t i = 0; i < shaderStages.size(); i++)
+		if (shaderStages[i].getCodeHash() != other.shaderStages[i].getCodeHash())
+			return false;
+
+	return
+		equalMemory(descriptorSetLayouts, other.descriptorSetLayouts) &&
+		equalMemory(pushConstantRanges, other.pushConstantRanges) &&
+		equalMemory(vertexInputAttribDescriptions, other.vertexInputAttribDescriptions) &&
+		equalMemory(vertexInputBindingDescriptions, other.vertexInputBindingDescriptions) &&
+		primitiveTopology       == other.primitiveTopology &&
+		primitiveRestartEnable  == other.primitiveRestartEnable &&
+		polygonMode             == other.polygonMode &&
+		cullMode                == other.cullMode &&
+		frontFace               == other.frontFace &&
+		depthBiasEnable         == other.depthBiasEnable &&
+		depthBiasConstantFactor == other.depthBiasConstantFactor &&
+		depthBiasClamp          == other.depthBiasClamp &&
+		depthBiasSlopeFactor    == other.depthBiasSlopeFactor &&
+		lineWidth               == other.lineWidth &&
+		rasterizationSamples    == other.rasterizationSamples &&
+		depthTestEnable         == other.depthTestEnable &&
+		depthWriteEnable        == other.depthWriteEnable &&
+		depthCompareOp          == other.depthCompareOp &&
+		stencilTestEnable       == other.stencilTestEnable &&
+		equalMemory(stencilFront, other.stencilFront) &&
+		equalMemory(stencilBack, other.stencilBack) &&
+		equalMemory(colorBlendAttachment, other.colorBlendAttachment) &&
+		subpass                 == other.subpass &&
+		equalMemory(colorAttachmentFormats, other.colorAttachmentFormats) &&
+		depthStencilAttachmentFormat == other.depthStencilAttachmentFormat;
+}
+
 GraphicsPipeline::GraphicsPipeline(
 	const VkRenderer& renderer, 
 	const std::vector<VkDescriptorSetLayout>& descriptorLayouts,
@@ -14,31 +146,52 @@ GraphicsPipeline::GraphicsPipeline(
 	const std::vector<VkVertexInputAttributeDescription>& vertexInputAttribDescriptions,
 	const std::vector<VkVertexInputBindingDescription>& vertexInputingBindingDecriptions,
 	VkPrimitiveTopology primitiveTopology): renderer(renderer)
+{
+	GraphicsPipelineDescription description;
+	description.descriptorSetLayouts           = descriptorLayouts;
+	description.shaderStages                   = shaderStages;
+	description.vertexInputAttribDescriptions  = vertexInputAttribDescriptions;
+	description.vertexInputBindingDescriptions = vertexInputingBindingDecriptions;
+	description.primitiveTopology              = primitiveTopology;
+	description.setRenderPass(renderer);
+
+	create(description, VK_NULL_HANDLE);
+}
+
+GraphicsPipeline::GraphicsPipeline(
+	const VkRenderer& renderer,
+	const GraphicsPipelineDescription& description,
+	VkPipelineCache vkPipelineCache): renderer(renderer)
+{
+	create(description, vkPipelineCache);
+}
+
+void GraphicsPipeline::create(const GraphicsPipelineDescription& description, VkPipelineCache vkPipelineCache)
 {
 	// ============================
 	// Create Pipeline layout
 	// ============================
 	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
 	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(descriptorLayouts.size());
-	pipelineLayoutCreateInfo.pSetLayouts = descriptorLayouts.data();
-	pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-	pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+	pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(description.descriptorSetLayouts.size());
+	pipelineLayoutCreateInfo.pSetLayouts = description.descriptorSetLayouts.data();
+	pipelineLayoutCreateInfo.pushConstantRangeCount = static_cast<uint32_t>(description.pushConstantRanges.size());
+	pipelineLayoutCreateInfo.pPushConstantRanges = description.pushConstantRanges.data();
 
 	vkCreatePipelineLayout(renderer.getVkDevice(), &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
 
 	// vertex input 
 	VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo{};
 	vertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputAttribDescriptions.size());
-	vertexInputStateCreateInfo.pVertexAttributeDescriptions = vertexInputAttribDescriptions.data();
-	vertexInputStateCreateInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexInputingBindingDecriptions.size());
-	vertexInputStateCreateInfo.pVertexBindingDescriptions = vertexInputingBindingDecriptions.data();
+	vertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(description.vertexInputAttribDescriptions.size());
+	vertexInputStateCreateInfo.pVertexAttributeDescriptions = description.vertexInputAttribDescriptions.data();
+	vertexInputStateCreateInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(description.vertexInputBindingDescriptions.size());
+	vertexInputStateCreateInfo.pVertexBindingDescriptions = description.vertexInputBindingDescriptions.data();
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssemblyStateCreateInfo{};
 	inputAssemblyStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssemblyStateCreateInfo.topology = primitiveTopology;
-	inputAssemblyStateCreateInfo.primitiveRestartEnable = VK_FALSE;
+	inputAssemblyStateCreateInfo.topology = description.primitiveTopology;
+	inputAssemblyStateCreateInfo.primitiveRestartEnable = description.primitiveRestartEnable;
 
 	VkViewport viewport{};
 	viewport.x = 0;
@@ -65,17 +218,18 @@ GraphicsPipeline::GraphicsPipeline(
 	rasterizationState.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
 	rasterizationState.depthClampEnable = VK_FALSE;
 	rasterizationState.rasterizerDiscardEnable = VK_FALSE;
-	rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizationState.cullMode = VK_CULL_MODE_NONE;
-	rasterizationState.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-	rasterizationState.depthBiasConstantFactor = 0.0f;
-	rasterizationState.depthBiasClamp = 0.0f;
-	rasterizationState.depthBiasSlopeFactor = 0.0f;
-	rasterizationState.lineWidth = 1.0f;
+	rasterizationState.polygonMode = description.polygonMode;
+	rasterizationState.cullMode = description.cullMode;
+	rasterizationState.frontFace = description.frontFace;
+	rasterizationState.depthBiasEnable = description.depthBiasEnable;
+	rasterizationState.depthBiasConstantFactor = description.depthBiasConstantFactor;
+	rasterizationState.depthBiasClamp = description.depthBiasClamp;
+	rasterizationState.depthBiasSlopeFactor = description.depthBiasSlopeFactor;
+	rasterizationState.lineWidth = description.lineWidth;
 
 	VkPipelineMultisampleStateCreateInfo multisampleState{};
 	multisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampleState.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	multisampleState.rasterizationSamples = description.rasterizationSamples;
 	multisampleState.sampleShadingEnable = VK_FALSE;
 	multisampleState.minSampleShading = 0.0f;
 	multisampleState.pSampleMask = nullptr;
@@ -84,32 +238,24 @@ GraphicsPipeline::GraphicsPipeline(
 
 	VkPipelineDepthStencilStateCreateInfo depthStencilState{};
 	depthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	depthStencilState.depthTestEnable = VK_TRUE;
-	depthStencilState.depthWriteEnable = VK_TRUE;
-	depthStencilState.depthCompareOp = VK_COMPARE_OP_LESS;
+	depthStencilState.depthTestEnable = description.depthTestEnable;
+	depthStencilState.depthWriteEnable = description.depthWriteEnable;
+	depthStencilState.depthCompareOp = description.depthCompareOp;
 	depthStencilState.depthBoundsTestEnable = VK_FALSE;
-	depthStencilState.stencilTestEnable = VK_FALSE;
+	depthStencilState.stencilTestEnable = description.stencilTestEnable;
 	depthStencilState.minDepthBounds = -1.0f;
 	depthStencilState.maxDepthBounds = 1.0f;
-	//depthStencilState.front;
-	//depthStencilState.back;
-
-	VkPipelineColorBlendAttachmentState colorBlendAttachmentState{};
-	colorBlendAttachmentState.blendEnable = VK_FALSE;
-	colorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_COLOR;
-	colorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_DST_COLOR;
-	colorBlendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
-	colorBlendAttachmentState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-	colorBlendAttachmentState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-	colorBlendAttachmentState.alphaBlendOp = VK_BLEND_OP_ADD;
-	colorBlendAttachmentState.colorWriteMask = 0xf;
+	depthStencilState.front = description.stencilFront;
+	depthStencilState.back = description.stencilBack;
+
+	std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachmentStates(description.colorAttachmentFormats.size(), description.colorBlendAttachment);
 
 	VkPipelineColorBlendStateCreateInfo colorBlendState{};
 	colorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
 	colorBlendState.logicOpEnable = VK_FALSE;
 	colorBlendState.logicOp = VK_LOGIC_OP_CLEAR;
-	colorBlendState.attachmentCount = 1;
-	colorBlendState.pAttachments = &colorBlendAttachmentState;
+	colorBlendState.attachmentCount = static_cast<uint32_t>(colorBlendAttachmentStates.size());
+	colorBlendState.pAttachments = colorBlendAttachmentStates.data();
 	colorBlendState.blendConstants[0] = 0.0f;
 	colorBlendState.blendConstants[1] = 0.0f;
 	colorBlendState.blendConstants[2] = 0.0f;
@@ -125,7 +271,7 @@ GraphicsPipeline::GraphicsPipeline(
 	dynamicStateCreateInfo.pDynamicStates = dynamicState.data();
 
 	std::vector<VkPipelineShaderStageCreateInfo> shaderStagesCreateInfo;
-	for (auto& stage : shaderStages)
+	for (auto& stage : description.shaderStages)
 	{
 		VkPipelineShaderStageCreateInfo shaderStageCreateInfo{};
 		shaderStageCreateInfo.sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -157,12 +303,12 @@ GraphicsPipeline::GraphicsPipeline(
 	pipelineCreateInfo.pColorBlendState = &colorBlendState;
 	pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
 	pipelineCreateInfo.layout = pipelineLayout;
-	pipelineCreateInfo.renderPass = renderer.getVkRenderPass();
-	pipelineCreateInfo.subpass = 0;
+	pipelineCreateInfo.renderPass = description.renderPass;
+	pipelineCreateInfo.subpass = description.subpass;
 	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineCreateInfo.basePipelineIndex = 0;
 
-	vkCreateGraphicsPipelines(renderer.getVkDevice(), VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &pipeline);
+	vkCreateGraphicsPipelines(renderer.getVkDevice(), vkPipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline);
 }
 
 VkPipelineLayout GraphicsPipeline::getPipelineLayout()
@@ -4,28 +4,94 @@
 
 #include <vulkan/vulkan.h>
 
+#include "Shader.h"
+
 class VkRenderer;
-class ShaderStage;
+
+// Everything which ends up in a VkPipeline: layout, shaders, vertex layout, fixed-function state
+// and render pass compatibility. Two equal descriptions can share the same VkPipeline.
+struct GraphicsPipelineDescription
+{
+	GraphicsPipelineDescription();
+
+	// Pipeline layout
+	std::vector<VkDescriptorSetLayout>             descriptorSetLayouts;
+	std::vector<VkPushConstantRange>               pushConstantRanges;
+
+	// Shaders, compared by their SPIR-V hash and not by module handle.
+	std::vector<ShaderStage>                       shaderStages;
+
+	// Vertex input and assembly
+	std::vector<VkVertexInputAttributeDescription> vertexInputAttribDescriptions;
+	std::vector<VkVertexInputBindingDescription>   vertexInputBindingDescriptions;
+	VkPrimitiveTopology                            primitiveTopology;
+	VkBool32                                       primitiveRestartEnable;
+
+	// Rasterization
+	VkPolygonMode                                  polygonMode;
+	VkCullModeFlags                                cullMode;
+	VkFrontFace                                    frontFace;
+	VkBool32                                       depthBiasEnable;
+	float                                          depthBiasConstantFactor;
+	float                                          depthBiasClamp;
+	float                                          depthBiasSlopeFactor;
+	float                                          lineWidth;
+
+	// Multisampling
+	VkSampleCountFlagBits                          rasterizationSamples;
+
+	// Depth and stencil
+	VkBool32                                       depthTestEnable;
+	VkBool32                                       depthWriteEnable;
+	VkCompareOp                                    depthCompareOp;
+	VkBool32                                       stencilTestEnable;
+	VkStencilOpState                               stencilFront;
+	VkStencilOpState                               stencilBack;
+
+	// Blending, one state for every color attachment of the subpass.
+	VkPipelineColorBlendAttachmentState            colorBlendAttachment;
+
+	// Render pass the pipeline is created against. Only the attachment formats below are part of
+	// the key, so pipelines are shared between compatible render passes.
+	VkRenderPass                                   renderPass;
+	uint32_t                                       subpass;
+	std::vector<VkFormat>                          colorAttachmentFormats;
+	VkFormat                                       depthStencilAttachmentFormat;
+
+	// Fills render pass, attachment formats and sample count from the renderer's main render pass.
+	void setRenderPass(const VkRenderer& renderer);
+
+	uint64_t hash() const;
+	bool operator==(const GraphicsPipelineDescription& other) const;
+};
 
 class GraphicsPipeline
 {
 public:
 	GraphicsPipeline(
-		const VkRenderer& renderer, 
-		const std::vector<VkDescriptorSetLayout>& descriptorLayouts, 
+		const VkRenderer& renderer,
+		const std::vector<VkDescriptorSetLayout>& descriptorLayouts,
 		const std::vector<ShaderStage>& shaderStages,
 		const std::vector<VkVertexInputAttributeDescription>& vertexInputAttribDescriptions,
 		const std::vector<VkVertexInputBindingDescription>& vertexInputingBindingDecriptions,
 		VkPrimitiveTopology primitiveTopology
 	);
 
+	GraphicsPipeline(
+		const VkRenderer& renderer,
+		const GraphicsPipelineDescription& description,
+		VkPipelineCache vkPipelineCache = VK_NULL_HANDLE
+	);
+
 	VkPipelineLayout getPipelineLayout();
 	VkPipeline getPipeline();
 
 	~GraphicsPipeline();
 
 private:
+	void create(const GraphicsPipelineDescription& description, VkPipelineCache vkPipelineCache);
+
 	const VkRenderer& renderer;
 	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
 	VkPipeline pipeline = VK_NULL_HANDLE;
-};
\ No newline at end of file
+};
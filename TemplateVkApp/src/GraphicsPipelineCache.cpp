@@ -0,0 +1,65 @@
+#include "GraphicsPipelineCache.h"
+
+#include "VkRenderer.h"
+
+GraphicsPipelineCache::GraphicsPipelineCache(const VkRenderer& renderer): renderer(renderer)
+{
+	VkPipelineCacheCreateInfo pipelineCacheCreateInfo{};
+	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	pipelineCacheCreateInfo.initialDataSize = 0;
+	pipelineCacheCreateInfo.pInitialData = nullptr;
+
+	vkCreatePipelineCache(renderer.getVkDevice(), &pipelineCacheCreateInfo, nullptr, &m_vkPipelineCache);
+}
+
+GraphicsPipelineCache::~GraphicsPipelineCache()
+{
+	clear();
+
+	if (m_vkPipelineCache != VK_NULL_HANDLE)
+	{
+		vkDestroyPipelineCache(renderer.getVkDevice(), m_vkPipelineCache, nullptr);
+		m_vkPipelineCache = VK_NULL_HANDLE;
+	}
+}
+
+std::shared_ptr<GraphicsPipeline> GraphicsPipelineCache::getOrCreate(const GraphicsPipelineDescription& description)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_pipelines.find(description);
+		if (it != m_pipelines.end())
+		{
+			m_numHits++;
+			return it->second;
+		}
+		m_numMisses++;
+	}
+
+	// Compile without holding the lock. If another thread created the same pipeline meanwhile, keep theirs.
+	auto pipeline = std::make_shared<GraphicsPipeline>(renderer, description, m_vkPipelineCache);
+	if (pipeline->getPipeline() == VK_NULL_HANDLE)
+		return pipeline;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto inserted = m_pipelines.emplace(description, pipeline);
+	return inserted.first->second;
+}
+
+void GraphicsPipelineCache::clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_pipelines.clear();
+}
+
+uint32_t GraphicsPipelineCache::getNumHits() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_numHits;
+}
+
+uint32_t GraphicsPipelineCache::getNumMisses() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_numMisses;
+}
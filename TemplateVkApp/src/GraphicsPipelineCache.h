@@ -0,0 +1,46 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <vulkan/vulkan.h>
+
+#include "GraphicsPipeline.h"
+
+class VkRenderer;
+
+// Returns an already created pipeline for a description equal to one seen before, so objects which
+// share a material share one VkPipeline. Misses go through a VkPipelineCache to speed up compilation.
+// Thread safe, so it can be used from the asynchronous pipeline compiler.
+class GraphicsPipelineCache
+{
+public:
+	GraphicsPipelineCache(const VkRenderer& renderer);
+	~GraphicsPipelineCache();
+
+	std::shared_ptr<GraphicsPipeline> getOrCreate(const GraphicsPipelineDescription& description);
+
+	// Drops the cache's references. Pipelines still in use stay alive until released by their users.
+	void clear();
+
+	uint32_t getNumHits()   const;
+	uint32_t getNumMisses() const;
+
+private:
+	struct DescriptionHasher
+	{
+		size_t operator()(const GraphicsPipelineDescription& description) const
+		{
+			return static_cast<size_t>(description.hash());
+		}
+	};
+
+	const VkRenderer&  renderer;
+	VkPipelineCache    m_vkPipelineCache = VK_NULL_HANDLE;
+	mutable std::mutex m_mutex;
+	uint32_t           m_numHits = 0;
+	uint32_t           m_numMisses = 0;
+
+	std::unordered_map<GraphicsPipelineDescription, std::shared_ptr<GraphicsPipeline>, DescriptionHasher> m_pipelines;
+};
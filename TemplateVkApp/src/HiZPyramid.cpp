@@ -0,0 +1,331 @@
+#include "HiZPyramid.h"
+
+#include "VkRenderer.h"
+#include "helper.h"
+
+#include <array>
+#include <iostream>
+
+static const uint32_t ReduceWorkGroupSize = 8;
+
+HiZPyramid::HiZPyramid(VkRenderer& renderer, ShaderVariantCache& shaders): renderer(renderer)
+{
+	if (!renderer.isDepthSampleable())
+		return;
+
+	initImage();
+	initDescriptors();
+
+	ShaderStage computeShader;
+	if (shaders.getVariant("glsl/hizReduce.comp", VK_SHADER_STAGE_COMPUTE_BIT, "main", ShaderDefines(), computeShader))
+	{
+		m_pipeline =
+			std::unique_ptr<ComputePipeline>(
+				new ComputePipeline(renderer, { m_descriptorSetLayout }, computeShader, sizeof(ReduceParams))
+				);
+	}
+	else
+	{
+		std::cout << "[ERROR] Cannot compile the depth pyramid shader." << std::endl;
+	}
+}
+
+HiZPyramid::~HiZPyramid()
+{
+	VkDevice device = renderer.getVkDevice();
+
+	m_pipeline.reset(nullptr);
+
+	if (m_descriptorPool != VK_NULL_HANDLE)
+		vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+	if (m_descriptorSetLayout != VK_NULL_HANDLE)
+		vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+
+	if (m_sampler != VK_NULL_HANDLE)
+		vkDestroySampler(device, m_sampler, nullptr);
+	for (auto levelView : m_levelViews)
+		vkDestroyImageView(device, levelView, nullptr);
+	if (m_imageView != VK_NULL_HANDLE)
+		vkDestroyImageView(device, m_imageView, nullptr);
+	if (m_image != VK_NULL_HANDLE)
+		vkDestroyImage(device, m_image, nullptr);
+	if (m_imageMemory != VK_NULL_HANDLE)
+		vkFreeMemory(device, m_imageMemory, nullptr);
+}
+
+bool HiZPyramid::isSupported() const
+{
+	return m_pipeline != nullptr;
+}
+
+void HiZPyramid::initImage()
+{
+	VkDevice device = renderer.getVkDevice();
+
+	m_width  = glm::max((renderer.getVkSurfaceWidth()  + 1) / 2, 1u);
+	m_height = glm::max((renderer.getVkSurfaceHeight() + 1) / 2, 1u);
+
+	// Vulkan's mip chain: every level is half the one above rounded down, floor(log2(max)) + 1 levels.
+	m_numLevels = 1;
+	for (uint32_t size = glm::max(m_width, m_height); size > 1; size /= 2)
+		m_numLevels++;
+
+	// ===============================
+	// Create Image Handle
+	// ===============================
+	VkImageCreateInfo imageCreateInfo{};
+	imageCreateInfo.sType			= VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.imageType		= VK_IMAGE_TYPE_2D;
+	imageCreateInfo.format			= VK_FORMAT_R32_SFLOAT;
+	imageCreateInfo.extent.width	= m_width;
+	imageCreateInfo.extent.height	= m_height;
+	imageCreateInfo.extent.depth	= 1;
+	imageCreateInfo.mipLevels		= m_numLevels;
+	imageCreateInfo.arrayLayers		= 1;
+	imageCreateInfo.samples			= VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.tiling			= VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.usage			= VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageCreateInfo.sharingMode		= VK_SHARING_MODE_EXCLUSIVE;
+	imageCreateInfo.initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
+
+	ErrorCheck(vkCreateImage(device, &imageCreateInfo, nullptr, &m_image));
+
+	// ==================================
+	// Allocate Memory for the Image
+	// ==================================
+	VkMemoryRequirements imageMemRequirements{};
+	vkGetImageMemoryRequirements(device, m_image, &imageMemRequirements);
+
+	VkMemoryAllocateInfo memAllocInfo{};
+	memAllocInfo.sType				= VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memAllocInfo.allocationSize		= imageMemRequirements.size;
+	memAllocInfo.memoryTypeIndex	= FindVkMemoryTypeIndex(renderer.getVkPhysicalDeviceMemProperties(), imageMemRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	ErrorCheck(vkAllocateMemory(device, &memAllocInfo, nullptr, &m_imageMemory));
+	vkBindImageMemory(device, m_image, m_imageMemory, 0);
+
+	// ============================================
+	// Image views: all levels and one per level
+	// ============================================
+	VkImageViewCreateInfo imageViewCreateInfo{};
+	imageViewCreateInfo.sType								= VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	imageViewCreateInfo.image								= m_image;
+	imageViewCreateInfo.viewType							= VK_IMAGE_VIEW_TYPE_2D;
+	imageViewCreateInfo.format								= VK_FORMAT_R32_SFLOAT;
+	imageViewCreateInfo.subresourceRange.aspectMask			= VK_IMAGE_ASPECT_COLOR_BIT;
+	imageViewCreateInfo.subresourceRange.baseMipLevel		= 0;
+	imageViewCreateInfo.subresourceRange.levelCount			= m_numLevels;
+	imageViewCreateInfo.subresourceRange.baseArrayLayer		= 0;
+	imageViewCreateInfo.subresourceRange.layerCount			= 1;
+
+	ErrorCheck(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &m_imageView));
+
+	m_levelViews.resize(m_numLevels, VK_NULL_HANDLE);
+	for (uint32_t level = 0; level < m_numLevels; level++)
+	{
+		imageViewCreateInfo.subresourceRange.baseMipLevel	= level;
+		imageViewCreateInfo.subresourceRange.levelCount		= 1;
+		ErrorCheck(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &m_levelViews[level]));
+	}
+
+	// Nearest filtering, the shaders fetch single texels and take the maximum themselves.
+	VkSamplerCreateInfo samplerCreateInfo{};
+	samplerCreateInfo.sType			= VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCreateInfo.magFilter		= VK_FILTER_NEAREST;
+	samplerCreateInfo.minFilter		= VK_FILTER_NEAREST;
+	samplerCreateInfo.mipmapMode	= VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCreateInfo.addressModeU	= VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeV	= VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeW	= VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.minLod		= 0.0f;
+	samplerCreateInfo.maxLod		= static_cast<float>(m_numLevels - 1);
+
+	ErrorCheck(vkCreateSampler(device, &samplerCreateInfo, nullptr, &m_sampler));
+}
+
+void HiZPyramid::initDescriptors()
+{
+	VkDevice device = renderer.getVkDevice();
+
+	// 0 source level (sampled), 1 destination level (storage)
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
+	descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	descriptorSetLayoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	descriptorSetLayoutCreateInfo.pBindings = bindings.data();
+	vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &m_descriptorSetLayout);
+
+	std::array<VkDescriptorPoolSize, 2> descriptorSetPoolSizes{};
+	descriptorSetPoolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorSetPoolSizes[0].descriptorCount = m_numLevels;
+	descriptorSetPoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	descriptorSetPoolSizes[1].descriptorCount = m_numLevels;
+
+	VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+	descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descriptorPoolCreateInfo.maxSets = m_numLevels;
+	descriptorPoolCreateInfo.poolSizeCount = static_cast<uint32_t>(descriptorSetPoolSizes.size());
+	descriptorPoolCreateInfo.pPoolSizes = descriptorSetPoolSizes.data();
+	vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &m_descriptorPool);
+
+	std::vector<VkDescriptorSetLayout> setLayouts(m_numLevels, m_descriptorSetLayout);
+	m_descriptorSets.resize(m_numLevels, VK_NULL_HANDLE);
+
+	VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+	descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	descriptorSetAllocateInfo.descriptorSetCount = m_numLevels;
+	descriptorSetAllocateInfo.pSetLayouts = setLayouts.data();
+	descriptorSetAllocateInfo.descriptorPool = m_descriptorPool;
+	vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, m_descriptorSets.data());
+
+	for (uint32_t level = 0; level < m_numLevels; level++)
+	{
+		VkDescriptorImageInfo srcImageInfo{};
+		srcImageInfo.sampler     = m_sampler;
+		srcImageInfo.imageView   = level == 0 ? renderer.getVkDepthSampledImageView() : m_levelViews[level - 1];
+		srcImageInfo.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+		VkDescriptorImageInfo dstImageInfo{};
+		dstImageInfo.imageView   = m_levelViews[level];
+		dstImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[0].dstSet = m_descriptorSets[level];
+		descriptorWrites[0].dstBinding = 0;
+		descriptorWrites[0].descriptorCount = 1;
+		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrites[0].pImageInfo = &srcImageInfo;
+
+		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[1].dstSet = m_descriptorSets[level];
+		descriptorWrites[1].dstBinding = 1;
+		descriptorWrites[1].descriptorCount = 1;
+		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		descriptorWrites[1].pImageInfo = &dstImageInfo;
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void HiZPyramid::build(VkCommandBuffer cmdBuffer, const glm::mat4& viewProjMatrix)
+{
+	if (!isSupported())
+		return;
+
+	// ======================================
+	// Depth to shader read, pyramid to general
+	// ======================================
+	std::array<VkImageMemoryBarrier, 2> imageBarriers{};
+	imageBarriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageBarriers[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	imageBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	imageBarriers[0].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	imageBarriers[0].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	imageBarriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarriers[0].image = renderer.getVkDepthStencilImage();
+	imageBarriers[0].subresourceRange.aspectMask = renderer.getVkDepthStencilAspectMask();
+	imageBarriers[0].subresourceRange.levelCount = 1;
+	imageBarriers[0].subresourceRange.layerCount = 1;
+
+	// The previous pyramid may still be read by the culling pass; its contents are overwritten anyway.
+	imageBarriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageBarriers[1].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	imageBarriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	imageBarriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageBarriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	imageBarriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarriers[1].image = m_image;
+	imageBarriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageBarriers[1].subresourceRange.levelCount = m_numLevels;
+	imageBarriers[1].subresourceRange.layerCount = 1;
+
+	vkCmdPipelineBarrier(cmdBuffer,
+		VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		0, nullptr, 0, nullptr, static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+
+	// ======================================
+	// Reduce level by level
+	// ======================================
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->getPipeline());
+
+	ReduceParams params{};
+	params.srcWidth  = static_cast<int32_t>(renderer.getVkSurfaceWidth());
+	params.srcHeight = static_cast<int32_t>(renderer.getVkSurfaceHeight());
+	params.dstWidth  = static_cast<int32_t>(m_width);
+	params.dstHeight = static_cast<int32_t>(m_height);
+
+	for (uint32_t level = 0; level < m_numLevels; level++)
+	{
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->getPipelineLayout(), 0, 1, &m_descriptorSets[level], 0, nullptr);
+		vkCmdPushConstants(cmdBuffer, m_pipeline->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ReduceParams), &params);
+		vkCmdDispatch(cmdBuffer,
+			(params.dstWidth  + ReduceWorkGroupSize - 1) / ReduceWorkGroupSize,
+			(params.dstHeight + ReduceWorkGroupSize - 1) / ReduceWorkGroupSize, 1);
+
+		// The next level reads this one, culling reads all of them.
+		VkMemoryBarrier levelBarrier{};
+		levelBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(cmdBuffer,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			1, &levelBarrier, 0, nullptr, 0, nullptr);
+
+		params.srcWidth  = params.dstWidth;
+		params.srcHeight = params.dstHeight;
+		params.dstWidth  = glm::max(params.dstWidth  >> 1, 1);
+		params.dstHeight = glm::max(params.dstHeight >> 1, 1);
+	}
+
+	m_viewProjMatrix = viewProjMatrix;
+	m_built = true;
+}
+
+bool HiZPyramid::isBuilt() const
+{
+	return m_built;
+}
+
+const glm::mat4& HiZPyramid::getViewProjMatrix() const
+{
+	return m_viewProjMatrix;
+}
+
+uint32_t HiZPyramid::getWidth() const
+{
+	return m_width;
+}
+
+uint32_t HiZPyramid::getHeight() const
+{
+	return m_height;
+}
+
+uint32_t HiZPyramid::getNumLevels() const
+{
+	return m_numLevels;
+}
+
+VkImageView HiZPyramid::getImageView() const
+{
+	return m_imageView;
+}
+
+VkSampler HiZPyramid::getSampler() const
+{
+	return m_sampler;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include "ComputePipeline.h"
+#include "ShaderVariantCache.h"
+
+class VkRenderer;
+
+// Hierarchical-Z pyramid of the renderer's depth attachment, for occlusion culling.
+//
+// Every texel holds the farthest depth of the pixels it covers. Level 0 is half the depth resolution
+// rounded up, every further level is a regular mip level, half the one above rounded down. The last
+// texel of a row or column also covers the extra source texel of an odd size. A bounding volume whose
+// nearest depth is behind the pyramid texels covering its screen rectangle was hidden when the depth
+// was rendered.
+//
+// The pyramid is built from the depth of the frame that was just rendered, so it is tested with the
+// view-projection matrix of that frame: objects that come into view from behind an occluder appear
+// one frame late.
+class HiZPyramid
+{
+public:
+	HiZPyramid(VkRenderer& renderer, ShaderVariantCache& shaders);
+	~HiZPyramid();
+
+	// Needs a sampleable depth attachment, see VkRenderer::isDepthSampleable().
+	bool isSupported() const;
+
+	// Records the pyramid build. Has to be after the render pass which wrote the depth, viewProjMatrix
+	// is the matrix the depth was rendered with. The depth is left in DEPTH_STENCIL_READ_ONLY_OPTIMAL.
+	void build(VkCommandBuffer cmdBuffer, const glm::mat4& viewProjMatrix);
+
+	// False until build() was recorded once.
+	bool isBuilt() const;
+
+	const glm::mat4& getViewProjMatrix() const;
+	uint32_t    getWidth() const;
+	uint32_t    getHeight() const;
+	uint32_t    getNumLevels() const;
+
+	// All levels, in VK_IMAGE_LAYOUT_GENERAL. Sample with texelFetch or a nearest sampler.
+	VkImageView getImageView() const;
+	VkSampler   getSampler() const;
+
+private:
+	// Matches the push constants of hizReduce.comp.
+	struct ReduceParams
+	{
+		int32_t srcWidth;
+		int32_t srcHeight;
+		int32_t dstWidth;
+		int32_t dstHeight;
+	};
+
+	void initImage();
+	void initDescriptors();
+
+	VkRenderer&                      renderer;
+	std::unique_ptr<ComputePipeline> m_pipeline;
+
+	uint32_t       m_width     = 0;
+	uint32_t       m_height    = 0;
+	uint32_t       m_numLevels = 0;
+	bool           m_built     = false;
+	glm::mat4      m_viewProjMatrix = glm::mat4(1.0f);
+
+	VkImage                  m_image       = VK_NULL_HANDLE;
+	VkDeviceMemory           m_imageMemory = VK_NULL_HANDLE;
+	VkImageView              m_imageView   = VK_NULL_HANDLE;
+	std::vector<VkImageView> m_levelViews;
+	VkSampler                m_sampler     = VK_NULL_HANDLE;
+
+	// One set per level: binding 0 the level above (the depth for level 0), binding 1 the level.
+	VkDescriptorSetLayout        m_descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool             m_descriptorPool      = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> m_descriptorSets;
+};
@@ -0,0 +1,7 @@
+#include "IndexCodec.h"
+
+void IndexCodec::toUInt16(const uint32_t* indices, size_t count, uint32_t baseVertex, uint16_t* out)
+{
+	for (size_t i = 0; i < count; i++)
+		out[i] = static_cast<uint16_t>(indices[i] - baseVertex);
+}
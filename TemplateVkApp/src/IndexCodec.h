@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 16-bit indices: toUInt16() rebases an index range to its first vertex, so every range which
+// references at most MaxUInt16Vertices vertices can be drawn from a VK_INDEX_TYPE_UINT16 buffer with
+// the first vertex as vertexOffset. MeshLoader::splitSubMeshes() makes every sub mesh fit.
+class IndexCodec
+{
+public:
+	static const uint32_t MaxUInt16Vertices = 65536;
+
+	// out[i] = indices[i] - baseVertex. The indices have to be in [baseVertex, baseVertex + 65535].
+	static void toUInt16(const uint32_t* indices, size_t count, uint32_t baseVertex, uint16_t* out);
+};
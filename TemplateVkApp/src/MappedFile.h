@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A read only view of a whole file in memory. The pages are loaded by the OS on first access and
+// shared with the file cache, so reading from data() costs no copy into a user buffer.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Maps the file, closes a file mapped before. False if it cannot be opened or is empty.
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const;
+	const uint8_t* data() const;
+	size_t size() const;
+
+private:
+	const uint8_t* m_data = nullptr;
+	size_t         m_size = 0;
+
+#if defined(_WIN32)
+	void* m_file    = nullptr;
+	void* m_mapping = nullptr;
+#endif
+};
@@ -0,0 +1,62 @@
+#include "MeshBounds.h"
+
+#include "helper.h"
+
+#include <algorithm>
+
+// Below this many vertices per thread, starting the thread costs more than the sweep.
+static const size_t MinVerticesPerThread = 64 * 1024;
+
+MeshBounds MeshBounds::compute(const std::vector<MeshLoader::Vertex>& vertices)
+{
+	struct Partial
+	{
+		float  min[3] = { +std::numeric_limits<float>::max(), +std::numeric_limits<float>::max(), +std::numeric_limits<float>::max() };
+		float  max[3] = { -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+		double sum[3] = { 0.0, 0.0, 0.0 };   // in double, float sums drift on big meshes
+	};
+
+	const uint32_t nRanges = getParallelRangeCount(vertices.size(), MinVerticesPerThread);
+	std::vector<Partial> partials(nRanges);
+
+	parallelForRanges(vertices.size(), nRanges, [&vertices, &partials](uint32_t range, size_t begin, size_t end)
+	{
+		Partial partial;
+		for (size_t v = begin; v < end; v++)
+		{
+			const float* position = &vertices[v].position.x;
+			for (int c = 0; c < 3; c++)
+			{
+				partial.min[c] = (std::min)(partial.min[c], position[c]);
+				partial.max[c] = (std::max)(partial.max[c], position[c]);
+				partial.sum[c] += position[c];
+			}
+		}
+		partials[range] = partial;
+	});
+
+	MeshBounds bounds;
+	glm::dvec3 sum(0.0);
+	for (const Partial& partial : partials)
+	{
+		bounds.aabb.extend(AABB(partial.min, partial.max));
+		sum += glm::dvec3(partial.sum[0], partial.sum[1], partial.sum[2]);
+	}
+
+	bounds.vertexCount = static_cast<uint32_t>(vertices.size());
+	if (!vertices.empty())
+		bounds.centroid = glm::vec3(sum / static_cast<double>(vertices.size()));
+
+	return bounds;
+}
+
+void MeshBounds::normalize(std::vector<MeshLoader::Vertex>& vertices, const glm::vec3& center, float scale)
+{
+	const uint32_t nRanges = getParallelRangeCount(vertices.size(), MinVerticesPerThread);
+
+	parallelForRanges(vertices.size(), nRanges, [&vertices, center, scale](uint32_t range, size_t begin, size_t end)
+	{
+		for (size_t v = begin; v < end; v++)
+			vertices[v].position = (vertices[v].position - center) * scale;
+	});
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "AABB.h"
+#include "MeshLoader.h"
+
+// Bounds and centroid of a mesh, and the normalization that moves it to the origin and scales it.
+//
+// Both run in parallel over contiguous vertex ranges, one range per hardware thread. compute() is a
+// single sweep which produces the box and the centroid together, normalize() a single sweep which
+// recenters and rescales at once. The loops only touch plain floats, so the compiler can vectorize
+// them. MeshProcessor has the same reduction and normalization on the GPU, for meshes which already
+// live in a storage buffer.
+class MeshBounds
+{
+public:
+	MeshBounds() = default;
+
+	static MeshBounds compute(const std::vector<MeshLoader::Vertex>& vertices);
+
+	// position = (position - center) * scale
+	static void normalize(std::vector<MeshLoader::Vertex>& vertices, const glm::vec3& center, float scale);
+
+	AABB      aabb;
+	glm::vec3 centroid    = glm::vec3(0.0f);
+	uint32_t  vertexCount = 0;
+};
@@ -0,0 +1,300 @@
+#include "MeshCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "IndexCodec.h"
+#include "helper.h"
+
+static const uint32_t MeshCacheFileMagic   = 0x48534d56;   // "VMSH"
+static const uint32_t MeshCacheFileVersion = 1;
+
+// Source files are hashed in ranges of at least this many bytes per thread.
+static const size_t   MinHashBytesPerThread = 4 << 20;
+
+// All offsets are in bytes from the start of the file and multiples of PageSize, 0 for a missing
+// section.
+struct MeshCache::FileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t sourceHash;
+	uint64_t optionsHash;
+	uint64_t fileSize;
+
+	uint32_t vertexStride;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t subMeshCount;
+	uint32_t lodCount;
+	uint32_t pad;
+
+	float    boundsMin[3];
+	float    boundsMax[3];
+	float    centroid[3];
+	uint32_t pad2;
+
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t drawIndexOffset;
+	uint64_t subMeshOffset;
+	uint64_t lodOffset;
+};
+
+static uint64_t getOptionsHash(const MeshCache::Options& options)
+{
+	uint64_t h = hashValue(options.importFlags);
+	h = hashValue(options.maxSubMeshVertices, h);
+	h = hashValue(options.meshOptimization, h);
+	h = hashValue(options.normalizedSize, h);
+	return h;
+}
+
+static uint64_t alignToPage(uint64_t offset)
+{
+	return (offset + MeshCache::PageSize - 1) / MeshCache::PageSize * MeshCache::PageSize;
+}
+
+std::string MeshCache::getCachePath(const std::string& sourceFile)
+{
+	return sourceFile + ".vkmesh";
+}
+
+uint64_t MeshCache::getSourceHash(const std::string& sourceFile)
+{
+	MappedFile file;
+	if (!file.open(sourceFile))
+		return 0;
+
+	// One FNV-1a hash per range, the file hash chains them with the size.
+	uint32_t nRanges = getParallelRangeCount(file.size(), MinHashBytesPerThread);
+	std::vector<uint64_t> rangeHashes(nRanges);
+	parallelForRanges(file.size(), nRanges, [&file, &rangeHashes](uint32_t range, size_t begin, size_t end)
+	{
+		rangeHashes[range] = hashBytes(file.data() + begin, end - begin);
+	});
+
+	uint64_t h = hashValue(static_cast<uint64_t>(file.size()));
+	return hashBytes(rangeHashes.data(), rangeHashes.size() * sizeof(uint64_t), h);
+}
+
+// ======================================
+// Reading
+// ======================================
+bool MeshCache::open(const std::string& path, uint64_t sourceHash, const Options& options)
+{
+	close();
+	if (!m_file.open(path))
+		return false;
+
+	const FileHeader* header = getHeader();
+	if (m_file.size() < sizeof(FileHeader) ||
+		header->magic != MeshCacheFileMagic ||
+		header->version != MeshCacheFileVersion ||
+		header->sourceHash != sourceHash ||
+		header->optionsHash != getOptionsHash(options))
+	{
+		close();
+		return false;
+	}
+
+	// Every section has to lie inside the file.
+	uint64_t size = m_file.size();
+	auto fits = [size](uint64_t offset, uint64_t count, uint64_t elementSize)
+	{
+		return offset % PageSize == 0 && offset <= size && count * elementSize <= size - offset;
+	};
+
+	bool valid = header->fileSize == size &&
+		header->vertexStride == sizeof(MeshLoader::Vertex) &&
+		fits(header->vertexOffset, header->vertexCount, sizeof(MeshLoader::Vertex)) &&
+		fits(header->indexOffset, header->indexCount, sizeof(uint32_t)) &&
+		fits(header->drawIndexOffset, header->drawIndexOffset != 0 ? header->indexCount : 0, sizeof(uint16_t)) &&
+		fits(header->subMeshOffset, header->subMeshCount, sizeof(MeshLoader::SubMesh)) &&
+		fits(header->lodOffset, header->lodCount, sizeof(Lod));
+
+	for (uint32_t i = 0; valid && i < header->subMeshCount; i++)
+	{
+		const MeshLoader::SubMesh& subMesh = getSubMeshes()[i];
+		valid = uint64_t(subMesh.firstIndex) + subMesh.indexCount <= header->indexCount &&
+			uint64_t(subMesh.firstVertex) + subMesh.vertexCount <= header->vertexCount;
+	}
+
+	for (uint32_t i = 0; valid && i < header->lodCount; i++)
+	{
+		const Lod& lod = getLods()[i];
+		valid = lod.subMesh < header->subMeshCount && uint64_t(lod.firstIndex) + lod.indexCount <= header->indexCount;
+	}
+
+	if (!valid)
+	{
+		std::cout << "[ERROR] Broken mesh cache " << path << std::endl;
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void MeshCache::close()
+{
+	m_file.close();
+}
+
+bool MeshCache::isOpen() const
+{
+	return m_file.isOpen();
+}
+
+const MeshCache::FileHeader* MeshCache::getHeader() const
+{
+	return reinterpret_cast<const FileHeader*>(m_file.data());
+}
+
+const MeshLoader::Vertex* MeshCache::getVertices() const
+{
+	return reinterpret_cast<const MeshLoader::Vertex*>(m_file.data() + getHeader()->vertexOffset);
+}
+
+uint32_t MeshCache::getVertexCount() const
+{
+	return getHeader()->vertexCount;
+}
+
+const uint32_t* MeshCache::getIndices() const
+{
+	return reinterpret_cast<const uint32_t*>(m_file.data() + getHeader()->indexOffset);
+}
+
+uint32_t MeshCache::getIndexCount() const
+{
+	return getHeader()->indexCount;
+}
+
+const uint16_t* MeshCache::getDrawIndices() const
+{
+	if (getHeader()->drawIndexOffset == 0)
+		return nullptr;
+
+	return reinterpret_cast<const uint16_t*>(m_file.data() + getHeader()->drawIndexOffset);
+}
+
+const MeshLoader::SubMesh* MeshCache::getSubMeshes() const
+{
+	return reinterpret_cast<const MeshLoader::SubMesh*>(m_file.data() + getHeader()->subMeshOffset);
+}
+
+uint32_t MeshCache::getSubMeshCount() const
+{
+	return getHeader()->subMeshCount;
+}
+
+const MeshCache::Lod* MeshCache::getLods() const
+{
+	return reinterpret_cast<const Lod*>(m_file.data() + getHeader()->lodOffset);
+}
+
+uint32_t MeshCache::getLodCount() const
+{
+	return getHeader()->lodCount;
+}
+
+MeshBounds MeshCache::getBounds() const
+{
+	const FileHeader* header = getHeader();
+
+	MeshBounds bounds;
+	bounds.aabb        = AABB(header->boundsMin, header->boundsMax);
+	bounds.centroid    = glm::vec3(header->centroid[0], header->centroid[1], header->centroid[2]);
+	bounds.vertexCount = header->vertexCount;
+	return bounds;
+}
+
+void MeshCache::copyTo(MeshLoader& mesh) const
+{
+	mesh.vertices.assign(getVertices(), getVertices() + getVertexCount());
+	mesh.indices.assign(getIndices(), getIndices() + getIndexCount());
+	mesh.subMeshes.assign(getSubMeshes(), getSubMeshes() + getSubMeshCount());
+}
+
+// ======================================
+// Writing
+// ======================================
+static void writeSection(std::ofstream& file, uint64_t& offset, const void* data, size_t size)
+{
+	static const char zeros[MeshCache::PageSize] = {};
+
+	uint64_t sectionOffset = alignToPage(offset);
+	file.write(zeros, static_cast<std::streamsize>(sectionOffset - offset));
+	file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+	offset = sectionOffset + size;
+}
+
+bool MeshCache::save(const std::string& path, uint64_t sourceHash, const Options& options, const MeshLoader& mesh, const std::vector<Lod>& lods)
+{
+	// 16-bit draw indices if every range fits them, like Application draws.
+	bool drawIndices16 = true;
+	for (auto& subMesh : mesh.subMeshes)
+		drawIndices16 = drawIndices16 && subMesh.vertexCount <= IndexCodec::MaxUInt16Vertices;
+
+	std::vector<uint16_t> drawIndices;
+	if (drawIndices16)
+	{
+		drawIndices.resize(mesh.indices.size());
+		for (auto& subMesh : mesh.subMeshes)
+			IndexCodec::toUInt16(mesh.indices.data() + subMesh.firstIndex, subMesh.indexCount, subMesh.firstVertex, drawIndices.data() + subMesh.firstIndex);
+		for (auto& lod : lods)
+			IndexCodec::toUInt16(mesh.indices.data() + lod.firstIndex, lod.indexCount, mesh.subMeshes[lod.subMesh].firstVertex, drawIndices.data() + lod.firstIndex);
+	}
+
+	MeshBounds bounds = MeshBounds::compute(mesh.vertices);
+
+	FileHeader header = {};
+	header.magic        = MeshCacheFileMagic;
+	header.version      = MeshCacheFileVersion;
+	header.sourceHash   = sourceHash;
+	header.optionsHash  = getOptionsHash(options);
+	header.vertexStride = sizeof(MeshLoader::Vertex);
+	header.vertexCount  = static_cast<uint32_t>(mesh.vertices.size());
+	header.indexCount   = static_cast<uint32_t>(mesh.indices.size());
+	header.subMeshCount = static_cast<uint32_t>(mesh.subMeshes.size());
+	header.lodCount     = static_cast<uint32_t>(lods.size());
+	for (int c = 0; c < 3; c++)
+	{
+		header.boundsMin[c] = bounds.aabb.min[c];
+		header.boundsMax[c] = bounds.aabb.max[c];
+		header.centroid[c]  = bounds.centroid[c];
+	}
+
+	// The offsets are known up front, the header is written first.
+	uint64_t offset = alignToPage(sizeof(FileHeader));
+	header.vertexOffset    = offset;
+	offset                 = alignToPage(offset + mesh.vertices.size() * sizeof(MeshLoader::Vertex));
+	header.indexOffset     = offset;
+	offset                 = alignToPage(offset + mesh.indices.size() * sizeof(uint32_t));
+	header.drawIndexOffset = drawIndices16 ? offset : 0;
+	offset                 = alignToPage(offset + drawIndices.size() * sizeof(uint16_t));
+	header.subMeshOffset   = offset;
+	offset                 = alignToPage(offset + mesh.subMeshes.size() * sizeof(MeshLoader::SubMesh));
+	header.lodOffset       = offset;
+	header.fileSize        = offset + lods.size() * sizeof(Lod);
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "[ERROR] Cannot write the mesh cache " << path << std::endl;
+		return false;
+	}
+
+	uint64_t written = 0;
+	writeSection(file, written, &header, sizeof(header));
+	writeSection(file, written, mesh.vertices.data(), mesh.vertices.size() * sizeof(MeshLoader::Vertex));
+	writeSection(file, written, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+	if (drawIndices16)
+		writeSection(file, written, drawIndices.data(), drawIndices.size() * sizeof(uint16_t));
+	writeSection(file, written, mesh.subMeshes.data(), mesh.subMeshes.size() * sizeof(MeshLoader::SubMesh));
+	writeSection(file, written, lods.data(), lods.size() * sizeof(Lod));
+
+	return static_cast<bool>(file) && written == header.fileSize;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "MeshBounds.h"
+#include "MeshLoader.h"
+
+// The processed mesh in a binary file next to its source, "<source>.vkmesh", so later launches skip
+// the import, the splitting, the optimization and the normalization.
+//
+// The file is a header followed by page aligned sections which hold the streams in the layout of the
+// GPU buffers: the vertices (position, normal), the 32-bit indices, the 16-bit draw indices when
+// every sub mesh fits them (see IndexCodec), the sub mesh ranges and optional LODs. open() maps the
+// file, the sections can be copied into mapped buffers as they are. The file is keyed by a hash of
+// the source file and of the options it was processed with, a stale or broken file is not opened.
+class MeshCache
+{
+public:
+	static const uint32_t PageSize = 4096;
+
+	// Everything which changes the processed mesh besides the source file.
+	struct Options
+	{
+		uint32_t importFlags;          // MeshLoader::getImportFlags()
+		uint32_t maxSubMeshVertices;   // of MeshLoader::splitSubMeshes()
+		uint32_t meshOptimization;     // 1 if MeshOptimizer::optimize() ran
+		float    normalizedSize;       // of MeshBounds::normalize()
+	};
+
+	// A simplified version of a sub mesh, an index range of its own in the same index stream.
+	struct Lod
+	{
+		uint32_t subMesh;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		float    error;
+	};
+
+	MeshCache() = default;
+	~MeshCache() = default;
+
+	MeshCache(const MeshCache&) = delete;
+	MeshCache& operator=(const MeshCache&) = delete;
+
+	static std::string getCachePath(const std::string& sourceFile);
+
+	// Hash of the bytes of the source file, hashed in parallel ranges from a mapping. 0 if the file
+	// cannot be read.
+	static uint64_t getSourceHash(const std::string& sourceFile);
+
+	// Maps the file. False if it is missing, broken or was built from a different source or with
+	// different options.
+	bool open(const std::string& path, uint64_t sourceHash, const Options& options);
+	void close();
+	bool isOpen() const;
+
+	const MeshLoader::Vertex*  getVertices() const;
+	uint32_t                   getVertexCount() const;
+	const uint32_t*            getIndices() const;
+	uint32_t                   getIndexCount() const;
+	// nullptr if a sub mesh has more vertices than 16-bit indices address.
+	const uint16_t*            getDrawIndices() const;
+	const MeshLoader::SubMesh* getSubMeshes() const;
+	uint32_t                   getSubMeshCount() const;
+	const Lod*                 getLods() const;
+	uint32_t                   getLodCount() const;
+	// Of the vertices as they are stored, after the normalization.
+	MeshBounds                 getBounds() const;
+
+	// Copies the streams into the vectors of mesh.
+	void copyTo(MeshLoader& mesh) const;
+
+	// The LOD ranges index into mesh.indices, usually behind the ranges of the sub meshes.
+	static bool save(const std::string& path, uint64_t sourceHash, const Options& options, const MeshLoader& mesh, const std::vector<Lod>& lods);
+
+private:
+	struct FileHeader;
+
+	const FileHeader* getHeader() const;
+
+	MappedFile m_file;
+};
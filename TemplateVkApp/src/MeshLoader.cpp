@@ -1,70 +1,424 @@
 #include "MeshLoader.h"
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
-MeshLoader::MeshLoader(const std::string& meshFile)
+#include "GlbLoader.h"
+#include "helper.h"
+#include "VertexWelder.h"
+
+// Work is split into blocks of at most this many vertices or faces, which never cross a mesh.
+static const uint32_t BlockSize = 16 * 1024;
+
+// The smallest range of the passes over vertices and indices, see getParallelRangeCount(). Each
+// element takes a copy or a remap, about the cost of a MeshBounds sweep.
+static const size_t MinVerticesPerThread = 64 * 1024;
+
+uint32_t MeshLoader::getImportFlags(ImportProfile profile)
 {
-	Assimp::Importer importer;
-	const aiScene* scene = importer.ReadFile(meshFile.c_str(),
-		aiProcess_CalcTangentSpace |
+	uint32_t flags =
 		aiProcess_Triangulate |
-		aiProcess_JoinIdenticalVertices |
-		aiProcess_SortByPType);
+		aiProcess_SortByPType;
+
+	// Without tangents the vertices are welded after the copy, see weldVertices().
+	if (profile == ImportProfile::WithTangents)
+		flags |= aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices;
+	else
+		flags |= aiProcess_RemoveComponent;
+
+	return flags;
+}
+
+namespace
+{
+	struct Block
+	{
+		uint32_t mesh;
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	std::vector<Block> getBlocks(const aiScene* scene, bool faces)
+	{
+		std::vector<Block> blocks;
+		for (uint32_t m = 0; m < scene->mNumMeshes; m++)
+		{
+			uint32_t count = faces ? scene->mMeshes[m]->mNumFaces : scene->mMeshes[m]->mNumVertices;
+			for (uint32_t begin = 0; begin < count; begin += BlockSize)
+				blocks.push_back({ m, begin, (std::min)(begin + BlockSize, count) });
+		}
+		return blocks;
+	}
+
+	// Calls func(block) for every block, blocks are spread over the threads.
+	template<typename Func>
+	void parallelForBlocks(const std::vector<Block>& blocks, Func func)
+	{
+		uint32_t nRanges = getParallelRangeCount(blocks.size(), 1);
+		parallelForRanges(blocks.size(), nRanges, [&blocks, &func](uint32_t, size_t begin, size_t end)
+		{
+			for (size_t b = begin; b < end; b++)
+				func(blocks[b]);
+		});
+	}
+
+	uint32_t getTriangleCount(const aiFace& face)
+	{
+		return face.mNumIndices >= 3 ? face.mNumIndices - 2 : 0;
+	}
+}
+
+MeshLoader::MeshLoader(const std::string& meshFile, ImportProfile profile)
+{
+	if (GlbLoader::isGlbFile(meshFile))
+	{
+		loadGlb(meshFile);
+		return;
+	}
+
+	Assimp::Importer importer;
+
+	// Only positions and normals are read.
+	importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS,
+		aiComponent_TANGENTS_AND_BITANGENTS |
+		aiComponent_COLORS |
+		aiComponent_TEXCOORDS |
+		aiComponent_BONEWEIGHTS |
+		aiComponent_ANIMATIONS |
+		aiComponent_TEXTURES |
+		aiComponent_LIGHTS |
+		aiComponent_CAMERAS);
+
+	const aiScene* scene = importer.ReadFile(meshFile.c_str(), getImportFlags(profile));
 	if (!scene) {
 		std::cout << "[ERROR] Cannot load " << meshFile << std::endl;
 		return;
 	}
 
-	for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
-		uint32_t verticesOffset = static_cast<uint32_t>(vertices.size());
+	// ======================================
+	// Sizes: vertex ranges and triangles per face block
+	// ======================================
+	std::vector<Block> vertexBlocks = getBlocks(scene, false);
+	std::vector<Block> faceBlocks   = getBlocks(scene, true);
+
+	std::vector<uint32_t> blockIndexOffsets(faceBlocks.size() + 1, 0);
+	parallelForBlocks(faceBlocks, [scene, &faceBlocks, &blockIndexOffsets](const Block& block)
+	{
+		uint32_t nTriangles = 0;
+		for (uint32_t f = block.begin; f < block.end; f++)
+			nTriangles += getTriangleCount(scene->mMeshes[block.mesh]->mFaces[f]);
+		blockIndexOffsets[&block - faceBlocks.data() + 1] = nTriangles * 3;
+	});
+	for (size_t b = 0; b < faceBlocks.size(); b++)
+		blockIndexOffsets[b + 1] += blockIndexOffsets[b];
+
+	subMeshes.resize(scene->mNumMeshes);
+	uint32_t nVertices = 0;
+	for (uint32_t m = 0, b = 0; m < scene->mNumMeshes; m++)
+	{
+		while (b < faceBlocks.size() && faceBlocks[b].mesh < m)
+			b++;
+
+		SubMesh& subMesh = subMeshes[m];
+		subMesh.firstIndex  = blockIndexOffsets[b];
+		subMesh.firstVertex = nVertices;
+		subMesh.vertexCount = scene->mMeshes[m]->mNumVertices;
+		nVertices += subMesh.vertexCount;
+	}
+	for (uint32_t m = 0; m < scene->mNumMeshes; m++)
+		subMeshes[m].indexCount = (m + 1 < scene->mNumMeshes ? subMeshes[m + 1].firstIndex : blockIndexOffsets.back()) - subMeshes[m].firstIndex;
 
-		std::vector<glm::vec3> newMeshVertices;
-		std::vector<glm::vec3> newMeshIndices;
+	vertices.resize(nVertices);
+	indices.resize(blockIndexOffsets.back());
 
-		aiMesh* mesh = scene->mMeshes[i];
-		int iMeshFaces = mesh->mNumFaces;
-		for (unsigned int v = 0; v < mesh->mNumVertices; v++) {
-			Vertex vertex;
-			//std::cout << "Vertex #" << v << " " << mesh->mVertices[v][0] << " " << mesh->mVertices[v][1] << " " << mesh->mVertices[v][2] << std::endl;
-			vertex.position = glm::vec3(mesh->mVertices[v][0], mesh->mVertices[v][1], mesh->mVertices[v][2]);
-			if (mesh->mNormals)
-				vertex.normal = glm::vec3(mesh->mNormals[v][0], mesh->mNormals[v][1], mesh->mNormals[v][2]);
-			else
-				vertex.normal = glm::vec3(0.0f);
-			vertices.push_back(vertex);
+	// ======================================
+	// Vertices and fan triangulated faces, every block writes its own range
+	// ======================================
+	parallelForBlocks(vertexBlocks, [this, scene](const Block& block)
+	{
+		const aiMesh* mesh = scene->mMeshes[block.mesh];
+		Vertex* out = &vertices[subMeshes[block.mesh].firstVertex];
+		for (uint32_t v = block.begin; v < block.end; v++)
+		{
+			out[v].position = glm::vec3(mesh->mVertices[v][0], mesh->mVertices[v][1], mesh->mVertices[v][2]);
+			out[v].normal   = mesh->mNormals ? glm::normalize(glm::vec3(mesh->mNormals[v][0], mesh->mNormals[v][1], mesh->mNormals[v][2])) : glm::vec3(0.0f);
 		}
-		for (unsigned int f = 0; f < mesh->mNumFaces; f++) {
-			aiFace& face = mesh->mFaces[f];
-			for (unsigned int fi = 1; fi < face.mNumIndices - 1; fi++) {
+	});
 
-				uint32_t vIds[3] = {
-					verticesOffset + face.mIndices[0],
-					verticesOffset + face.mIndices[fi + 0],
-					verticesOffset + face.mIndices[fi + 1]
-				};
+	parallelForBlocks(faceBlocks, [this, scene, &faceBlocks, &blockIndexOffsets](const Block& block)
+	{
+		const aiMesh* mesh = scene->mMeshes[block.mesh];
+		uint32_t verticesOffset = subMeshes[block.mesh].firstVertex;
+		uint32_t* out = &indices[0] + blockIndexOffsets[&block - faceBlocks.data()];
+		for (uint32_t f = block.begin; f < block.end; f++)
+		{
+			const aiFace& face = mesh->mFaces[f];
+			for (uint32_t fi = 1; fi + 1 < face.mNumIndices; fi++)
+			{
+				*out++ = verticesOffset + face.mIndices[0];
+				*out++ = verticesOffset + face.mIndices[fi + 0];
+				*out++ = verticesOffset + face.mIndices[fi + 1];
+			}
+		}
+	});
 
-				indices.push_back(vIds[0]);
-				indices.push_back(vIds[1]);
-				indices.push_back(vIds[2]);
+	if (!(getImportFlags(profile) & aiProcess_JoinIdenticalVertices))
+		weldVertices();
 
-				if (!mesh->mNormals) {
+	std::vector<bool> hasNormals(scene->mNumMeshes);
+	for (uint32_t m = 0; m < scene->mNumMeshes; m++)
+		hasNormals[m] = scene->mMeshes[m]->mNormals != nullptr;
+	computeMissingNormals(hasNormals);
+}
 
-					glm::vec3 n = glm::cross(vertices[vIds[1]].position - vertices[vIds[0]].position, vertices[vIds[2]].position - vertices[vIds[0]].position);
+void MeshLoader::loadGlb(const std::string& meshFile)
+{
+	GlbLoader glb;
+	if (!glb.open(meshFile)) {
+		std::cout << "[ERROR] Cannot load " << meshFile << std::endl;
+		return;
+	}
 
-					vertices[vIds[0]].normal += n;
-					vertices[vIds[1]].normal += n;
-					vertices[vIds[2]].normal += n;
+	// One sub mesh per primitive, 32-bit counts like the GPU buffers.
+	const auto& primitives = glb.getPrimitives();
+	uint64_t nVertices = 0;
+	uint64_t nIndices  = 0;
+	for (const auto& primitive : primitives)
+	{
+		nVertices += primitive.positions.count;
+		nIndices  += GlbLoader::getIndexCount(primitive);
+	}
+	if (nVertices > std::numeric_limits<uint32_t>::max() || nIndices > std::numeric_limits<uint32_t>::max()) {
+		std::cout << "[ERROR] " << meshFile << " has more vertices or indices than 32-bit indices address" << std::endl;
+		return;
+	}
 
-				}
+	subMeshes.resize(primitives.size());
+	uint32_t firstVertex = 0;
+	uint32_t firstIndex  = 0;
+	for (size_t p = 0; p < primitives.size(); p++)
+	{
+		SubMesh& subMesh = subMeshes[p];
+		subMesh.firstIndex  = firstIndex;
+		subMesh.indexCount  = GlbLoader::getIndexCount(primitives[p]);
+		subMesh.firstVertex = firstVertex;
+		subMesh.vertexCount = primitives[p].positions.count;
+		firstIndex  += subMesh.indexCount;
+		firstVertex += subMesh.vertexCount;
+	}
+
+	vertices.resize(static_cast<size_t>(nVertices));
+	indices.resize(static_cast<size_t>(nIndices));
+
+	// Straight from the mapping into the streams, each range of a primitive on its own thread.
+	bool inRange = true;
+	for (size_t p = 0; p < primitives.size(); p++)
+	{
+		const auto&    primitive = primitives[p];
+		const SubMesh& subMesh   = subMeshes[p];
+
+		uint32_t nRanges = getParallelRangeCount(subMesh.vertexCount, MinVerticesPerThread);
+		parallelForRanges(subMesh.vertexCount, nRanges, [this, &primitive, &subMesh](uint32_t, size_t begin, size_t end)
+		{
+			GlbLoader::writeVertices(primitive, vertices.data() + subMesh.firstVertex, begin, end);
+		});
+
+		std::vector<uint8_t> rangeInRange(getParallelRangeCount(subMesh.indexCount, MinVerticesPerThread), 1);
+		parallelForRanges(subMesh.indexCount, static_cast<uint32_t>(rangeInRange.size()), [this, &primitive, &subMesh, &rangeInRange](uint32_t range, size_t begin, size_t end)
+		{
+			rangeInRange[range] = GlbLoader::writeIndices(primitive, subMesh.firstVertex, indices.data() + subMesh.firstIndex, begin, end);
+		});
+		inRange &= std::find(rangeInRange.begin(), rangeInRange.end(), 0) == rangeInRange.end();
+	}
+
+	if (!inRange) {
+		std::cout << "[ERROR] " << meshFile << " has indices out of range" << std::endl;
+		vertices.clear();
+		indices.clear();
+		subMeshes.clear();
+		return;
+	}
+
+	std::vector<bool> hasNormals(primitives.size());
+	for (size_t p = 0; p < primitives.size(); p++)
+		hasNormals[p] = primitives[p].normals.count > 0;
+	computeMissingNormals(hasNormals);
+}
+
+void MeshLoader::computeMissingNormals(const std::vector<bool>& hasNormals)
+{
+	// Gathered per vertex over a vertex to triangle table instead of scattered per triangle, so the
+	// vertices can be summed in parallel. The triangles are listed in order, the sums match the
+	// serial scatter.
+	std::vector<uint32_t> vertexTriangleOffsets(vertices.size() + 1, 0);
+	bool missingNormals = false;
+	for (uint32_t m = 0; m < subMeshes.size(); m++)
+	{
+		if (hasNormals[m])
+			continue;
+
+		missingNormals = true;
+		for (uint32_t i = subMeshes[m].firstIndex; i < subMeshes[m].firstIndex + subMeshes[m].indexCount; i++)
+			vertexTriangleOffsets[indices[i] + 1]++;
+	}
+	if (!missingNormals)
+		return;
+
+	for (size_t v = 0; v < vertices.size(); v++)
+		vertexTriangleOffsets[v + 1] += vertexTriangleOffsets[v];
+
+	std::vector<uint32_t> vertexTriangles(vertexTriangleOffsets.back());
+	std::vector<uint32_t> fill(vertexTriangleOffsets.begin(), vertexTriangleOffsets.end() - 1);
+	for (uint32_t m = 0; m < subMeshes.size(); m++)
+	{
+		if (hasNormals[m])
+			continue;
+
+		for (uint32_t i = subMeshes[m].firstIndex; i < subMeshes[m].firstIndex + subMeshes[m].indexCount; i++)
+			vertexTriangles[fill[indices[i]]++] = i / 3;
+	}
+
+	uint32_t nRanges = getParallelRangeCount(vertices.size(), MinVerticesPerThread);
+	parallelForRanges(vertices.size(), nRanges, [this, &vertexTriangleOffsets, &vertexTriangles](uint32_t, size_t begin, size_t end)
+	{
+		for (size_t v = begin; v < end; v++)
+		{
+			if (vertexTriangleOffsets[v] == vertexTriangleOffsets[v + 1])
+				continue;
+
+			glm::vec3 normal(0.0f);
+			for (uint32_t t = vertexTriangleOffsets[v]; t < vertexTriangleOffsets[v + 1]; t++)
+			{
+				const uint32_t* triangle = &indices[vertexTriangles[t] * 3];
+				normal += glm::cross(vertices[triangle[1]].position - vertices[triangle[0]].position, vertices[triangle[2]].position - vertices[triangle[0]].position);
 			}
+			vertices[v].normal = glm::normalize(normal);
 		}
+	});
+}
+
+void MeshLoader::weldVertices()
+{
+	// Vertices of different sub meshes stay apart. Meshes without normals have zero normals here,
+	// they are welded by position.
+	struct WeldKey
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		uint32_t  subMesh;
+	};
+
+	std::vector<WeldKey> keys(vertices.size());
+	for (uint32_t m = 0; m < subMeshes.size(); m++)
+	{
+		const SubMesh& subMesh = subMeshes[m];
+		for (uint32_t v = subMesh.firstVertex; v < subMesh.firstVertex + subMesh.vertexCount; v++)
+			keys[v] = { vertices[v].position, vertices[v].normal, m };
 	}
 
-	for (auto& v : vertices) {
-		v.normal = glm::normalize(v.normal);
+	VertexWelder<WeldKey> welder;
+	uint32_t nWelded = welder.weld(keys.data(), keys.size());
+	if (nWelded == vertices.size())
+		return;
+
+	// Welded vertices are numbered in input order, the sub meshes keep contiguous ranges.
+	const std::vector<uint32_t>& remap   = welder.getRemap();
+	const std::vector<uint32_t>& uniques = welder.getUniques();
+
+	std::vector<Vertex> weldedVertices(nWelded);
+	for (uint32_t w = 0; w < nWelded; w++)
+		weldedVertices[w] = vertices[uniques[w]];
+
+	uint32_t nRanges = getParallelRangeCount(indices.size(), MinVerticesPerThread);
+	parallelForRanges(indices.size(), nRanges, [this, &remap](uint32_t, size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			indices[i] = remap[indices[i]];
+	});
+
+	for (auto& subMesh : subMeshes)
+	{
+		uint32_t end = subMesh.firstVertex + subMesh.vertexCount;
+		subMesh.firstVertex = subMesh.firstVertex < remap.size() ? remap[subMesh.firstVertex] : nWelded;
+		subMesh.vertexCount = (end < remap.size() ? remap[end] : nWelded) - subMesh.firstVertex;
+	}
+
+	vertices.swap(weldedVertices);
+}
+
+bool MeshLoader::splitSubMeshes(uint32_t maxVertices)
+{
+	bool needsSplit = false;
+	for (auto& subMesh : subMeshes)
+		needsSplit = needsSplit || subMesh.vertexCount > maxVertices;
+	if (!needsSplit || maxVertices < 3)
+		return false;
+
+	std::vector<Vertex>   splitVertices;
+	std::vector<uint32_t> splitIndices;
+	std::vector<SubMesh>  splitSubMeshes;
+	splitVertices.reserve(vertices.size());
+	splitIndices.reserve(indices.size());
+
+	const uint32_t unmapped = std::numeric_limits<uint32_t>::max();
+
+	for (auto& subMesh : subMeshes)
+	{
+		// New vertex of every vertex of the sub mesh in the current chunk.
+		std::vector<uint32_t> remap(subMesh.vertexCount, unmapped);
+		std::vector<uint32_t> chunkVertices;
+
+		SubMesh chunk;
+		chunk.firstIndex  = static_cast<uint32_t>(splitIndices.size());
+		chunk.firstVertex = static_cast<uint32_t>(splitVertices.size());
+
+		for (uint32_t i = subMesh.firstIndex; i + 2 < subMesh.firstIndex + subMesh.indexCount; i += 3)
+		{
+			uint32_t newVertices = 0;
+			for (uint32_t c = 0; c < 3; c++)
+				newVertices += remap[indices[i + c] - subMesh.firstVertex] == unmapped ? 1 : 0;
+
+			// Close the chunk before the triangle would not fit anymore.
+			if (chunkVertices.size() + newVertices > maxVertices)
+			{
+				chunk.indexCount  = static_cast<uint32_t>(splitIndices.size()) - chunk.firstIndex;
+				chunk.vertexCount = static_cast<uint32_t>(chunkVertices.size());
+				splitSubMeshes.push_back(chunk);
+
+				for (uint32_t v : chunkVertices)
+					remap[v] = unmapped;
+				chunkVertices.clear();
+
+				chunk.firstIndex  = static_cast<uint32_t>(splitIndices.size());
+				chunk.firstVertex = static_cast<uint32_t>(splitVertices.size());
+			}
+
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				uint32_t v = indices[i + c] - subMesh.firstVertex;
+				if (remap[v] == unmapped)
+				{
+					remap[v] = static_cast<uint32_t>(splitVertices.size());
+					splitVertices.push_back(vertices[subMesh.firstVertex + v]);
+					chunkVertices.push_back(v);
+				}
+				splitIndices.push_back(remap[v]);
+			}
+		}
+
+		chunk.indexCount  = static_cast<uint32_t>(splitIndices.size()) - chunk.firstIndex;
+		chunk.vertexCount = static_cast<uint32_t>(chunkVertices.size());
+		if (chunk.indexCount > 0)
+			splitSubMeshes.push_back(chunk);
 	}
+
+	vertices.swap(splitVertices);
+	indices.swap(splitIndices);
+	subMeshes.swap(splitSubMeshes);
+	return true;
 }
@@ -8,16 +8,59 @@
 class MeshLoader
 {
 public:
-	MeshLoader(const std::string& meshFile);
+	// The assimp post processing of the constructor. Only positions and normals are read: Default
+	// strips every other vertex component and joins identical vertices itself with a VertexWelder on
+	// all cores. WithTangents computes the tangent space and lets assimp join the vertices.
+	enum class ImportProfile
+	{
+		Default,
+		WithTangents
+	};
+
+	// Empty, for meshes filled from elsewhere like a MeshCache.
+	MeshLoader() = default;
+	// The outputs are sized from the scene first, then the sub meshes are copied in parallel blocks
+	// into their ranges. Missing normals are gathered per vertex from the adjacent faces in parallel.
+	// .glb files are read by a GlbLoader instead of assimp, one sub mesh per primitive, the profile
+	// does not apply to them.
+	MeshLoader(const std::string& meshFile, ImportProfile profile = ImportProfile::Default);
 	~MeshLoader() = default;
 
+	MeshLoader(MeshLoader&&) = default;
+	MeshLoader& operator=(MeshLoader&&) = default;
+
+	// The assimp post processing steps of a profile, part of the key of cached meshes.
+	static uint32_t getImportFlags(ImportProfile profile);
+
 	struct Vertex
 	{
 		glm::vec3 position;
 		glm::vec3 normal;
 	};
 
+	// Index and vertex range of one mesh of the file inside the shared buffers.
+	struct SubMesh
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		uint32_t firstVertex;
+		uint32_t vertexCount;
+	};
+
+	// Splits sub meshes with more than maxVertices vertices into several, each with its own copy of
+	// the vertices it shares with the others, so every sub mesh can use 16-bit indices relative to
+	// its first vertex. Triangles keep their order. Returns false if nothing had to be split.
+	bool splitSubMeshes(uint32_t maxVertices);
+
+private:
+	void loadGlb(const std::string& meshFile);
+	// Joins identical vertices of each sub mesh and remaps the indices.
+	void weldVertices();
+	// Sets the normals of the sub meshes without normals to the sum of the adjacent face normals.
+	void computeMissingNormals(const std::vector<bool>& hasNormals);
+
 public:
 	std::vector<Vertex> vertices;
 	std::vector<uint32_t> indices;
+	std::vector<SubMesh> subMeshes;
 };
\ No newline at end of file
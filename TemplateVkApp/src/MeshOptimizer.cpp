@@ -0,0 +1,287 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+// ======================================
+// Analysis
+// ======================================
+MeshOptimizer::CacheStats MeshOptimizer::analyzeVertexCache(const uint32_t* indices, size_t indexCount, uint32_t firstVertex, uint32_t vertexCount, uint32_t cacheSize)
+{
+	CacheStats stats;
+	if (indexCount < 3 || vertexCount == 0)
+		return stats;
+
+	// A vertex is in the FIFO while fewer than cacheSize misses happened after it was loaded.
+	std::vector<uint32_t> loadedAt(vertexCount, 0);
+	uint32_t misses = 0;
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		uint32_t v = indices[i] - firstVertex;
+		if (loadedAt[v] == 0 || misses - loadedAt[v] + 1 > cacheSize)
+		{
+			misses++;
+			loadedAt[v] = misses;
+		}
+	}
+
+	stats.acmr = static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+	stats.atvr = static_cast<float>(misses) / static_cast<float>(vertexCount);
+	return stats;
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::analyzeVertexCache(const MeshLoader& mesh, uint32_t cacheSize)
+{
+	// Weighted by triangles and vertices over all sub meshes.
+	double misses = 0.0;
+	size_t triangles = 0;
+	size_t vertexCount = 0;
+
+	for (auto& subMesh : mesh.subMeshes)
+	{
+		CacheStats subStats = analyzeVertexCache(mesh.indices.data() + subMesh.firstIndex, subMesh.indexCount, subMesh.firstVertex, subMesh.vertexCount, cacheSize);
+		misses      += static_cast<double>(subStats.acmr) * (subMesh.indexCount / 3);
+		triangles   += subMesh.indexCount / 3;
+		vertexCount += subMesh.vertexCount;
+	}
+
+	CacheStats stats;
+	if (triangles > 0)
+		stats.acmr = static_cast<float>(misses / triangles);
+	if (vertexCount > 0)
+		stats.atvr = static_cast<float>(misses / vertexCount);
+	return stats;
+}
+
+// ======================================
+// Vertex cache (Tipsify)
+// ======================================
+void MeshOptimizer::optimizeVertexCache(uint32_t* indices, size_t indexCount, uint32_t firstVertex, uint32_t vertexCount,
+	std::vector<uint32_t>& clusterStarts, uint32_t cacheSize)
+{
+	clusterStarts.clear();
+
+	uint32_t triangleCount = static_cast<uint32_t>(indexCount / 3);
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	// Triangles around every vertex, as offsets into one array.
+	std::vector<uint32_t> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < 3 * static_cast<size_t>(triangleCount); i++)
+		liveTriangles[indices[i] - firstVertex]++;
+
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (uint32_t v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+
+	std::vector<uint32_t> adjacency(adjacencyOffsets[vertexCount]);
+	std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		for (uint32_t c = 0; c < 3; c++)
+			adjacency[fill[indices[3 * t + c] - firstVertex]++] = t;
+	}
+
+	std::vector<uint32_t> cacheTime(vertexCount, 0);
+	std::vector<bool>     emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnds;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> output;
+	output.reserve(3 * triangleCount);
+
+	const uint32_t noVertex = std::numeric_limits<uint32_t>::max();
+	uint32_t time   = cacheSize + 1;
+	uint32_t cursor = 0;
+	uint32_t fan    = 0;
+	bool     skipped = true;
+
+	while (fan != noVertex)
+	{
+		// A fan whose vertex is not cached anymore starts a new cluster.
+		if (skipped && adjacencyOffsets[fan] != adjacencyOffsets[fan + 1])
+			clusterStarts.push_back(static_cast<uint32_t>(output.size() / 3));
+
+		candidates.clear();
+		for (uint32_t a = adjacencyOffsets[fan]; a < adjacencyOffsets[fan + 1]; a++)
+		{
+			uint32_t t = adjacency[a];
+			if (emitted[t])
+				continue;
+
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				uint32_t v = indices[3 * t + c] - firstVertex;
+				output.push_back(indices[3 * t + c]);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+				if (time - cacheTime[v] > cacheSize)
+					cacheTime[v] = time++;
+			}
+			emitted[t] = true;
+		}
+
+		// The next fan: a candidate which stays in the cache for all its triangles, the oldest one.
+		// Candidates which would fall out of the cache have no priority and are left to the dead end
+		// search.
+		uint32_t next = noVertex;
+		uint32_t bestPriority = 0;
+		for (uint32_t v : candidates)
+		{
+			if (liveTriangles[v] == 0)
+				continue;
+
+			uint32_t priority = 0;
+			if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+				priority = time - cacheTime[v];
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = v;
+			}
+		}
+
+		skipped = next == noVertex;
+		if (next == noVertex)
+		{
+			// Dead end: the most recent vertex with triangles left, then the next one in input order.
+			while (!deadEnds.empty() && next == noVertex)
+			{
+				uint32_t v = deadEnds.back();
+				deadEnds.pop_back();
+				if (liveTriangles[v] > 0)
+					next = v;
+			}
+			while (cursor < vertexCount && next == noVertex)
+			{
+				if (liveTriangles[cursor] > 0)
+					next = cursor;
+				cursor++;
+			}
+		}
+
+		fan = next;
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+// ======================================
+// Overdraw
+// ======================================
+void MeshOptimizer::optimizeOverdraw(uint32_t* indices, size_t indexCount, const std::vector<MeshLoader::Vertex>& vertices,
+	const std::vector<uint32_t>& clusterStarts)
+{
+	uint32_t triangleCount = static_cast<uint32_t>(indexCount / 3);
+	if (clusterStarts.size() < 2 || triangleCount == 0)
+		return;
+
+	struct Cluster
+	{
+		uint32_t  firstTriangle;
+		uint32_t  triangleCount;
+		glm::vec3 centroid;
+		glm::vec3 normal;
+		float     sortKey;
+	};
+
+	// Area weighted centroid and normal of every cluster and of the whole range.
+	std::vector<Cluster> clusters(clusterStarts.size());
+	glm::vec3 meshCentroid(0.0f);
+	float     meshArea = 0.0f;
+
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		Cluster& cluster = clusters[c];
+		cluster.firstTriangle = clusterStarts[c];
+		cluster.triangleCount = (c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount) - cluster.firstTriangle;
+		cluster.centroid = glm::vec3(0.0f);
+		cluster.normal   = glm::vec3(0.0f);
+
+		float clusterArea = 0.0f;
+		for (uint32_t t = cluster.firstTriangle; t < cluster.firstTriangle + cluster.triangleCount; t++)
+		{
+			const glm::vec3& p0 = vertices[indices[3 * t + 0]].position;
+			const glm::vec3& p1 = vertices[indices[3 * t + 1]].position;
+			const glm::vec3& p2 = vertices[indices[3 * t + 2]].position;
+
+			glm::vec3 n    = glm::cross(p1 - p0, p2 - p0);
+			float     area = glm::length(n);
+
+			cluster.centroid += area * (p0 + p1 + p2) / 3.0f;
+			cluster.normal   += n;
+			clusterArea      += area;
+		}
+
+		meshCentroid += cluster.centroid;
+		meshArea     += clusterArea;
+		if (clusterArea > 0.0f)
+			cluster.centroid /= clusterArea;
+	}
+
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	// Clusters far out and facing outwards occlude the rest of the mesh from most directions.
+	for (auto& cluster : clusters)
+	{
+		float normalLength = glm::length(cluster.normal);
+		cluster.sortKey = normalLength > 0.0f ? glm::dot(cluster.centroid - meshCentroid, cluster.normal / normalLength) : 0.0f;
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<uint32_t> sorted;
+	sorted.reserve(3 * triangleCount);
+	for (auto& cluster : clusters)
+		sorted.insert(sorted.end(), indices + 3 * cluster.firstTriangle, indices + 3 * (cluster.firstTriangle + cluster.triangleCount));
+
+	std::copy(sorted.begin(), sorted.end(), indices);
+}
+
+// ======================================
+// Vertex fetch
+// ======================================
+void MeshOptimizer::optimizeVertexFetch(std::vector<MeshLoader::Vertex>& vertices, uint32_t* indices, size_t indexCount,
+	uint32_t firstVertex, uint32_t vertexCount)
+{
+	const uint32_t unmapped = std::numeric_limits<uint32_t>::max();
+	std::vector<uint32_t> remap(vertexCount, unmapped);
+	std::vector<MeshLoader::Vertex> reordered;
+	reordered.reserve(vertexCount);
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		uint32_t v = indices[i] - firstVertex;
+		if (remap[v] == unmapped)
+		{
+			remap[v] = static_cast<uint32_t>(reordered.size());
+			reordered.push_back(vertices[firstVertex + v]);
+		}
+		indices[i] = firstVertex + remap[v];
+	}
+
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		if (remap[v] == unmapped)
+			reordered.push_back(vertices[firstVertex + v]);
+	}
+
+	std::copy(reordered.begin(), reordered.end(), vertices.begin() + firstVertex);
+}
+
+void MeshOptimizer::optimize(MeshLoader& mesh, uint32_t cacheSize)
+{
+	std::vector<uint32_t> clusterStarts;
+	for (auto& subMesh : mesh.subMeshes)
+	{
+		uint32_t* indices = mesh.indices.data() + subMesh.firstIndex;
+
+		optimizeVertexCache(indices, subMesh.indexCount, subMesh.firstVertex, subMesh.vertexCount, clusterStarts, cacheSize);
+		optimizeOverdraw(indices, subMesh.indexCount, mesh.vertices, clusterStarts);
+		optimizeVertexFetch(mesh.vertices, indices, subMesh.indexCount, subMesh.firstVertex, subMesh.vertexCount);
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "MeshLoader.h"
+
+// Load time reordering of triangle meshes for the GPU, after Sander et al., "Fast Triangle
+// Reordering for Vertex Locality and Reduced Overdraw" (Tipsify).
+//
+// 1. Vertex cache: triangles are emitted fan by fan around a vertex, the next fan vertex is the
+//    cached one with the most remaining triangles, so the post-transform cache hits more often.
+// 2. Overdraw: the order is cut into clusters where the cache had to be left (a dead end), and the
+//    clusters are sorted so the ones facing away from the mesh center, which are likely in front,
+//    are drawn first. This does not depend on the view and keeps the cache order inside clusters.
+// 3. Vertex fetch: vertices are renumbered in the order the triangles first use them.
+//
+// Everything works per sub mesh, triangles and vertices stay inside their ranges.
+class MeshOptimizer
+{
+public:
+	static const uint32_t DefaultCacheSize = 16;
+
+	// Simulated FIFO post-transform cache.
+	struct CacheStats
+	{
+		float acmr = 0.0f;   // transformed vertices per triangle, 0.5 is ideal for large grids
+		float atvr = 0.0f;   // transformed vertices per vertex, 1 is ideal
+	};
+
+	static CacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, uint32_t firstVertex, uint32_t vertexCount, uint32_t cacheSize = DefaultCacheSize);
+	static CacheStats analyzeVertexCache(const MeshLoader& mesh, uint32_t cacheSize = DefaultCacheSize);
+
+	// Tipsify order of indices[0, indexCount), which reference [firstVertex, firstVertex + vertexCount).
+	// clusterStarts receives the first triangle of every cluster.
+	static void optimizeVertexCache(uint32_t* indices, size_t indexCount, uint32_t firstVertex, uint32_t vertexCount,
+		std::vector<uint32_t>& clusterStarts, uint32_t cacheSize = DefaultCacheSize);
+
+	// Sorts the clusters from optimizeVertexCache() front to back by their view independent
+	// occlusion potential.
+	static void optimizeOverdraw(uint32_t* indices, size_t indexCount, const std::vector<MeshLoader::Vertex>& vertices,
+		const std::vector<uint32_t>& clusterStarts);
+
+	// Renumbers the vertices of [firstVertex, firstVertex + vertexCount) in first use order. Unused
+	// vertices move to the end of the range.
+	static void optimizeVertexFetch(std::vector<MeshLoader::Vertex>& vertices, uint32_t* indices, size_t indexCount,
+		uint32_t firstVertex, uint32_t vertexCount);
+
+	// All three passes on every sub mesh.
+	static void optimize(MeshLoader& mesh, uint32_t cacheSize = DefaultCacheSize);
+};
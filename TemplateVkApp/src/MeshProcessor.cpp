@@ -0,0 +1,387 @@
+#include "MeshProcessor.h"
+
+#include "VkRenderer.h"
+
+#include <iostream>
+#include <string.h>
+
+static const char* KernelShaderFiles[] =
+{
+	"glsl/meshAdjacencyCount.comp",
+	"glsl/meshAdjacencyScan.comp",
+	"glsl/meshAdjacencyFill.comp",
+	"glsl/meshFaceNormals.comp",
+	"glsl/meshVertexNormals.comp",
+	"glsl/meshSmooth.comp",
+	"glsl/meshDisplace.comp",
+	"glsl/meshBounds.comp",
+	"glsl/meshCentroid.comp",
+	"glsl/meshNormalize.comp"
+};
+
+static const uint32_t NumBindings = 9;
+
+MeshProcessor::MeshProcessor(VkRenderer& renderer, ShaderVariantCache& shaders): renderer(renderer)
+{
+	initDescriptors();
+
+	for (uint32_t kernel = 0; kernel < KernelCount; kernel++)
+	{
+		ShaderStage computeShader;
+		if (!shaders.getVariant(KernelShaderFiles[kernel], VK_SHADER_STAGE_COMPUTE_BIT, "main", ShaderDefines(), computeShader))
+		{
+			std::cout << "[ERROR] Cannot compile mesh processing kernel " << KernelShaderFiles[kernel] << std::endl;
+			continue;
+		}
+
+		m_pipelines[kernel] =
+			std::unique_ptr<ComputePipeline>(
+				new ComputePipeline(renderer, { m_descriptorSetLayout }, computeShader, sizeof(KernelParams))
+				);
+	}
+}
+
+MeshProcessor::~MeshProcessor()
+{
+	for (auto& pipeline : m_pipelines)
+		pipeline.reset(nullptr);
+
+	destroyMeshBuffers();
+
+	vkDestroyDescriptorPool(renderer.getVkDevice(), m_descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(renderer.getVkDevice(), m_descriptorSetLayout, nullptr);
+}
+
+void MeshProcessor::initDescriptors()
+{
+	// All kernels share one layout, every binding is a storage buffer:
+	// 0 vertices, 1 target vertices, 2 indices, 3 face normals,
+	// 4 adjacency offsets, 5 adjacency faces, 6 adjacency counts, 7 bounds, 8 position sums
+	std::array<VkDescriptorSetLayoutBinding, NumBindings> bindings{};
+	for (uint32_t i = 0; i < NumBindings; i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		bindings[i].pImmutableSamplers = nullptr;
+	}
+
+	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
+	descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	descriptorSetLayoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	descriptorSetLayoutCreateInfo.pBindings = bindings.data();
+	vkCreateDescriptorSetLayout(renderer.getVkDevice(), &descriptorSetLayoutCreateInfo, nullptr, &m_descriptorSetLayout);
+
+	VkDescriptorPoolSize descriptorSetPoolSize{};
+	descriptorSetPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorSetPoolSize.descriptorCount = NumBindings * static_cast<uint32_t>(m_descriptorSets.size());
+
+	VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+	descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descriptorPoolCreateInfo.maxSets = static_cast<uint32_t>(m_descriptorSets.size());
+	descriptorPoolCreateInfo.poolSizeCount = 1;
+	descriptorPoolCreateInfo.pPoolSizes = &descriptorSetPoolSize;
+	vkCreateDescriptorPool(renderer.getVkDevice(), &descriptorPoolCreateInfo, nullptr, &m_descriptorPool);
+
+	std::array<VkDescriptorSetLayout, 2> setLayouts = { m_descriptorSetLayout, m_descriptorSetLayout };
+
+	VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+	descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	descriptorSetAllocateInfo.descriptorSetCount = static_cast<uint32_t>(setLayouts.size());
+	descriptorSetAllocateInfo.pSetLayouts = setLayouts.data();
+	descriptorSetAllocateInfo.descriptorPool = m_descriptorPool;
+	vkAllocateDescriptorSets(renderer.getVkDevice(), &descriptorSetAllocateInfo, m_descriptorSets.data());
+}
+
+void MeshProcessor::updateDescriptorSets()
+{
+	for (uint32_t set = 0; set < m_descriptorSets.size(); set++)
+	{
+		// Set i reads vertex buffer i and writes the other one.
+		std::array<VkBuffer, NumBindings> buffers =
+		{
+			m_vertexBuffers[set],
+			m_vertexBuffers[1 - set],
+			m_indexBuffer,
+			m_faceNormalBuffer.getVkBuffer(),
+			m_adjacencyOffsetBuffer.getVkBuffer(),
+			m_adjacencyFaceBuffer.getVkBuffer(),
+			m_adjacencyCountBuffer.getVkBuffer(),
+			m_boundsBuffer.getVkBuffer(),
+			m_positionSumBuffer.getVkBuffer()
+		};
+
+		std::array<VkDescriptorBufferInfo, NumBindings> descriptorBufferInfos{};
+		std::array<VkWriteDescriptorSet, NumBindings>   descriptorWrites{};
+		for (uint32_t i = 0; i < NumBindings; i++)
+		{
+			descriptorBufferInfos[i].buffer = buffers[i];
+			descriptorBufferInfos[i].offset = 0;
+			descriptorBufferInfos[i].range = VK_WHOLE_SIZE;
+
+			descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptorWrites[i].dstSet = m_descriptorSets[set];
+			descriptorWrites[i].dstBinding = i;
+			descriptorWrites[i].dstArrayElement = 0;
+			descriptorWrites[i].descriptorCount = 1;
+			descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptorWrites[i].pBufferInfo = &descriptorBufferInfos[i];
+		}
+
+		vkUpdateDescriptorSets(renderer.getVkDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+}
+
+void MeshProcessor::createMeshBuffers(bool withScratchVertexBuffer)
+{
+	const VkBufferUsageFlags storageUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+	// Vertex size is the one of PlyObjVertex: position and normal.
+	if (withScratchVertexBuffer)
+	{
+		m_scratchVertexBuffer = renderer.createBuffer(storageUsage, m_nVertices * 6 * sizeof(float));
+		m_vertexBuffers[1]    = m_scratchVertexBuffer.getVkBuffer();
+	}
+	m_hasScratchVertexBuffer = withScratchVertexBuffer;
+
+	m_faceNormalBuffer      = renderer.createBuffer(storageUsage, m_nFaces * 3 * sizeof(float));
+	m_adjacencyOffsetBuffer = renderer.createBuffer(storageUsage, (m_nVertices + 1) * sizeof(uint32_t));
+	m_adjacencyFaceBuffer   = renderer.createBuffer(storageUsage, m_nFaces * 3 * sizeof(uint32_t));
+	m_adjacencyCountBuffer  = renderer.createBuffer(storageUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, m_nVertices * sizeof(uint32_t));
+	m_boundsBuffer          = renderer.createBuffer(storageUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 12 * sizeof(uint32_t));
+	m_positionSumBuffer     = renderer.createBuffer(storageUsage, ((m_nVertices + LocalWorkGroupSize - 1) / LocalWorkGroupSize) * 4 * sizeof(float));
+	m_hasMeshBuffers = true;
+}
+
+void MeshProcessor::destroyMeshBuffers()
+{
+	if (!m_hasMeshBuffers)
+		return;
+
+	if (m_hasScratchVertexBuffer)
+		renderer.destroyBuffer(m_scratchVertexBuffer);
+	renderer.destroyBuffer(m_faceNormalBuffer);
+	renderer.destroyBuffer(m_adjacencyOffsetBuffer);
+	renderer.destroyBuffer(m_adjacencyFaceBuffer);
+	renderer.destroyBuffer(m_adjacencyCountBuffer);
+	renderer.destroyBuffer(m_boundsBuffer);
+	renderer.destroyBuffer(m_positionSumBuffer);
+	m_hasScratchVertexBuffer = false;
+	m_hasMeshBuffers = false;
+}
+
+void MeshProcessor::setMesh(VkCommandBuffer cmdBuffer, const Buffer& vertexBuffer, const Buffer& indexBuffer, uint32_t nVertices, uint32_t nIndices)
+{
+	destroyMeshBuffers();
+
+	m_vertexBuffers[0] = vertexBuffer.getVkBuffer();
+	m_indexBuffer      = indexBuffer.getVkBuffer();
+	m_nVertices        = nVertices;
+	m_nFaces           = nIndices / 3;
+	m_current          = 0;
+
+	createMeshBuffers(true);
+	updateDescriptorSets();
+	buildAdjacency(cmdBuffer);
+}
+
+void MeshProcessor::setMesh(VkCommandBuffer cmdBuffer, const Buffer& vertexBuffer, const Buffer& secondVertexBuffer, const Buffer& indexBuffer, uint32_t nVertices, uint32_t nIndices)
+{
+	destroyMeshBuffers();
+
+	m_vertexBuffers[0] = vertexBuffer.getVkBuffer();
+	m_vertexBuffers[1] = secondVertexBuffer.getVkBuffer();
+	m_indexBuffer      = indexBuffer.getVkBuffer();
+	m_nVertices        = nVertices;
+	m_nFaces           = nIndices / 3;
+	m_current          = 0;
+
+	createMeshBuffers(false);
+	updateDescriptorSets();
+	buildAdjacency(cmdBuffer);
+}
+
+uint32_t MeshProcessor::getCurrentVertexBuffer() const
+{
+	return m_current;
+}
+
+void MeshProcessor::buildAdjacency(VkCommandBuffer cmdBuffer)
+{
+	// ======================================
+	// Build vertex to face adjacency (CSR)
+	// ======================================
+	vkCmdFillBuffer(cmdBuffer, m_adjacencyCountBuffer.getVkBuffer(), 0, VK_WHOLE_SIZE, 0);
+	transferToComputeBarrier(cmdBuffer);
+
+	dispatch(cmdBuffer, KernelCountAdjacency, m_nFaces, 0.0f);
+
+	// The scan is a single workgroup walking over all vertices.
+	dispatch(cmdBuffer, KernelScanAdjacency, 1, 0.0f);
+
+	dispatch(cmdBuffer, KernelFillAdjacency, m_nFaces, 0.0f);
+}
+
+void MeshProcessor::recomputeNormals(VkCommandBuffer cmdBuffer)
+{
+	dispatch(cmdBuffer, KernelFaceNormals, m_nFaces, 0.0f);
+	dispatch(cmdBuffer, KernelVertexNormals, m_nVertices, 0.0f);
+}
+
+void MeshProcessor::displace(VkCommandBuffer cmdBuffer, float amount)
+{
+	dispatchPingPong(cmdBuffer, KernelDisplace, amount);
+	resolveScratch(cmdBuffer);
+}
+
+void MeshProcessor::smoothLaplacian(VkCommandBuffer cmdBuffer, uint32_t iterations, float lambda)
+{
+	smooth(cmdBuffer, std::vector<float>(iterations, lambda));
+}
+
+void MeshProcessor::smoothTaubin(VkCommandBuffer cmdBuffer, uint32_t iterations, float lambda, float mu)
+{
+	std::vector<float> weights;
+	for (uint32_t i = 0; i < iterations; i++)
+	{
+		weights.push_back(lambda);
+		weights.push_back(mu);
+	}
+	smooth(cmdBuffer, weights);
+}
+
+void MeshProcessor::smooth(VkCommandBuffer cmdBuffer, const std::vector<float>& weights)
+{
+	for (float weight : weights)
+		dispatchPingPong(cmdBuffer, KernelSmooth, weight);
+
+	resolveScratch(cmdBuffer);
+}
+
+void MeshProcessor::resolveScratch(VkCommandBuffer cmdBuffer)
+{
+	// A smoothing pass with weight 0 is a copy.
+	if (m_hasScratchVertexBuffer && m_current != 0)
+		dispatchPingPong(cmdBuffer, KernelSmooth, 0.0f);
+}
+
+void MeshProcessor::computeBounds(VkCommandBuffer cmdBuffer)
+{
+	vkCmdFillBuffer(cmdBuffer, m_boundsBuffer.getVkBuffer(), 0,                    4 * sizeof(uint32_t), 0xffffffff);
+	vkCmdFillBuffer(cmdBuffer, m_boundsBuffer.getVkBuffer(), 4 * sizeof(uint32_t), 4 * sizeof(uint32_t), 0);
+	transferToComputeBarrier(cmdBuffer);
+
+	dispatch(cmdBuffer, KernelBounds, m_nVertices, 0.0f);
+
+	// A single workgroup adds up the position sums of all workgroups.
+	dispatch(cmdBuffer, KernelCentroid, 1, 0.0f);
+}
+
+void MeshProcessor::normalize(VkCommandBuffer cmdBuffer, float scale)
+{
+	dispatchPingPong(cmdBuffer, KernelNormalize, scale);
+	resolveScratch(cmdBuffer);
+}
+
+void MeshProcessor::barrierForVertexInput(VkCommandBuffer cmdBuffer)
+{
+	VkMemoryBarrier memoryBarrier{};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(cmdBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0,
+		1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+const Buffer& MeshProcessor::getBoundsBuffer() const
+{
+	return m_boundsBuffer;
+}
+
+AABB MeshProcessor::readBounds() const
+{
+	uint32_t bounds[8];
+	void* boundsData = renderer.getBufferAllocator()->mapBuffer(m_boundsBuffer);
+	memcpy(bounds, boundsData, sizeof(bounds));
+	renderer.getBufferAllocator()->unmapBuffer(m_boundsBuffer);
+
+	float min[3] = { decodeBounds(bounds[0]), decodeBounds(bounds[1]), decodeBounds(bounds[2]) };
+	float max[3] = { decodeBounds(bounds[4]), decodeBounds(bounds[5]), decodeBounds(bounds[6]) };
+	return AABB(min, max);
+}
+
+glm::vec3 MeshProcessor::readCentroid() const
+{
+	glm::vec3 centroid;
+	const uint8_t* boundsData = static_cast<const uint8_t*>(renderer.getBufferAllocator()->mapBuffer(m_boundsBuffer));
+	memcpy(&centroid, boundsData + 8 * sizeof(uint32_t), sizeof(centroid));
+	renderer.getBufferAllocator()->unmapBuffer(m_boundsBuffer);
+
+	return centroid;
+}
+
+float MeshProcessor::decodeBounds(uint32_t orderedBits)
+{
+	// Inverse of orderedBits() in meshBounds.comp.
+	uint32_t bits = (orderedBits & 0x80000000u) != 0 ? orderedBits & 0x7fffffffu : ~orderedBits;
+
+	float value;
+	memcpy(&value, &bits, sizeof(float));
+	return value;
+}
+
+void MeshProcessor::dispatch(VkCommandBuffer cmdBuffer, Kernel kernel, uint32_t nThreads, float weight)
+{
+	ComputePipeline* pipeline = m_pipelines[kernel].get();
+	if (pipeline == nullptr || nThreads == 0)
+		return;
+
+	KernelParams params{};
+	params.nVertices = m_nVertices;
+	params.nFaces    = m_nFaces;
+	params.weight    = weight;
+
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipeline());
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->getPipelineLayout(), 0, 1, &m_descriptorSets[m_current], 0, nullptr);
+	vkCmdPushConstants(cmdBuffer, pipeline->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(KernelParams), &params);
+	vkCmdDispatch(cmdBuffer, (nThreads + LocalWorkGroupSize - 1) / LocalWorkGroupSize, 1, 1);
+
+	// Every kernel consumes the output of the previous one.
+	computeBarrier(cmdBuffer);
+}
+
+void MeshProcessor::dispatchPingPong(VkCommandBuffer cmdBuffer, Kernel kernel, float weight)
+{
+	if (m_pipelines[kernel] == nullptr)
+		return;
+
+	dispatch(cmdBuffer, kernel, m_nVertices, weight);
+	m_current = 1 - m_current;
+}
+
+void MeshProcessor::computeBarrier(VkCommandBuffer cmdBuffer)
+{
+	VkMemoryBarrier memoryBarrier{};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(cmdBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+void MeshProcessor::transferToComputeBarrier(VkCommandBuffer cmdBuffer)
+{
+	VkMemoryBarrier memoryBarrier{};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(cmdBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
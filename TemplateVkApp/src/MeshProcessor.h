@@ -0,0 +1,149 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "AABB.h"
+#include "Buffer.h"
+#include "ComputePipeline.h"
+#include "ShaderVariantCache.h"
+
+class VkRenderer;
+
+// Compute kernels which process a triangle mesh that already lives in GPU buffers: normal
+// recomputation, Laplacian/Taubin smoothing, displacement along the normals, bounds and centroid
+// reduction and normalization.
+// All functions only record commands, nothing is read back unless readBounds() is called.
+//
+// Kernels which move vertices read one vertex buffer and write the other. With a single vertex buffer
+// the second one is an internal scratch buffer and results are copied back. With two vertex buffers
+// (ping-pong) the result stays where it was written, see getCurrentVertexBuffer(), so one buffer can
+// be drawn while the other one is written.
+//
+// The vertex buffer holds PlyObjVertex (position, normal) and needs VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+// the index buffer holds 32-bit triangle list indices and needs it as well.
+class MeshProcessor
+{
+public:
+	MeshProcessor(VkRenderer& renderer, ShaderVariantCache& shaders);
+	~MeshProcessor();
+
+	// Allocates the scratch buffers and records the vertex-to-face adjacency build. The adjacency only
+	// depends on the topology, so it is built once and reused by every kernel afterwards.
+	void setMesh(VkCommandBuffer cmdBuffer, const Buffer& vertexBuffer, const Buffer& indexBuffer, uint32_t nVertices, uint32_t nIndices);
+
+	// Ping-pong version: both vertex buffers have the same size, the current data is in the first one.
+	void setMesh(VkCommandBuffer cmdBuffer, const Buffer& vertexBuffer, const Buffer& secondVertexBuffer, const Buffer& indexBuffer, uint32_t nVertices, uint32_t nIndices);
+
+	// 0 if the latest vertices are in the first vertex buffer, 1 if they are in the second one.
+	// Always 0 without ping-pong buffers.
+	uint32_t getCurrentVertexBuffer() const;
+
+	// Area weighted vertex normals: face normals first, then every vertex gathers its faces.
+	void recomputeNormals(VkCommandBuffer cmdBuffer);
+
+	// Moves every vertex along its normal. Normals are not updated, see recomputeNormals().
+	void displace(VkCommandBuffer cmdBuffer, float amount);
+
+	// Uniform Laplacian smoothing, weight in (0, 1].
+	void smoothLaplacian(VkCommandBuffer cmdBuffer, uint32_t iterations, float lambda);
+
+	// Taubin smoothing, lambda > 0 and mu < -lambda. Does not shrink the mesh like plain Laplacian smoothing.
+	void smoothTaubin(VkCommandBuffer cmdBuffer, uint32_t iterations, float lambda, float mu);
+
+	// Reduces the vertex positions to an axis aligned box and their centroid in getBoundsBuffer().
+	void computeBounds(VkCommandBuffer cmdBuffer);
+
+	// Moves the centroid of the last computeBounds() to the origin and scales the mesh, in one pass.
+	// The centroid stays on the GPU. Normals are not changed.
+	void normalize(VkCommandBuffer cmdBuffer, float scale);
+
+	// Makes the processed vertices visible to the vertex input stage and to vertex shaders which fetch
+	// them from storage buffers. Record after the last kernel.
+	void barrierForVertexInput(VkCommandBuffer cmdBuffer);
+
+	// uvec4 min, uvec4 max as order preserving uints, see decodeBounds(), then the centroid as vec4.
+	const Buffer& getBoundsBuffer() const;
+
+	// Read the results of computeBounds(). The commands have to be completed.
+	AABB      readBounds() const;
+	glm::vec3 readCentroid() const;
+
+	static float decodeBounds(uint32_t orderedBits);
+
+private:
+	enum Kernel
+	{
+		KernelCountAdjacency,
+		KernelScanAdjacency,
+		KernelFillAdjacency,
+		KernelFaceNormals,
+		KernelVertexNormals,
+		KernelSmooth,
+		KernelDisplace,
+		KernelBounds,
+		KernelCentroid,
+		KernelNormalize,
+		KernelCount
+	};
+
+	// Matches the push constants of the mesh*.comp shaders.
+	struct KernelParams
+	{
+		uint32_t nVertices;
+		uint32_t nFaces;
+		float    weight;
+		uint32_t unused;
+	};
+
+	void initDescriptors();
+	void updateDescriptorSets();
+	void createMeshBuffers(bool withScratchVertexBuffer);
+	void destroyMeshBuffers();
+	void buildAdjacency(VkCommandBuffer cmdBuffer);
+
+	// Kernels read binding 0 and write binding 1 of the descriptor set of the current vertex buffer.
+	void dispatch(VkCommandBuffer cmdBuffer, Kernel kernel, uint32_t nThreads, float weight);
+
+	// Runs a kernel writing the other vertex buffer, which becomes the current one.
+	void dispatchPingPong(VkCommandBuffer cmdBuffer, Kernel kernel, float weight);
+
+	// Copies the vertices back from the scratch buffer. Does nothing for ping-pong buffers.
+	void resolveScratch(VkCommandBuffer cmdBuffer);
+
+	void smooth(VkCommandBuffer cmdBuffer, const std::vector<float>& weights);
+
+	static void computeBarrier(VkCommandBuffer cmdBuffer);
+	static void transferToComputeBarrier(VkCommandBuffer cmdBuffer);
+
+	VkRenderer&       renderer;
+
+	const uint32_t    LocalWorkGroupSize = 128;
+
+	std::array<std::unique_ptr<ComputePipeline>, KernelCount> m_pipelines;
+
+	VkDescriptorSetLayout         m_descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool              m_descriptorPool      = VK_NULL_HANDLE;
+	std::array<VkDescriptorSet, 2> m_descriptorSets     = {};
+
+	// Not owned
+	std::array<VkBuffer, 2> m_vertexBuffers = {};
+	VkBuffer m_indexBuffer  = VK_NULL_HANDLE;
+	uint32_t m_nVertices    = 0;
+	uint32_t m_nFaces       = 0;
+	uint32_t m_current      = 0;
+
+	// Owned
+	bool     m_hasScratchVertexBuffer = false;
+	Buffer   m_scratchVertexBuffer;
+	Buffer   m_faceNormalBuffer;
+	Buffer   m_adjacencyOffsetBuffer;
+	Buffer   m_adjacencyFaceBuffer;
+	Buffer   m_adjacencyCountBuffer;
+	Buffer   m_boundsBuffer;
+	Buffer   m_positionSumBuffer;
+	bool     m_hasMeshBuffers = false;
+};
@@ -0,0 +1,159 @@
+#include "MeshStreamer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+
+#include "MeshBounds.h"
+
+MeshStreamer::MeshStreamer(const std::string& plyFile, float normalizedSize) :
+	m_queue(QueueCapacity), m_stop(false), m_done(false), m_failed(false)
+{
+	if (!m_reader.readDataInfo(plyFile.c_str()))
+		return;
+
+	// 32-bit indices on the GPU.
+	uint64_t nVertices = m_reader.getNumVertices();
+	uint64_t nIndices  = m_reader.getNumFaces() * 3;
+	if (nVertices == 0 || nIndices == 0 || nVertices > std::numeric_limits<uint32_t>::max() || nIndices > std::numeric_limits<uint32_t>::max())
+	{
+		m_reader.close();
+		return;
+	}
+
+	m_nVertices = static_cast<uint32_t>(nVertices);
+	m_nIndices  = static_cast<uint32_t>(nIndices);
+	m_thread    = std::thread(&MeshStreamer::streamLoop, this, plyFile, normalizedSize);
+}
+
+MeshStreamer::~MeshStreamer()
+{
+	m_stop = true;
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+bool MeshStreamer::isStarted() const
+{
+	return m_thread.joinable();
+}
+
+uint32_t MeshStreamer::getNumVertices() const
+{
+	return m_nVertices;
+}
+
+uint32_t MeshStreamer::getNumIndices() const
+{
+	return m_nIndices;
+}
+
+bool MeshStreamer::pop(Chunk& chunk)
+{
+	return m_queue.pop(chunk);
+}
+
+bool MeshStreamer::isFinished() const
+{
+	return m_done.load(std::memory_order_acquire) && m_queue.empty();
+}
+
+bool MeshStreamer::hasFailed() const
+{
+	return m_failed.load(std::memory_order_acquire);
+}
+
+// ======================================
+// Worker
+// ======================================
+bool MeshStreamer::push(Chunk& chunk)
+{
+	// The render thread pops once per frame, a short sleep is enough.
+	while (!m_queue.push(chunk))
+	{
+		if (m_stop)
+			return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+bool MeshStreamer::pushVertices(std::vector<MeshLoader::Vertex>& vertices, float normalizedSize, bool radialNormals)
+{
+	MeshBounds bounds = MeshBounds::compute(vertices);
+	MeshBounds::normalize(vertices, bounds.centroid, normalizedSize);
+
+	// The center is at the origin now.
+	if (radialNormals)
+	{
+		for (auto& vertex : vertices)
+			vertex.normal = glm::length(vertex.position) > 0.0f ? glm::normalize(vertex.position) : glm::vec3(0.0f, 0.0f, 1.0f);
+	}
+
+	for (uint32_t first = 0; first < vertices.size(); first += ChunkVertices)
+	{
+		uint32_t count = (std::min)(ChunkVertices, static_cast<uint32_t>(vertices.size()) - first);
+
+		Chunk chunk;
+		chunk.firstVertex = first;
+		chunk.vertices.assign(vertices.begin() + first, vertices.begin() + first + count);
+		if (!push(chunk))
+			return false;
+	}
+	return true;
+}
+
+void MeshStreamer::streamLoop(std::string plyFile, float normalizedSize)
+{
+	// The vertices are needed as a whole for the normalization.
+	std::vector<MeshLoader::Vertex> vertices(m_nVertices);
+	bool     verticesPushed = false;
+	bool     failed         = false;
+	uint32_t nIndices       = 0;
+
+	bool complete = m_reader.readBatches(ChunkVertices, ChunkTriangles, [&](const PlyDataReader::Batch& batch)
+	{
+		if (m_stop)
+			return false;
+
+		// x, y, z and, if the file has them, nx, ny, nz.
+		uint32_t nFloats = batch.VertexStride / sizeof(float);
+		for (uint64_t v = 0; v < batch.VertexCount && nFloats >= 3; v++)
+		{
+			const float* values = batch.Vertices + v * nFloats;
+			MeshLoader::Vertex& vertex = vertices[static_cast<size_t>(batch.FirstVertex + v)];
+			vertex.position = glm::vec3(values[0], values[1], values[2]);
+			vertex.normal   = nFloats >= 6 ? glm::vec3(values[3], values[4], values[5]) : glm::vec3(0.0f);
+		}
+
+		if (batch.FaceCount == 0)
+			return true;
+
+		if (!verticesPushed)
+		{
+			verticesPushed = true;
+			if (!pushVertices(vertices, normalizedSize, nFloats < 6))
+				return false;
+		}
+
+		// Whole triangles which index into the mesh, the GPU buffers are sized for these.
+		failed = batch.IndexCount != batch.FaceCount * 3 || nIndices + batch.IndexCount > m_nIndices;
+		for (uint64_t i = 0; i < batch.IndexCount && !failed; i++)
+			failed = batch.Indices[i] >= m_nVertices;
+		if (failed)
+			return false;
+
+		Chunk chunk;
+		chunk.firstIndex = nIndices;
+		chunk.indices.assign(batch.Indices, batch.Indices + batch.IndexCount);
+		nIndices += static_cast<uint32_t>(batch.IndexCount);
+		return push(chunk);
+	});
+
+	if (failed)
+		std::cout << "[ERROR] " << plyFile << " cannot be streamed, it has faces which are not triangles or indices out of range" << std::endl;
+
+	m_failed.store(!complete && !m_stop, std::memory_order_release);
+	m_done.store(true, std::memory_order_release);
+}
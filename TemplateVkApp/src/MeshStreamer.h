@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MeshLoader.h"
+#include "SpscQueue.h"
+#include "plydatareader.h"
+
+// Loads a PLY triangle mesh on a background thread and hands it to the render thread in chunks, so
+// frames are drawn while a big file is still being read.
+//
+// The constructor only reads the header, the counts are known right away and the GPU buffers can be
+// created at full size. The worker reads the file with PlyDataReader::readBatches(), centers and
+// scales the vertices like MeshBounds::normalize() once all of them are in, and pushes them and then
+// the triangles in chunks of at most ChunkVertices vertices or ChunkTriangles triangles through a
+// single producer single consumer queue. The queue is bounded, a worker which gets ahead of the
+// uploads waits, so the host memory stays at the vertices plus QueueCapacity chunks.
+//
+// Every vertex chunk arrives before the first index chunk, an index which is resident only
+// references resident vertices. Files without normals get the direction from the center until the
+// normals are recomputed on the GPU.
+class MeshStreamer
+{
+public:
+	static const uint32_t ChunkVertices  = 1 << 16;
+	static const uint32_t ChunkTriangles = 1 << 16;
+	static const uint32_t QueueCapacity  = 16;
+
+	struct Chunk
+	{
+		uint32_t                        firstVertex = 0;
+		std::vector<MeshLoader::Vertex> vertices;
+		uint32_t                        firstIndex  = 0;
+		std::vector<uint32_t>           indices;
+	};
+
+	// Starts the worker if the header can be read and the mesh has vertices and faces.
+	MeshStreamer(const std::string& plyFile, float normalizedSize);
+	~MeshStreamer();
+
+	MeshStreamer(const MeshStreamer&) = delete;
+	MeshStreamer& operator=(const MeshStreamer&) = delete;
+
+	bool     isStarted() const;
+	uint32_t getNumVertices() const;
+	uint32_t getNumIndices() const;
+
+	// Render thread. False if no chunk is ready.
+	bool pop(Chunk& chunk);
+
+	// True once the worker is done and every chunk was popped.
+	bool isFinished() const;
+	// The file ended early, has faces which are not triangles or indices out of range.
+	bool hasFailed() const;
+
+private:
+	void streamLoop(std::string plyFile, float normalizedSize);
+	bool push(Chunk& chunk);
+	bool pushVertices(std::vector<MeshLoader::Vertex>& vertices, float normalizedSize, bool radialNormals);
+
+	PlyDataReader     m_reader;
+	uint32_t          m_nVertices = 0;
+	uint32_t          m_nIndices  = 0;
+
+	SpscQueue<Chunk>  m_queue;
+	std::thread       m_thread;
+	std::atomic<bool> m_stop;
+	std::atomic<bool> m_done;
+	std::atomic<bool> m_failed;
+};
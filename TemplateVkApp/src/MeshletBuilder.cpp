@@ -0,0 +1,370 @@
+#include "MeshletBuilder.h"
+
+#include <fstream>
+#include <iostream>
+
+#include "helper.h"
+
+static const uint8_t  NotInMeshlet = 0xff;
+
+static const uint32_t MeshletFileMagic   = 0x4c48534d;   // "MSHL"
+static const uint32_t MeshletFileVersion = 1;
+
+// Normal cones wider than this cannot reject anything useful.
+static const float    MinConeDot = 0.1f;
+
+void MeshletBuilder::build(const std::vector<MeshLoader::Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t firstIndex, uint32_t indexCount, uint32_t objectIndex)
+{
+	uint32_t nTriangles = indexCount / 3;
+	if (nTriangles == 0)
+		return;
+
+	if (m_localIndex.size() < vertices.size())
+		m_localIndex.resize(vertices.size(), NotInMeshlet);
+
+	const uint32_t* triangles = &indices[firstIndex];
+
+	// ======================================
+	// Face normals, degenerate faces are skipped
+	// ======================================
+	std::vector<glm::vec3> faceNormals(nTriangles, glm::vec3(0.0f));
+	std::vector<bool>      triangleUsed(nTriangles, false);
+
+	uint32_t minVertex = triangles[0];
+	uint32_t maxVertex = triangles[0];
+	for (uint32_t t = 0; t < nTriangles; t++)
+	{
+		uint32_t a = triangles[t * 3 + 0];
+		uint32_t b = triangles[t * 3 + 1];
+		uint32_t c = triangles[t * 3 + 2];
+		minVertex = glm::min(minVertex, glm::min(a, glm::min(b, c)));
+		maxVertex = glm::max(maxVertex, glm::max(a, glm::max(b, c)));
+
+		// Degenerate triangles do not rasterize anything.
+		if (a == b || b == c || c == a)
+		{
+			triangleUsed[t] = true;
+			continue;
+		}
+
+		glm::vec3 n = glm::cross(vertices[b].position - vertices[a].position, vertices[c].position - vertices[a].position);
+		float area = glm::length(n);
+		if (area > 0.0f)
+			faceNormals[t] = n / area;
+	}
+
+	// ======================================
+	// Vertex to triangle adjacency
+	// ======================================
+	uint32_t nRangeVertices = maxVertex - minVertex + 1;
+	std::vector<uint32_t> adjacencyOffsets(nRangeVertices + 1, 0);
+	for (uint32_t i = 0; i < nTriangles * 3; i++)
+		adjacencyOffsets[triangles[i] - minVertex + 1]++;
+	for (uint32_t v = 0; v < nRangeVertices; v++)
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+	std::vector<uint32_t> adjacencyTriangles(nTriangles * 3);
+	std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (uint32_t i = 0; i < nTriangles * 3; i++)
+		adjacencyTriangles[adjacencyFill[triangles[i] - minVertex]++] = i / 3;
+
+	// ======================================
+	// Greedy growth
+	// ======================================
+	// The next triangle shares the most vertices with the meshlet, ties go to the one closest to the
+	// average normal, which keeps the normal cones narrow. Without any neighbour left the next unused
+	// triangle in index order starts a new patch.
+	Meshlet meshlet{};
+	meshlet.vertexOffset   = static_cast<uint32_t>(m_meshletVertices.size());
+	meshlet.triangleOffset = static_cast<uint32_t>(m_meshletTriangles.size() / 3);
+	meshlet.objectIndex    = objectIndex;
+
+	glm::vec3 meshletNormal(0.0f);
+	uint32_t  nextUnused = 0;
+
+	for (;;)
+	{
+		int64_t  best = -1;
+		uint32_t bestNewVertices = 4;
+		float    bestDot = -2.0f;
+
+		for (uint32_t v = 0; v < meshlet.vertexCount; v++)
+		{
+			uint32_t vertex = m_meshletVertices[meshlet.vertexOffset + v] - minVertex;
+			for (uint32_t i = adjacencyOffsets[vertex]; i < adjacencyOffsets[vertex + 1]; i++)
+			{
+				uint32_t t = adjacencyTriangles[i];
+				if (triangleUsed[t])
+					continue;
+
+				uint32_t nNewVertices = 0;
+				for (uint32_t k = 0; k < 3; k++)
+					nNewVertices += m_localIndex[triangles[t * 3 + k]] == NotInMeshlet ? 1 : 0;
+
+				float normalDot = glm::dot(faceNormals[t], meshletNormal);
+				if (nNewVertices < bestNewVertices || (nNewVertices == bestNewVertices && normalDot > bestDot))
+				{
+					best = t;
+					bestNewVertices = nNewVertices;
+					bestDot = normalDot;
+				}
+			}
+		}
+
+		if (best < 0)
+		{
+			while (nextUnused < nTriangles && triangleUsed[nextUnused])
+				nextUnused++;
+			if (nextUnused == nTriangles)
+				break;
+			best = nextUnused;
+		}
+
+		uint32_t t = static_cast<uint32_t>(best);
+		uint32_t nNewVertices = 0;
+		for (uint32_t k = 0; k < 3; k++)
+			nNewVertices += m_localIndex[triangles[t * 3 + k]] == NotInMeshlet ? 1 : 0;
+
+		if (meshlet.vertexCount + nNewVertices > MaxVertices || meshlet.triangleCount + 1 > MaxTriangles)
+		{
+			flushMeshlet(vertices, meshlet);
+			meshletNormal = glm::vec3(0.0f);
+		}
+
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			uint32_t vertex = triangles[t * 3 + k];
+			if (m_localIndex[vertex] == NotInMeshlet)
+			{
+				m_localIndex[vertex] = static_cast<uint8_t>(meshlet.vertexCount++);
+				m_meshletVertices.push_back(vertex);
+			}
+			m_meshletTriangles.push_back(m_localIndex[vertex]);
+		}
+		meshlet.triangleCount++;
+		meshletNormal += faceNormals[t];
+		triangleUsed[t] = true;
+	}
+
+	if (meshlet.triangleCount > 0)
+		flushMeshlet(vertices, meshlet);
+}
+
+void MeshletBuilder::build(const MeshLoader& mesh)
+{
+	for (uint32_t i = 0; i < mesh.subMeshes.size(); i++)
+		build(mesh.vertices, mesh.indices, mesh.subMeshes[i].firstIndex, mesh.subMeshes[i].indexCount, i);
+}
+
+void MeshletBuilder::flushMeshlet(const std::vector<MeshLoader::Vertex>& vertices, Meshlet& meshlet)
+{
+	for (uint32_t v = 0; v < meshlet.vertexCount; v++)
+		m_localIndex[m_meshletVertices[meshlet.vertexOffset + v]] = NotInMeshlet;
+
+	m_meshlets.push_back(meshlet);
+	m_bounds.push_back(computeBounds(vertices, meshlet));
+
+	meshlet.vertexOffset   = static_cast<uint32_t>(m_meshletVertices.size());
+	meshlet.triangleOffset = static_cast<uint32_t>(m_meshletTriangles.size() / 3);
+	meshlet.vertexCount    = 0;
+	meshlet.triangleCount  = 0;
+}
+
+MeshletBuilder::Bounds MeshletBuilder::computeBounds(const std::vector<MeshLoader::Vertex>& vertices, const Meshlet& meshlet) const
+{
+	Bounds bounds{};
+
+	// ======================================
+	// Bounding sphere around the box center
+	// ======================================
+	glm::vec3 minPos = vertices[m_meshletVertices[meshlet.vertexOffset]].position;
+	glm::vec3 maxPos = minPos;
+	for (uint32_t v = 0; v < meshlet.vertexCount; v++)
+	{
+		const glm::vec3& p = vertices[m_meshletVertices[meshlet.vertexOffset + v]].position;
+		minPos = glm::min(minPos, p);
+		maxPos = glm::max(maxPos, p);
+	}
+
+	bounds.center = 0.5f * (minPos + maxPos);
+	for (uint32_t v = 0; v < meshlet.vertexCount; v++)
+		bounds.radius = glm::max(bounds.radius, glm::length(vertices[m_meshletVertices[meshlet.vertexOffset + v]].position - bounds.center));
+
+	// ======================================
+	// Normal cone of the face normals
+	// ======================================
+	std::vector<glm::vec3> faceNormals;
+	faceNormals.reserve(meshlet.triangleCount);
+
+	glm::vec3 normalSum(0.0f);
+	for (uint32_t t = 0; t < meshlet.triangleCount; t++)
+	{
+		const uint8_t* triangle = &m_meshletTriangles[(meshlet.triangleOffset + t) * 3];
+		const glm::vec3& p0 = vertices[m_meshletVertices[meshlet.vertexOffset + triangle[0]]].position;
+		const glm::vec3& p1 = vertices[m_meshletVertices[meshlet.vertexOffset + triangle[1]]].position;
+		const glm::vec3& p2 = vertices[m_meshletVertices[meshlet.vertexOffset + triangle[2]]].position;
+
+		glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+		float area = glm::length(n);
+		if (area == 0.0f)
+			continue;
+
+		faceNormals.push_back(n / area);
+		normalSum += n / area;
+	}
+
+	bounds.coneAxis   = glm::vec3(0.0f, 0.0f, 1.0f);
+	bounds.coneCutoff = 1.0f;
+
+	float sumLength = glm::length(normalSum);
+	if (faceNormals.empty() || sumLength == 0.0f)
+		return bounds;
+
+	glm::vec3 axis = normalSum / sumLength;
+	float minDot = 1.0f;
+	for (auto& n : faceNormals)
+		minDot = glm::min(minDot, glm::dot(axis, n));
+
+	if (minDot <= MinConeDot)
+		return bounds;
+
+	// The sine of the cone half angle: the view direction has to be at least that far past
+	// perpendicular to every face normal.
+	bounds.coneAxis   = axis;
+	bounds.coneCutoff = glm::sqrt(1.0f - minDot * minDot);
+	return bounds;
+}
+
+void MeshletBuilder::clear()
+{
+	m_meshlets.clear();
+	m_bounds.clear();
+	m_meshletVertices.clear();
+	m_meshletTriangles.clear();
+}
+
+const std::vector<MeshletBuilder::Meshlet>& MeshletBuilder::getMeshlets() const
+{
+	return m_meshlets;
+}
+
+const std::vector<MeshletBuilder::Bounds>& MeshletBuilder::getBounds() const
+{
+	return m_bounds;
+}
+
+const std::vector<uint32_t>& MeshletBuilder::getMeshletVertices() const
+{
+	return m_meshletVertices;
+}
+
+const std::vector<uint8_t>& MeshletBuilder::getMeshletTriangles() const
+{
+	return m_meshletTriangles;
+}
+
+std::vector<uint32_t> MeshletBuilder::buildIndexBuffer() const
+{
+	std::vector<uint32_t> indices(m_meshletTriangles.size());
+	for (auto& meshlet : m_meshlets)
+	{
+		for (uint32_t i = 0; i < meshlet.triangleCount * 3; i++)
+		{
+			uint32_t index = meshlet.triangleOffset * 3 + i;
+			indices[index] = m_meshletVertices[meshlet.vertexOffset + m_meshletTriangles[index]];
+		}
+	}
+	return indices;
+}
+
+uint32_t MeshletBuilder::getFirstIndex(const Meshlet& meshlet)
+{
+	return meshlet.triangleOffset * 3;
+}
+
+uint32_t MeshletBuilder::getIndexCount(const Meshlet& meshlet)
+{
+	return meshlet.triangleCount * 3;
+}
+
+uint64_t MeshletBuilder::getSourceHash(const std::vector<MeshLoader::Vertex>& vertices, const std::vector<uint32_t>& indices)
+{
+	const uint32_t limits[2] = { MaxVertices, MaxTriangles };
+	uint64_t h = hashBytes(limits, sizeof(limits));
+	h = hashBytes(vertices.data(), vertices.size() * sizeof(MeshLoader::Vertex), h);
+	h = hashBytes(indices.data(), indices.size() * sizeof(uint32_t), h);
+	return h;
+}
+
+// ======================================
+// File: header, then the four arrays
+// ======================================
+template<typename T>
+static void writeArray(std::ofstream& file, const std::vector<T>& data)
+{
+	uint64_t size = data.size();
+	file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+	file.write(reinterpret_cast<const char*>(data.data()), data.size() * sizeof(T));
+}
+
+template<typename T>
+static bool readArray(std::ifstream& file, std::vector<T>& data)
+{
+	uint64_t size = 0;
+	if (!file.read(reinterpret_cast<char*>(&size), sizeof(size)))
+		return false;
+
+	data.resize(static_cast<size_t>(size));
+	return static_cast<bool>(file.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(T)));
+}
+
+bool MeshletBuilder::save(const std::string& path, uint64_t sourceHash) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "[ERROR] Cannot write meshlets to " << path << std::endl;
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(&MeshletFileMagic), sizeof(MeshletFileMagic));
+	file.write(reinterpret_cast<const char*>(&MeshletFileVersion), sizeof(MeshletFileVersion));
+	file.write(reinterpret_cast<const char*>(&sourceHash), sizeof(sourceHash));
+
+	writeArray(file, m_meshlets);
+	writeArray(file, m_bounds);
+	writeArray(file, m_meshletVertices);
+	writeArray(file, m_meshletTriangles);
+
+	return static_cast<bool>(file);
+}
+
+bool MeshletBuilder::load(const std::string& path, uint64_t sourceHash)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	uint32_t magic = 0;
+	uint32_t version = 0;
+	uint64_t fileSourceHash = 0;
+	file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+	file.read(reinterpret_cast<char*>(&version), sizeof(version));
+	file.read(reinterpret_cast<char*>(&fileSourceHash), sizeof(fileSourceHash));
+	if (!file || magic != MeshletFileMagic || version != MeshletFileVersion || fileSourceHash != sourceHash)
+		return false;
+
+	clear();
+	if (!readArray(file, m_meshlets) ||
+		!readArray(file, m_bounds) ||
+		!readArray(file, m_meshletVertices) ||
+		!readArray(file, m_meshletTriangles) ||
+		m_meshlets.size() != m_bounds.size())
+	{
+		std::cout << "[ERROR] Broken meshlet file " << path << std::endl;
+		clear();
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "MeshLoader.h"
+
+// Splits triangle meshes into meshlets, small clusters of at most MaxVertices vertices and
+// MaxTriangles triangles, and computes a bounding sphere and a normal cone for each of them so
+// whole clusters can be frustum and back-face culled.
+//
+// Meshlets are stored the usual way: a list of unique vertex indices per meshlet and 8-bit local
+// triangle indices into that list. buildIndexBuffer() expands them to a plain 32-bit index buffer in
+// which the triangles of every meshlet are contiguous, so a meshlet is an index range
+// (getFirstIndex(), getIndexCount()) and can be drawn with a regular indexed draw.
+//
+// The result can be saved next to the mesh and loaded again, so big meshes are clustered once.
+class MeshletBuilder
+{
+public:
+	static const uint32_t MaxVertices  = 64;
+	static const uint32_t MaxTriangles = 124;
+
+	struct Meshlet
+	{
+		uint32_t vertexOffset;     // into getMeshletVertices()
+		uint32_t triangleOffset;   // in triangles, into getMeshletTriangles()
+		uint32_t vertexCount;
+		uint32_t triangleCount;
+		uint32_t objectIndex;      // the index range (sub mesh) the meshlet was built from
+	};
+
+	// The cluster is back facing for every camera position c with
+	//     dot(center - c, coneAxis) >= coneCutoff * length(center - c) + radius
+	// A coneCutoff of 1 disables the test, the normals spread too much.
+	struct Bounds
+	{
+		glm::vec3 center;
+		float     radius;
+		glm::vec3 coneAxis;
+		float     coneCutoff;
+	};
+
+	MeshletBuilder() = default;
+	~MeshletBuilder() = default;
+
+	// Appends the meshlets of the triangles in indices[firstIndex, firstIndex + indexCount).
+	// Meshlets grow greedily over shared vertices, preferring faces that keep the normal cone narrow.
+	void build(const std::vector<MeshLoader::Vertex>& vertices, const std::vector<uint32_t>& indices, uint32_t firstIndex, uint32_t indexCount, uint32_t objectIndex);
+
+	// One object per sub mesh.
+	void build(const MeshLoader& mesh);
+
+	void clear();
+
+	const std::vector<Meshlet>&  getMeshlets() const;
+	const std::vector<Bounds>&   getBounds() const;
+	const std::vector<uint32_t>& getMeshletVertices() const;
+	const std::vector<uint8_t>&  getMeshletTriangles() const;
+
+	// 32-bit triangle list with the triangles of each meshlet next to each other.
+	std::vector<uint32_t> buildIndexBuffer() const;
+	static uint32_t getFirstIndex(const Meshlet& meshlet);
+	static uint32_t getIndexCount(const Meshlet& meshlet);
+
+	// Identifies the mesh the meshlets were built from, stored in the saved file.
+	static uint64_t getSourceHash(const std::vector<MeshLoader::Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+	// load() fails if the file is missing, broken or was built from a different mesh.
+	bool save(const std::string& path, uint64_t sourceHash) const;
+	bool load(const std::string& path, uint64_t sourceHash);
+
+private:
+	void flushMeshlet(const std::vector<MeshLoader::Vertex>& vertices, Meshlet& meshlet);
+	Bounds computeBounds(const std::vector<MeshLoader::Vertex>& vertices, const Meshlet& meshlet) const;
+
+	std::vector<Meshlet>  m_meshlets;
+	std::vector<Bounds>   m_bounds;
+	std::vector<uint32_t> m_meshletVertices;
+	std::vector<uint8_t>  m_meshletTriangles;
+
+	// Local index of every mesh vertex in the meshlet being built, 0xff if it is not in there.
+	std::vector<uint8_t>  m_localIndex;
+};
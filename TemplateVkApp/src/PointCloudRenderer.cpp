@@ -0,0 +1,488 @@
+#include "PointCloudRenderer.h"
+
+#include "VkRenderer.h"
+#include "helper.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+
+static const uint32_t ProjectWorkGroupSize = 128;
+static const uint32_t ResolveWorkGroupSize = 8;
+
+// Every byte set: behind every depth in [0, 1], read as empty by the resolve.
+static const uint32_t EmptyVisibility = 0xffffffff;
+
+PointCloudRenderer::PointCloudRenderer(VkRenderer& renderer, ShaderVariantCache& shaders, GraphicsPipelineCache& pipelines): renderer(renderer)
+{
+	m_width  = renderer.getVkSurfaceWidth();
+	m_height = renderer.getVkSurfaceHeight();
+	m_useInt64Atomics = renderer.isBufferInt64AtomicsEnabled();
+
+	m_visibilityBuffer = renderer.createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, static_cast<size_t>(m_width) * m_height * 2 * sizeof(uint32_t));
+	initImage(VK_FORMAT_R8G8B8A8_UNORM, m_colorImage, m_colorImageMemory, m_colorImageView);
+	initImage(VK_FORMAT_R32_SFLOAT, m_depthImage, m_depthImageMemory, m_depthImageView);
+
+	initDescriptors();
+	initPipelines(shaders, pipelines);
+}
+
+PointCloudRenderer::~PointCloudRenderer()
+{
+	VkDevice device = renderer.getVkDevice();
+
+	clear();
+
+	m_projectPipeline.reset(nullptr);
+	m_projectColorPipeline.reset(nullptr);
+	m_resolvePipeline.reset(nullptr);
+	m_displayPipeline.reset();
+
+	vkDestroyDescriptorPool(device, m_frameSetPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, m_frameSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, m_chunkSetLayout, nullptr);
+
+	vkDestroySampler(device, m_sampler, nullptr);
+	vkDestroyImageView(device, m_colorImageView, nullptr);
+	vkDestroyImage(device, m_colorImage, nullptr);
+	vkFreeMemory(device, m_colorImageMemory, nullptr);
+	vkDestroyImageView(device, m_depthImageView, nullptr);
+	vkDestroyImage(device, m_depthImage, nullptr);
+	vkFreeMemory(device, m_depthImageMemory, nullptr);
+
+	renderer.destroyBuffer(m_visibilityBuffer);
+}
+
+bool PointCloudRenderer::isSupported() const
+{
+	return m_projectPipeline != nullptr && m_resolvePipeline != nullptr && m_displayPipeline != nullptr &&
+		(m_useInt64Atomics || m_projectColorPipeline != nullptr);
+}
+
+bool PointCloudRenderer::usesInt64Atomics() const
+{
+	return m_useInt64Atomics;
+}
+
+uint32_t PointCloudRenderer::packColor(uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha)
+{
+	return static_cast<uint32_t>(red) | (static_cast<uint32_t>(green) << 8) | (static_cast<uint32_t>(blue) << 16) | (static_cast<uint32_t>(alpha) << 24);
+}
+
+void PointCloudRenderer::initImage(VkFormat format, VkImage& image, VkDeviceMemory& imageMemory, VkImageView& imageView)
+{
+	VkDevice device = renderer.getVkDevice();
+
+	// ===============================
+	// Create Image Handle
+	// ===============================
+	VkImageCreateInfo imageCreateInfo{};
+	imageCreateInfo.sType			= VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.imageType		= VK_IMAGE_TYPE_2D;
+	imageCreateInfo.format			= format;
+	imageCreateInfo.extent.width	= m_width;
+	imageCreateInfo.extent.height	= m_height;
+	imageCreateInfo.extent.depth	= 1;
+	imageCreateInfo.mipLevels		= 1;
+	imageCreateInfo.arrayLayers		= 1;
+	imageCreateInfo.samples			= VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.tiling			= VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.usage			= VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageCreateInfo.sharingMode		= VK_SHARING_MODE_EXCLUSIVE;
+	imageCreateInfo.initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
+
+	ErrorCheck(vkCreateImage(device, &imageCreateInfo, nullptr, &image));
+
+	// ==================================
+	// Allocate Memory for the Image
+	// ==================================
+	VkMemoryRequirements imageMemRequirements{};
+	vkGetImageMemoryRequirements(device, image, &imageMemRequirements);
+
+	VkMemoryAllocateInfo memAllocInfo{};
+	memAllocInfo.sType				= VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memAllocInfo.allocationSize		= imageMemRequirements.size;
+	memAllocInfo.memoryTypeIndex	= FindVkMemoryTypeIndex(renderer.getVkPhysicalDeviceMemProperties(), imageMemRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	ErrorCheck(vkAllocateMemory(device, &memAllocInfo, nullptr, &imageMemory));
+	vkBindImageMemory(device, image, imageMemory, 0);
+
+	// ===============================
+	// Image View
+	// ===============================
+	VkImageViewCreateInfo imageViewCreateInfo{};
+	imageViewCreateInfo.sType							= VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	imageViewCreateInfo.image							= image;
+	imageViewCreateInfo.viewType						= VK_IMAGE_VIEW_TYPE_2D;
+	imageViewCreateInfo.format							= format;
+	imageViewCreateInfo.subresourceRange.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
+	imageViewCreateInfo.subresourceRange.baseMipLevel	= 0;
+	imageViewCreateInfo.subresourceRange.levelCount		= 1;
+	imageViewCreateInfo.subresourceRange.baseArrayLayer	= 0;
+	imageViewCreateInfo.subresourceRange.layerCount		= 1;
+
+	ErrorCheck(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &imageView));
+}
+
+void PointCloudRenderer::initDescriptors()
+{
+	VkDevice device = renderer.getVkDevice();
+
+	// The composition reads single texels at the fragment position.
+	VkSamplerCreateInfo samplerCreateInfo{};
+	samplerCreateInfo.sType			= VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCreateInfo.magFilter		= VK_FILTER_NEAREST;
+	samplerCreateInfo.minFilter		= VK_FILTER_NEAREST;
+	samplerCreateInfo.mipmapMode	= VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCreateInfo.addressModeU	= VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeV	= VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeW	= VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+	ErrorCheck(vkCreateSampler(device, &samplerCreateInfo, nullptr, &m_sampler));
+
+	// ===============================
+	// Chunk layout
+	// ===============================
+	VkDescriptorSetLayoutBinding pointsBinding{};
+	pointsBinding.binding = 0;
+	pointsBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	pointsBinding.descriptorCount = 1;
+	pointsBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
+	descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	descriptorSetLayoutCreateInfo.bindingCount = 1;
+	descriptorSetLayoutCreateInfo.pBindings = &pointsBinding;
+	vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &m_chunkSetLayout);
+
+	// ===============================
+	// Frame layout and set
+	// ===============================
+	std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	for (uint32_t b = 1; b <= 2; b++)
+	{
+		bindings[b].binding = b;
+		bindings[b].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[b].descriptorCount = 1;
+		bindings[b].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	for (uint32_t b = 3; b <= 4; b++)
+	{
+		bindings[b].binding = b;
+		bindings[b].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[b].descriptorCount = 1;
+		bindings[b].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	}
+
+	descriptorSetLayoutCreateInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	descriptorSetLayoutCreateInfo.pBindings = bindings.data();
+	vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &m_frameSetLayout);
+
+	std::array<VkDescriptorPoolSize, 3> descriptorSetPoolSizes{};
+	descriptorSetPoolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptorSetPoolSizes[0].descriptorCount = 1;
+	descriptorSetPoolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	descriptorSetPoolSizes[1].descriptorCount = 2;
+	descriptorSetPoolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorSetPoolSizes[2].descriptorCount = 2;
+
+	VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+	descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	descriptorPoolCreateInfo.maxSets = 1;
+	descriptorPoolCreateInfo.poolSizeCount = static_cast<uint32_t>(descriptorSetPoolSizes.size());
+	descriptorPoolCreateInfo.pPoolSizes = descriptorSetPoolSizes.data();
+	vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &m_frameSetPool);
+
+	VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+	descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	descriptorSetAllocateInfo.descriptorSetCount = 1;
+	descriptorSetAllocateInfo.pSetLayouts = &m_frameSetLayout;
+	descriptorSetAllocateInfo.descriptorPool = m_frameSetPool;
+	vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &m_frameSet);
+
+	VkDescriptorBufferInfo visibilityBufferInfo{};
+	visibilityBufferInfo.buffer = m_visibilityBuffer.getVkBuffer();
+	visibilityBufferInfo.offset = 0;
+	visibilityBufferInfo.range = VK_WHOLE_SIZE;
+
+	std::array<VkDescriptorImageInfo, 4> imageInfos{};
+	imageInfos[0].imageView = m_colorImageView;
+	imageInfos[1].imageView = m_depthImageView;
+	imageInfos[2].imageView = m_colorImageView;
+	imageInfos[3].imageView = m_depthImageView;
+	for (auto& imageInfo : imageInfos)
+	{
+		imageInfo.sampler = m_sampler;
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	}
+
+	std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
+	for (uint32_t b = 0; b < descriptorWrites.size(); b++)
+	{
+		descriptorWrites[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[b].dstSet = m_frameSet;
+		descriptorWrites[b].dstBinding = b;
+		descriptorWrites[b].descriptorCount = 1;
+		descriptorWrites[b].descriptorType = bindings[b].descriptorType;
+		if (b == 0)
+			descriptorWrites[b].pBufferInfo = &visibilityBufferInfo;
+		else
+			descriptorWrites[b].pImageInfo = &imageInfos[b - 1];
+	}
+
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
+void PointCloudRenderer::initPipelines(ShaderVariantCache& shaders, GraphicsPipelineCache& pipelines)
+{
+	// ===============================
+	// Projection and resolve
+	// ===============================
+	ShaderDefines projectDefines;
+	projectDefines.set("INT64_ATOMICS", m_useInt64Atomics).set("COLOR_PASS", false);
+
+	ShaderStage computeShader;
+	if (shaders.getVariant("glsl/pointProject.comp", VK_SHADER_STAGE_COMPUTE_BIT, "main", projectDefines, computeShader))
+	{
+		m_projectPipeline =
+			std::unique_ptr<ComputePipeline>(
+				new ComputePipeline(renderer, { m_chunkSetLayout, m_frameSetLayout }, computeShader, sizeof(ProjectParams))
+				);
+	}
+
+	if (!m_useInt64Atomics)
+	{
+		projectDefines.set("COLOR_PASS", true);
+		if (shaders.getVariant("glsl/pointProject.comp", VK_SHADER_STAGE_COMPUTE_BIT, "main", projectDefines, computeShader))
+		{
+			m_projectColorPipeline =
+				std::unique_ptr<ComputePipeline>(
+					new ComputePipeline(renderer, { m_chunkSetLayout, m_frameSetLayout }, computeShader, sizeof(ProjectParams))
+					);
+		}
+	}
+
+	if (shaders.getVariant("glsl/pointResolve.comp", VK_SHADER_STAGE_COMPUTE_BIT, "main", ShaderDefines(), computeShader))
+	{
+		m_resolvePipeline =
+			std::unique_ptr<ComputePipeline>(
+				new ComputePipeline(renderer, { m_frameSetLayout }, computeShader, sizeof(ProjectParams))
+				);
+	}
+
+	// ===============================
+	// Composition
+	// ===============================
+	// A full screen triangle without vertex input; depth tested and written like the meshes.
+	ShaderStage vertexShader;
+	ShaderStage fragmentShader;
+	if (shaders.getVariant("glsl/pointDisplay.vert", VK_SHADER_STAGE_VERTEX_BIT, "main", ShaderDefines(), vertexShader) &&
+		shaders.getVariant("glsl/pointDisplay.frag", VK_SHADER_STAGE_FRAGMENT_BIT, "main", ShaderDefines(), fragmentShader))
+	{
+		GraphicsPipelineDescription pipelineDescription;
+		pipelineDescription.descriptorSetLayouts = { m_frameSetLayout };
+		pipelineDescription.shaderStages         = { vertexShader, fragmentShader };
+		pipelineDescription.primitiveTopology    = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		pipelineDescription.setRenderPass(renderer);
+
+		m_displayPipeline = pipelines.getOrCreate(pipelineDescription);
+	}
+
+	if (!isSupported())
+		std::cout << "[ERROR] Cannot compile the point cloud shaders." << std::endl;
+}
+
+void PointCloudRenderer::addPoints(const Point* points, uint64_t count)
+{
+	VkDevice device = renderer.getVkDevice();
+
+	uint64_t maxChunkSize = renderer.getVkPhysicalDeviceProperties().limits.maxStorageBufferRange / sizeof(Point);
+	uint32_t chunkSize = static_cast<uint32_t>((std::min)(maxChunkSize, static_cast<uint64_t>(MaxPointsPerChunk)));
+
+	for (uint64_t first = 0; first < count; first += chunkSize)
+	{
+		Chunk chunk{};
+		chunk.count = static_cast<uint32_t>((std::min)(count - first, static_cast<uint64_t>(chunkSize)));
+
+		chunk.buffer = renderer.createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, chunk.count * sizeof(Point));
+		void* chunkData = renderer.getBufferAllocator()->mapBuffer(chunk.buffer);
+		memcpy(chunkData, points + first, chunk.count * sizeof(Point));
+		renderer.getBufferAllocator()->unmapBuffer(chunk.buffer);
+
+		// A pool per chunk, chunks are only added and cleared together.
+		VkDescriptorPoolSize descriptorSetPoolSize{};
+		descriptorSetPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorSetPoolSize.descriptorCount = 1;
+
+		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{};
+		descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		descriptorPoolCreateInfo.maxSets = 1;
+		descriptorPoolCreateInfo.poolSizeCount = 1;
+		descriptorPoolCreateInfo.pPoolSizes = &descriptorSetPoolSize;
+		vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &chunk.descriptorPool);
+
+		VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{};
+		descriptorSetAllocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		descriptorSetAllocateInfo.descriptorSetCount = 1;
+		descriptorSetAllocateInfo.pSetLayouts = &m_chunkSetLayout;
+		descriptorSetAllocateInfo.descriptorPool = chunk.descriptorPool;
+		vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &chunk.descriptorSet);
+
+		VkDescriptorBufferInfo pointsBufferInfo{};
+		pointsBufferInfo.buffer = chunk.buffer.getVkBuffer();
+		pointsBufferInfo.offset = 0;
+		pointsBufferInfo.range = VK_WHOLE_SIZE;
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = chunk.descriptorSet;
+		descriptorWrite.dstBinding = 0;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrite.pBufferInfo = &pointsBufferInfo;
+		vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+
+		m_chunks.push_back(chunk);
+	}
+
+	m_numPoints += count;
+}
+
+void PointCloudRenderer::clear()
+{
+	for (auto& chunk : m_chunks)
+	{
+		vkDestroyDescriptorPool(renderer.getVkDevice(), chunk.descriptorPool, nullptr);
+		renderer.destroyBuffer(chunk.buffer);
+	}
+
+	m_chunks.clear();
+	m_numPoints = 0;
+	m_rendered = false;
+}
+
+uint64_t PointCloudRenderer::getNumPoints() const
+{
+	return m_numPoints;
+}
+
+void PointCloudRenderer::project(VkCommandBuffer cmdBuffer, ComputePipeline& pipeline, const ProjectParams& params)
+{
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.getPipeline());
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.getPipelineLayout(), 1, 1, &m_frameSet, 0, nullptr);
+
+	ProjectParams chunkParams = params;
+	for (auto& chunk : m_chunks)
+	{
+		chunkParams.pointCount = chunk.count;
+
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.getPipelineLayout(), 0, 1, &chunk.descriptorSet, 0, nullptr);
+		vkCmdPushConstants(cmdBuffer, pipeline.getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ProjectParams), &chunkParams);
+		vkCmdDispatch(cmdBuffer, (chunk.count + ProjectWorkGroupSize - 1) / ProjectWorkGroupSize, 1, 1);
+	}
+
+	VkMemoryBarrier projectBarrier{};
+	projectBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	projectBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	projectBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(cmdBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		1, &projectBarrier, 0, nullptr, 0, nullptr);
+}
+
+void PointCloudRenderer::render(VkCommandBuffer cmdBuffer, const glm::mat4& viewProjMatrix)
+{
+	m_rendered = false;
+	if (!isSupported() || m_chunks.empty())
+		return;
+
+	// ======================================
+	// Clear the visibility buffer
+	// ======================================
+	// The previous composition may still read the images; their contents are overwritten anyway.
+	VkMemoryBarrier clearBarrier{};
+	clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	clearBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	clearBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(cmdBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+	vkCmdFillBuffer(cmdBuffer, m_visibilityBuffer.getVkBuffer(), 0, VK_WHOLE_SIZE, EmptyVisibility);
+
+	VkMemoryBarrier fillBarrier{};
+	fillBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	fillBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	fillBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	std::array<VkImageMemoryBarrier, 2> imageBarriers{};
+	for (uint32_t i = 0; i < imageBarriers.size(); i++)
+	{
+		imageBarriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageBarriers[i].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		imageBarriers[i].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		imageBarriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageBarriers[i].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageBarriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarriers[i].image = i == 0 ? m_colorImage : m_depthImage;
+		imageBarriers[i].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		imageBarriers[i].subresourceRange.levelCount = 1;
+		imageBarriers[i].subresourceRange.layerCount = 1;
+	}
+
+	vkCmdPipelineBarrier(cmdBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		1, &fillBarrier, 0, nullptr, static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+
+	// ======================================
+	// Project the points, chunk by chunk
+	// ======================================
+	ProjectParams params{};
+	params.viewProjMatrix = viewProjMatrix;
+	params.width  = m_width;
+	params.height = m_height;
+
+	// Without 64-bit atomics all depths have to be final before colors are picked.
+	project(cmdBuffer, *m_projectPipeline, params);
+	if (!m_useInt64Atomics)
+		project(cmdBuffer, *m_projectColorPipeline, params);
+
+	// ======================================
+	// Resolve to the color and depth images
+	// ======================================
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_resolvePipeline->getPipeline());
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_resolvePipeline->getPipelineLayout(), 0, 1, &m_frameSet, 0, nullptr);
+	vkCmdPushConstants(cmdBuffer, m_resolvePipeline->getPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ProjectParams), &params);
+	vkCmdDispatch(cmdBuffer,
+		(m_width  + ResolveWorkGroupSize - 1) / ResolveWorkGroupSize,
+		(m_height + ResolveWorkGroupSize - 1) / ResolveWorkGroupSize, 1);
+
+	VkMemoryBarrier resolveBarrier{};
+	resolveBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	resolveBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	resolveBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(cmdBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+		1, &resolveBarrier, 0, nullptr, 0, nullptr);
+
+	m_rendered = true;
+}
+
+void PointCloudRenderer::draw(VkCommandBuffer cmdBuffer)
+{
+	if (!m_rendered)
+		return;
+
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_displayPipeline->getPipeline());
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_displayPipeline->getPipelineLayout(), 0, 1, &m_frameSet, 0, nullptr);
+	vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include "Buffer.h"
+#include "ComputePipeline.h"
+#include "GraphicsPipeline.h"
+#include "GraphicsPipelineCache.h"
+#include "ShaderVariantCache.h"
+
+class VkRenderer;
+
+// Draws large point clouds with compute shaders instead of the rasterizer, which wastes most of its
+// work on one pixel primitives.
+//
+// Every point is projected by one thread and written to a visibility buffer with one 64-bit value
+// per pixel, the depth in the high and the color in the low 32 bits, so an atomicMin keeps the
+// nearest point. Depths are in [0, 1] and compare as unsigned integers. Without 64-bit buffer
+// atomics (VK_KHR_shader_atomic_int64) the same result is reached in two passes: the nearest depth
+// first, then the smallest color of the points at that depth.
+//
+// A resolve pass turns the visibility buffer into a color and a depth image and closes single pixel
+// holes. draw() composes the images with the scene inside the render pass by writing gl_FragDepth,
+// so points and meshes hide each other.
+//
+// Points are uploaded in chunks of at most MaxPointsPerChunk points, each chunk is a storage buffer
+// of its own. Clouds larger than the largest storage buffer range are drawn with one dispatch per
+// chunk.
+class PointCloudRenderer
+{
+public:
+	// Matches Point in pointProject.comp (std430).
+	struct Point
+	{
+		glm::vec3 position;
+		uint32_t  color;      // RGBA8, red in the lowest byte, see packColor()
+	};
+
+	static const uint32_t MaxPointsPerChunk = 1 << 24;
+
+	PointCloudRenderer(VkRenderer& renderer, ShaderVariantCache& shaders, GraphicsPipelineCache& pipelines);
+	~PointCloudRenderer();
+
+	// False if a shader failed to compile.
+	bool isSupported() const;
+
+	// True if the visibility is resolved with 64-bit atomics in a single pass.
+	bool usesInt64Atomics() const;
+
+	// Copies the points into new chunks. Must not be called while recorded renders are executing.
+	void addPoints(const Point* points, uint64_t count);
+	void clear();
+
+	uint64_t getNumPoints() const;
+
+	// Records the projection and the resolve. Has to be outside of a render pass.
+	void render(VkCommandBuffer cmdBuffer, const glm::mat4& viewProjMatrix);
+
+	// Records the composition. Has to be inside the renderer's render pass, after render() and with
+	// the viewport and scissor set.
+	void draw(VkCommandBuffer cmdBuffer);
+
+	static uint32_t packColor(uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha);
+
+private:
+	// Matches the push constants of pointProject.comp and pointResolve.comp.
+	struct ProjectParams
+	{
+		glm::mat4 viewProjMatrix;
+		uint32_t  pointCount;
+		uint32_t  width;
+		uint32_t  height;
+		uint32_t  unused;
+	};
+
+	struct Chunk
+	{
+		Buffer           buffer;
+		uint32_t         count;
+		VkDescriptorPool descriptorPool;
+		VkDescriptorSet  descriptorSet;
+	};
+
+	void initImage(VkFormat format, VkImage& image, VkDeviceMemory& imageMemory, VkImageView& imageView);
+	void initDescriptors();
+	void initPipelines(ShaderVariantCache& shaders, GraphicsPipelineCache& pipelines);
+
+	void project(VkCommandBuffer cmdBuffer, ComputePipeline& pipeline, const ProjectParams& params);
+
+	VkRenderer& renderer;
+
+	bool                             m_useInt64Atomics = false;
+	std::unique_ptr<ComputePipeline> m_projectPipeline;        // single pass, or the depth pass
+	std::unique_ptr<ComputePipeline> m_projectColorPipeline;   // color pass without 64-bit atomics
+	std::unique_ptr<ComputePipeline> m_resolvePipeline;
+	std::shared_ptr<GraphicsPipeline> m_displayPipeline;
+
+	uint32_t m_width  = 0;
+	uint32_t m_height = 0;
+
+	std::vector<Chunk> m_chunks;
+	uint64_t           m_numPoints = 0;
+	bool               m_rendered = false;
+
+	Buffer         m_visibilityBuffer;
+	VkImage        m_colorImage       = VK_NULL_HANDLE;
+	VkDeviceMemory m_colorImageMemory = VK_NULL_HANDLE;
+	VkImageView    m_colorImageView   = VK_NULL_HANDLE;
+	VkImage        m_depthImage       = VK_NULL_HANDLE;
+	VkDeviceMemory m_depthImageMemory = VK_NULL_HANDLE;
+	VkImageView    m_depthImageView   = VK_NULL_HANDLE;
+	VkSampler      m_sampler          = VK_NULL_HANDLE;
+
+	// Set 0 of the projection: binding 0 the points of a chunk, one set per chunk.
+	VkDescriptorSetLayout m_chunkSetLayout = VK_NULL_HANDLE;
+
+	// Set 1 of the projection, set 0 of the resolve and the composition: binding 0 the visibility
+	// buffer, 1 and 2 the color and depth storage images, 3 and 4 the same images sampled.
+	VkDescriptorSetLayout m_frameSetLayout  = VK_NULL_HANDLE;
+	VkDescriptorPool      m_frameSetPool    = VK_NULL_HANDLE;
+	VkDescriptorSet       m_frameSet        = VK_NULL_HANDLE;
+};
@@ -2,6 +2,66 @@
 
 #include "helper.h"
 
+#include <algorithm>
+#include <atomic>
+
+ShaderDefines& ShaderDefines::set(const std::string& name, bool value)
+{
+	m_defines[name] = value ? "1" : "0";
+	return *this;
+}
+
+ShaderDefines& ShaderDefines::set(const std::string& name, int value)
+{
+	m_defines[name] = std::to_string(value);
+	return *this;
+}
+
+bool ShaderDefines::empty() const
+{
+	return m_defines.empty();
+}
+
+std::string ShaderDefines::getKey() const
+{
+	std::string key;
+	for (auto& define : m_defines)
+		key += define.first + "=" + define.second + ";";
+	return key;
+}
+
+std::string ShaderDefines::applyTo(const char* src, uint32_t len) const
+{
+	std::string source(src, len);
+	if (m_defines.empty())
+		return source;
+
+	// #version has to stay the first directive, so the defines go right after it.
+	size_t insertPos = 0;
+	uint32_t versionLine = 0;
+	size_t versionPos = source.find("#version");
+	if (versionPos != std::string::npos)
+	{
+		size_t lineEnd = source.find('\n', versionPos);
+		insertPos = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
+		versionLine = static_cast<uint32_t>(std::count(source.begin(), source.begin() + versionPos, '\n')) + 1;
+	}
+
+	std::string preamble;
+	if (insertPos == source.size() && insertPos > 0 && source.back() != '\n')
+		preamble += "\n";
+	for (auto& define : m_defines)
+		preamble += "#define " + define.first + " " + define.second + "\n";
+
+	// Keep the line numbers of compiler errors pointing into the original file.
+	preamble += "#line " + std::to_string(versionLine + 1) + "\n";
+
+	source.insert(insertPos, preamble);
+	return source;
+}
+
+uint32_t ShaderStage::s_glslTargetApiVersion = VK_API_VERSION_1_0;
+
 ShaderStage::ShaderStage()
 {
 }
@@ -17,24 +77,36 @@ bool ShaderStage::fromHLSLSource(VkDevice device, const char * src, uint32_t len
 
 bool ShaderStage::fromGLSLSource(VkDevice device, const char * src, uint32_t len, VkShaderStageFlagBits shaderStageType, const char * entryFunc)
 {
-	auto cleanEnv = []()
+	// Every compilation gets its own pair of files, so shaders can be compiled from several threads at once.
+	static std::atomic<uint32_t> compilationCounter(0);
+	const uint32_t compilationID = compilationCounter++;
+
+	char inFileName[64], outFileName[64];
+	sprintf_s(inFileName,  "in%u.shader",  compilationID);
+	sprintf_s(outFileName, "out%u.shader", compilationID);
+
+	const std::string inFilePath  = std::string("shaderCompilers/glsl/") + inFileName;
+	const std::string outFilePath = std::string("shaderCompilers/glsl/") + outFileName;
+
+	auto cleanEnv = [&]()
 	{
-		deleteFile("shaderCompilers/glsl/in.shader");
-		deleteFile("shaderCompilers/glsl/out.shader");
+		deleteFile(inFilePath.c_str());
+		deleteFile(outFilePath.c_str());
 	};
 
 	{
-		std::ofstream inputFile("shaderCompilers/glsl/in.shader");
+		std::ofstream inputFile(inFilePath);
 		inputFile.write(src, len);
 		inputFile.close();
 	}
 
 	char cmd[1024];
-	sprintf_s(cmd, "glslangValidator.exe -V100 -e %s -S %s -o out.shader in.shader", entryFunc, getGLSLangValidatorShaderStage(shaderStageType));
+	const char* targetEnv = s_glslTargetApiVersion >= VK_API_VERSION_1_1 ? "--target-env vulkan1.1 " : "";
+	sprintf_s(cmd, "glslangValidator.exe -V100 %s-e %s -S %s -o %s %s", targetEnv, entryFunc, getGLSLangValidatorShaderStage(shaderStageType), outFileName, inFileName);
 
 	if (executeCommand(cmd, "shaderCompilers/glsl/"))
 	{
-		bool result = fromSPIRVFile(device, "shaderCompilers/glsl/out.shader", shaderStageType, entryFunc);
+		bool result = fromSPIRVFile(device, outFilePath.c_str(), shaderStageType, entryFunc);
 		cleanEnv();
 		return result;
 	}
@@ -59,6 +131,9 @@ bool ShaderStage::fromSPIRVSource(VkDevice device, const char* src, uint32_t len
 
 	m_entryFunction = entryFunc;
 	m_shaderType = shaderStageType;
+	m_codeHash = hashBytes(src, len);
+	m_codeHash = hashBytes(m_entryFunction.c_str(), m_entryFunction.size(), m_codeHash);
+	m_codeHash = hashValue(m_shaderType, m_codeHash);
 	
 	return result == VK_SUCCESS;
 }
@@ -71,10 +146,22 @@ bool ShaderStage::fromHLSLFile(VkDevice device, const char * hlslShaderFile, VkS
 
 bool ShaderStage::fromGLSLFile(VkDevice device, const char * glslShaderFile, VkShaderStageFlagBits shaderStageType, const char * entryFunc)
 {
-	std::string glslShaderSrc = convertFileToString(glslShaderFile);
+	std::string glslShaderSrc = readGLSLFile(glslShaderFile);
 	return fromGLSLSource(device, glslShaderSrc.c_str(), static_cast<uint32_t>(glslShaderSrc.size()), shaderStageType, entryFunc);
 }
 
+bool ShaderStage::fromGLSLSource(VkDevice device, const char* src, uint32_t len, VkShaderStageFlagBits shaderStageType, const char* entryFunc, const ShaderDefines& defines)
+{
+	std::string variantSrc = defines.applyTo(src, len);
+	return fromGLSLSource(device, variantSrc.c_str(), static_cast<uint32_t>(variantSrc.size()), shaderStageType, entryFunc);
+}
+
+bool ShaderStage::fromGLSLFile(VkDevice device, const char* glslShaderFile, VkShaderStageFlagBits shaderStageType, const char* entryFunc, const ShaderDefines& defines)
+{
+	std::string glslShaderSrc = readGLSLFile(glslShaderFile);
+	return fromGLSLSource(device, glslShaderSrc.c_str(), static_cast<uint32_t>(glslShaderSrc.size()), shaderStageType, entryFunc, defines);
+}
+
 bool ShaderStage::fromSPIRVFile(VkDevice device, const char * spirvShaderFile, VkShaderStageFlagBits shaderStageType, const char* entryFunc)
 {
 	std::string spirvShaderSrc = convertFileToString(spirvShaderFile);
@@ -96,6 +183,21 @@ const char* ShaderStage::getEntryFuncName() const
 	return m_entryFunction.c_str();
 }
 
+uint64_t ShaderStage::getCodeHash() const
+{
+	return m_codeHash;
+}
+
+void ShaderStage::setGLSLTargetApiVersion(uint32_t apiVersion)
+{
+	s_glslTargetApiVersion = apiVersion;
+}
+
+void ShaderStage::destroy(VkDevice device)
+{
+	clear(device);
+}
+
 void ShaderStage::clear(VkDevice device)
 {
 	if (m_shaderModule != VK_NULL_HANDLE)
@@ -104,6 +206,56 @@ void ShaderStage::clear(VkDevice device)
 	}
 	m_shaderModule  = VK_NULL_HANDLE;
 	m_entryFunction = "";
+	m_codeHash      = 0;
+}
+
+std::string ShaderStage::readGLSLFile(const std::string& path, uint32_t depth)
+{
+	// Deep enough for any real nesting, stops includes which include themselves.
+	static const uint32_t MaxIncludeDepth = 16;
+
+	std::string source = convertFileToString(path);
+	if (depth >= MaxIncludeDepth)
+	{
+		std::cout << "[ERROR] Includes nested too deep in " << path << std::endl;
+		return source;
+	}
+
+	size_t slash = path.find_last_of("/\\");
+	std::string directory = slash != std::string::npos ? path.substr(0, slash + 1) : std::string();
+
+	std::string result;
+	uint32_t lineNumber = 0;
+	for (size_t lineBegin = 0; lineBegin < source.size();)
+	{
+		size_t lineEnd = source.find('\n', lineBegin);
+		lineEnd = lineEnd != std::string::npos ? lineEnd + 1 : source.size();
+		std::string line = source.substr(lineBegin, lineEnd - lineBegin);
+		lineBegin = lineEnd;
+		lineNumber++;
+
+		size_t directive = line.find_first_not_of(" \t");
+		size_t nameBegin = directive != std::string::npos && line.compare(directive, 8, "#include") == 0 ? line.find('"', directive) : std::string::npos;
+		size_t nameEnd   = nameBegin != std::string::npos ? line.find('"', nameBegin + 1) : std::string::npos;
+		if (nameEnd == std::string::npos)
+		{
+			result += line;
+			continue;
+		}
+
+		const std::string includePath = directory + line.substr(nameBegin + 1, nameEnd - nameBegin - 1);
+		std::string included = readGLSLFile(includePath, depth + 1);
+		if (included.empty())
+			std::cout << "[ERROR] Cannot read " << includePath << ", included by " << path << std::endl;
+
+		// Compiler errors keep pointing at the lines of the file they are in.
+		result += "#line 1\n";
+		result += included;
+		if (!included.empty() && included.back() != '\n')
+			result += "\n";
+		result += "#line " + std::to_string(lineNumber + 1) + "\n";
+	}
+	return result;
 }
 
 const char * ShaderStage::getGLSLangValidatorShaderStage(VkShaderStageFlagBits shaderStage)
@@ -1,8 +1,29 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
+#include <map>
 #include <string>
 
+// Preprocessor defines selecting a shader permutation. Features are switched with #if in the shader
+// instead of runtime uniforms, so every variant only pays for what it uses.
+class ShaderDefines
+{
+public:
+	ShaderDefines& set(const std::string& name, bool value);
+	ShaderDefines& set(const std::string& name, int value);
+
+	bool        empty() const;
+
+	// Canonical "NAME=VALUE;..." string, sorted by name. Equal sets give equal keys.
+	std::string getKey() const;
+
+	// Returns the source with the #define lines inserted right after the #version directive.
+	std::string applyTo(const char* src, uint32_t len) const;
+
+private:
+	std::map<std::string, std::string> m_defines;
+};
+
 class ShaderStage
 {
 public:
@@ -14,19 +35,41 @@ public:
 	bool fromSPIRVSource(VkDevice device, const char* src, uint32_t len, VkShaderStageFlagBits shaderStageType, const char* entryFunc);
 
 	bool fromHLSLFile (VkDevice device, const char* path, VkShaderStageFlagBits shaderStageType, const char* entryFunc);
+	// GLSL files may share code with #include "file", relative to the including file.
 	bool fromGLSLFile (VkDevice device, const char* path, VkShaderStageFlagBits shaderStageType, const char* entryFunc);
 	bool fromSPIRVFile(VkDevice device, const char* path, VkShaderStageFlagBits shaderStageType, const char* entryFunc);
 
+	// Compiles the permutation of the GLSL shader selected by the defines.
+	bool fromGLSLSource(VkDevice device, const char* src, uint32_t len, VkShaderStageFlagBits shaderStageType, const char* entryFunc, const ShaderDefines& defines);
+	bool fromGLSLFile  (VkDevice device, const char* path, VkShaderStageFlagBits shaderStageType, const char* entryFunc, const ShaderDefines& defines);
+
+	// Destroys the shader module. Pipelines created from it stay valid.
+	void destroy(VkDevice device);
+
 	VkShaderModule        getVkShaderModule() const;
 	VkShaderStageFlagBits getVkShaderType() const;
 	const char*           getEntryFuncName() const;
 
+	// Hash of the SPIR-V code, entry function and stage. Equal hashes mean interchangeable modules.
+	uint64_t              getCodeHash() const;
+
+	// Vulkan version GLSL is compiled for, VK_API_VERSION_1_0 by default. 1.1 produces SPIR-V 1.3,
+	// which subgroup operations need. Set once after the device is created.
+	static void           setGLSLTargetApiVersion(uint32_t apiVersion);
+
 private:
 	void clear(VkDevice device);
 
+	// The file with its #include lines replaced by the included files. glslangValidator compiles a copy
+	// of the source in another directory, it would not find them.
+	static std::string readGLSLFile(const std::string& path, uint32_t depth = 0);
+
 	const char* getGLSLangValidatorShaderStage(VkShaderStageFlagBits shaderStage);
 
 	VkShaderModule            m_shaderModule  = VK_NULL_HANDLE;
 	VkShaderStageFlagBits     m_shaderType    = VK_SHADER_STAGE_FLAG_BITS_MAX_ENUM;
 	std::string               m_entryFunction = "";
+	uint64_t                  m_codeHash      = 0;
+
+	static uint32_t           s_glslTargetApiVersion;
 };
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include "ShaderVariantCache.h"
+
+#include <iostream>
+
+ShaderVariantCache::ShaderVariantCache(VkDevice device): m_device(device)
+{
+}
+
+ShaderVariantCache::~ShaderVariantCache()
+{
+	clear();
+}
+
+bool ShaderVariantCache::getVariant(const char* path, VkShaderStageFlagBits shaderStageType, const char* entryFunc, const ShaderDefines& defines, ShaderStage& variant)
+{
+	const std::string key = getVariantKey(path, shaderStageType, entryFunc, defines);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_variants.find(key);
+		if (it != m_variants.end())
+		{
+			variant = it->second;
+			return true;
+		}
+	}
+
+	// Compile without holding the lock, glslangValidator runs as a separate process.
+	ShaderStage compiled;
+	if (!compiled.fromGLSLFile(m_device, path, shaderStageType, entryFunc, defines))
+	{
+		std::cout << "[ERROR] Failed to compile shader variant " << key << std::endl;
+		compiled.destroy(m_device);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto inserted = m_variants.emplace(key, compiled);
+	if (!inserted.second)
+	{
+		// Another thread compiled the same variant meanwhile.
+		compiled.destroy(m_device);
+	}
+
+	variant = inserted.first->second;
+	return true;
+}
+
+void ShaderVariantCache::clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto& variant : m_variants)
+		variant.second.destroy(m_device);
+	m_variants.clear();
+}
+
+uint32_t ShaderVariantCache::getNumVariants() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return static_cast<uint32_t>(m_variants.size());
+}
+
+std::string ShaderVariantCache::getVariantKey(const char* path, VkShaderStageFlagBits shaderStageType, const char* entryFunc, const ShaderDefines& defines)
+{
+	return std::string(path) + "|" + std::to_string(static_cast<uint32_t>(shaderStageType)) + "|" + entryFunc + "|" + defines.getKey();
+}
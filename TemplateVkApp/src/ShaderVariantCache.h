@@ -0,0 +1,35 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <vulkan/vulkan.h>
+
+#include "Shader.h"
+
+// Compiles permutations of GLSL shaders on first use and keeps them, keyed by file, stage, entry
+// function and defines. Thread safe, so it can be used from the asynchronous pipeline compiler.
+class ShaderVariantCache
+{
+public:
+	ShaderVariantCache(VkDevice device);
+	~ShaderVariantCache();
+
+	// Returns false if the variant failed to compile. Failed variants are not cached, so a fixed
+	// shader file is picked up by the next request.
+	bool getVariant(const char* path, VkShaderStageFlagBits shaderStageType, const char* entryFunc, const ShaderDefines& defines, ShaderStage& variant);
+
+	// Destroys all cached shader modules. Pipelines created from them stay valid.
+	void clear();
+
+	uint32_t getNumVariants() const;
+
+private:
+	static std::string getVariantKey(const char* path, VkShaderStageFlagBits shaderStageType, const char* entryFunc, const ShaderDefines& defines);
+
+	VkDevice           m_device;
+	mutable std::mutex m_mutex;
+
+	std::unordered_map<std::string, ShaderStage> m_variants;
+};
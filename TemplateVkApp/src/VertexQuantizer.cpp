@@ -0,0 +1,197 @@
+#include "VertexQuantizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const uint32_t PositionSize = 4 * sizeof(uint16_t);
+
+static uint16_t quantizeUnorm16(float value)
+{
+	value = (std::min)((std::max)(value, 0.0f), 1.0f);
+	return static_cast<uint16_t>(value * 65535.0f + 0.5f);
+}
+
+// SNORM values map -max to -1 as well as -max-1, so the most negative value is never written.
+template <typename T, int MaxValue>
+static T quantizeSnorm(float value)
+{
+	value = (std::min)((std::max)(value, -1.0f), 1.0f);
+	return static_cast<T>(std::floor(value * MaxValue + 0.5f));
+}
+
+template <typename T, int MaxValue>
+static float dequantizeSnorm(T value)
+{
+	return (std::max)(static_cast<float>(value) / MaxValue, -1.0f);
+}
+
+VertexQuantizer::VertexQuantizer(const AABB& bounds, NormalEncoding normalEncoding):
+	m_normalEncoding(normalEncoding)
+{
+	m_positionOffset = glm::vec3(bounds.min[0], bounds.min[1], bounds.min[2]);
+	m_positionScale  = glm::vec3(bounds.max[0], bounds.max[1], bounds.max[2]) - m_positionOffset;
+
+	// Flat boxes would divide by zero, any scale reproduces their single coordinate.
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (!(m_positionScale[axis] > 0.0f))
+			m_positionScale[axis] = 1.0f;
+	}
+}
+
+uint32_t VertexQuantizer::getVertexSize() const
+{
+	return m_normalEncoding == NormalOct16 ? PositionSize + 2 * sizeof(int16_t) : 3 * sizeof(uint16_t) + 2 * sizeof(int8_t);
+}
+
+const glm::vec3& VertexQuantizer::getPositionScale() const
+{
+	return m_positionScale;
+}
+
+const glm::vec3& VertexQuantizer::getPositionOffset() const
+{
+	return m_positionOffset;
+}
+
+glm::vec2 VertexQuantizer::encodeOctahedral(const glm::vec3& normal)
+{
+	float l1 = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	if (l1 == 0.0f)
+		return glm::vec2(0.0f);
+
+	glm::vec2 p = glm::vec2(normal.x, normal.y) / l1;
+
+	// The lower half is folded over the diagonals.
+	if (normal.z < 0.0f)
+	{
+		glm::vec2 folded = glm::vec2(1.0f - std::abs(p.y), 1.0f - std::abs(p.x));
+		p.x = p.x >= 0.0f ? folded.x : -folded.x;
+		p.y = p.y >= 0.0f ? folded.y : -folded.y;
+	}
+
+	return p;
+}
+
+glm::vec3 VertexQuantizer::decodeOctahedral(const glm::vec2& encoded)
+{
+	glm::vec3 n = glm::vec3(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+
+	float t = (std::max)(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+
+	return glm::normalize(n);
+}
+
+std::vector<uint8_t> VertexQuantizer::quantize(const std::vector<MeshLoader::Vertex>& vertices) const
+{
+	uint32_t vertexSize = getVertexSize();
+	std::vector<uint8_t> quantizedVertices(vertices.size() * vertexSize, 0);
+
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		uint8_t* quantizedVertex = quantizedVertices.data() + i * vertexSize;
+
+		glm::vec3 unit = (vertices[i].position - m_positionOffset) / m_positionScale;
+		uint16_t position[3] = { quantizeUnorm16(unit.x), quantizeUnorm16(unit.y), quantizeUnorm16(unit.z) };
+		memcpy(quantizedVertex, position, sizeof(position));
+
+		glm::vec2 normal = encodeOctahedral(vertices[i].normal);
+		if (m_normalEncoding == NormalOct16)
+		{
+			int16_t encoded[2] = { quantizeSnorm<int16_t, 32767>(normal.x), quantizeSnorm<int16_t, 32767>(normal.y) };
+			memcpy(quantizedVertex + PositionSize, encoded, sizeof(encoded));
+		}
+		else
+		{
+			int8_t encoded[2] = { quantizeSnorm<int8_t, 127>(normal.x), quantizeSnorm<int8_t, 127>(normal.y) };
+			memcpy(quantizedVertex + sizeof(position), encoded, sizeof(encoded));
+		}
+	}
+
+	return quantizedVertices;
+}
+
+MeshLoader::Vertex VertexQuantizer::dequantize(const uint8_t* quantizedVertex) const
+{
+	uint16_t position[3];
+	memcpy(position, quantizedVertex, sizeof(position));
+
+	glm::vec2 normal;
+	if (m_normalEncoding == NormalOct16)
+	{
+		int16_t encoded[2];
+		memcpy(encoded, quantizedVertex + PositionSize, sizeof(encoded));
+		normal = glm::vec2(dequantizeSnorm<int16_t, 32767>(encoded[0]), dequantizeSnorm<int16_t, 32767>(encoded[1]));
+	}
+	else
+	{
+		int8_t encoded[2];
+		memcpy(encoded, quantizedVertex + sizeof(position), sizeof(encoded));
+		normal = glm::vec2(dequantizeSnorm<int8_t, 127>(encoded[0]), dequantizeSnorm<int8_t, 127>(encoded[1]));
+	}
+
+	MeshLoader::Vertex vertex;
+	vertex.position = m_positionOffset + m_positionScale * (glm::vec3(position[0], position[1], position[2]) / 65535.0f);
+	vertex.normal   = decodeOctahedral(normal);
+	return vertex;
+}
+
+VertexQuantizer::Error VertexQuantizer::measureError(const std::vector<MeshLoader::Vertex>& vertices, const std::vector<uint8_t>& quantizedVertices) const
+{
+	Error error;
+	if (vertices.empty())
+		return error;
+
+	uint32_t vertexSize = getVertexSize();
+	double   positionErrorSum = 0.0;
+	float    minNormalCos = 1.0f;
+
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		MeshLoader::Vertex decoded = dequantize(quantizedVertices.data() + i * vertexSize);
+
+		float positionError = glm::length(decoded.position - vertices[i].position);
+		error.maxPositionError = (std::max)(error.maxPositionError, positionError);
+		positionErrorSum += positionError;
+
+		// Degenerate normals have no direction to lose.
+		float length = glm::length(vertices[i].normal);
+		if (length > 0.0f)
+			minNormalCos = (std::min)(minNormalCos, glm::dot(vertices[i].normal / length, decoded.normal));
+	}
+
+	error.meanPositionError = static_cast<float>(positionErrorSum / vertices.size());
+	error.maxNormalError    = glm::degrees(std::acos((std::min)((std::max)(minNormalCos, -1.0f), 1.0f)));
+	return error;
+}
+
+std::vector<VkVertexInputAttributeDescription> VertexQuantizer::getAttributeDescriptions(uint32_t binding) const
+{
+	std::vector<VkVertexInputAttributeDescription> attribDescriptions(2);
+
+	// The fourth component is not used by the shader; with 8-bit normals it reads the normal bytes,
+	// which keeps the attribute in a format every device supports for vertex input.
+	attribDescriptions[0].binding  = binding;
+	attribDescriptions[0].location = 0;
+	attribDescriptions[0].format   = VK_FORMAT_R16G16B16A16_UNORM;
+	attribDescriptions[0].offset   = 0;
+
+	attribDescriptions[1].binding  = binding;
+	attribDescriptions[1].location = 1;
+	attribDescriptions[1].format   = m_normalEncoding == NormalOct16 ? VK_FORMAT_R16G16_SNORM : VK_FORMAT_R8G8_SNORM;
+	attribDescriptions[1].offset   = m_normalEncoding == NormalOct16 ? PositionSize : 3 * sizeof(uint16_t);
+
+	return attribDescriptions;
+}
+
+VkVertexInputBindingDescription VertexQuantizer::getBindingDescription(uint32_t binding) const
+{
+	VkVertexInputBindingDescription bindingDescription{};
+	bindingDescription.binding   = binding;
+	bindingDescription.stride    = getVertexSize();
+	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	return bindingDescription;
+}
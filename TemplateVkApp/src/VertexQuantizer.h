@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include "AABB.h"
+#include "MeshLoader.h"
+
+// Compresses MeshLoader vertices (24 bytes of floats) for the vertex input stage.
+//
+// Positions are stored as 16-bit UNORM values relative to the mesh box, so the error is at most half
+// a step of box extent / 65535 per axis; the dequantization (scale and offset) is applied in the
+// vertex shader. Normals are octahedral encoded: the unit sphere is mapped onto an octahedron and
+// unfolded into a square, two SNORM values per normal.
+//
+//   NormalOct16: position R16G16B16A16_UNORM (w unused), normal R16G16_SNORM, 12 bytes per vertex
+//   NormalOct8:  position R16G16B16A16_UNORM (w overlaps the normal), normal R8G8_SNORM, 8 bytes
+//
+// The quantized vertices are drawn by the QUANTIZED_VERTICES variant of ply.vert.
+class VertexQuantizer
+{
+public:
+	enum NormalEncoding
+	{
+		NormalOct16,
+		NormalOct8
+	};
+
+	// Maximum and mean distance between the original and the dequantized positions, and the largest
+	// angle in degrees between the original and the decoded normals.
+	struct Error
+	{
+		float maxPositionError  = 0.0f;
+		float meanPositionError = 0.0f;
+		float maxNormalError    = 0.0f;
+	};
+
+	VertexQuantizer(const AABB& bounds, NormalEncoding normalEncoding);
+
+	uint32_t getVertexSize() const;
+
+	// Quantized vertices, getVertexSize() bytes each.
+	std::vector<uint8_t> quantize(const std::vector<MeshLoader::Vertex>& vertices) const;
+	MeshLoader::Vertex   dequantize(const uint8_t* quantizedVertex) const;
+
+	Error measureError(const std::vector<MeshLoader::Vertex>& vertices, const std::vector<uint8_t>& quantizedVertices) const;
+
+	// position = positionOffset + positionScale * unorm position
+	const glm::vec3& getPositionScale() const;
+	const glm::vec3& getPositionOffset() const;
+
+	// Attributes at locations 0 (position) and 1 (normal) of the given binding.
+	std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(uint32_t binding) const;
+	VkVertexInputBindingDescription                getBindingDescription(uint32_t binding) const;
+
+	// Octahedral mapping of a unit vector to [-1, 1]^2 and back.
+	static glm::vec2 encodeOctahedral(const glm::vec3& normal);
+	static glm::vec3 decodeOctahedral(const glm::vec2& encoded);
+
+private:
+	NormalEncoding m_normalEncoding;
+	glm::vec3      m_positionScale;
+	glm::vec3      m_positionOffset;
+};
@@ -0,0 +1,311 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "helper.h"
+
+// Joins the duplicates of a vertex array. After weld(), getRemap()[i] is the welded index of input
+// vertex i and getUniques()[w] the first input vertex of welded vertex w. Welded vertices are
+// numbered in the order of their first occurrence, like a map filled in input order would.
+//
+// Keys are structs without padding which are hashed and compared bytewise, so -0.0f and 0.0f differ.
+// The table is open addressing with linear probing over key indices. Each slot also keeps the hash,
+// so most probes are decided without touching the keys.
+//
+// The build is sharded by the top bits of the hash. Each thread owns the keys of one shard in a
+// table of its own and writes only their remap entries, so it takes no locks. Vertices of a shard
+// are inserted in input order, so the result does not depend on the number of threads.
+template<typename Key>
+class VertexWelder
+{
+	static_assert(std::is_trivially_copyable<Key>::value, "Keys are compared bytewise");
+	static_assert(sizeof(Key) % sizeof(uint32_t) == 0, "Keys are hashed in 32-bit words");
+
+public:
+	// The smallest range of keys hashed or inserted on a thread of its own.
+	static const size_t MinKeysPerThread = 64 * 1024;
+
+	// 0 threads uses every hardware thread.
+	explicit VertexWelder(uint32_t nThreads = 0) :
+		m_nThreads(nThreads != 0 ? nThreads : (std::max)(1u, std::thread::hardware_concurrency()))
+	{
+	}
+
+	// Joins bytewise identical keys. Returns the number of welded vertices.
+	uint32_t weld(const Key* keys, size_t count)
+	{
+		m_hashes.resize(count);
+		parallelForRanges(count, getRangeCount(count), [this, keys](uint32_t, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+				m_hashes[i] = hashKey(keys[i]);
+		});
+
+		buildShards(count, [keys](uint32_t a, uint32_t b) { return std::memcmp(&keys[a], &keys[b], sizeof(Key)) == 0; });
+		return renumber();
+	}
+
+	// Joins keys whose positions are at most tolerance apart and which match bytewise otherwise. A
+	// vertex joins the first earlier welded vertex in range, or starts a new one. Positions are sorted
+	// into grid cells of size tolerance, so only the 27 cells around a vertex are searched. The cells
+	// are built in parallel like weld(), the search runs in input order on the calling thread.
+	uint32_t weld(const Key* keys, size_t count, glm::vec3 Key::* position, float tolerance)
+	{
+		if (!(tolerance > 0.0f))
+			return weld(keys, count);
+
+		// The key without its position, hashed into the cell hash.
+		std::vector<uint64_t> attributeHashes(count);
+		std::vector<glm::ivec3> cells(count);
+		parallelForRanges(count, getRangeCount(count), [&](uint32_t, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				Key attributes = keys[i];
+				attributes.*position = glm::vec3(0.0f);
+				attributeHashes[i] = hashKey(attributes);
+				cells[i] = glm::ivec3(glm::floor(keys[i].*position / tolerance));
+			}
+		});
+
+		// Cells hold the vertices with the same attributes, the neighbours are looked up by hash.
+		m_hashes.resize(count);
+		parallelForRanges(count, getRangeCount(count), [&](uint32_t, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+				m_hashes[i] = hashKey(cells[i], attributeHashes[i]);
+		});
+		auto sameCell = [&](uint32_t a, uint32_t b)
+		{
+			return cells[a] == cells[b] && attributeHashes[a] == attributeHashes[b] && sameAttributes(keys[a], keys[b], position);
+		};
+		buildShards(count, sameCell);
+
+		// Vertices per cell in input order. A cell is named by its first vertex.
+		std::vector<uint32_t> cellOffsets(count + 1, 0);
+		for (size_t i = 0; i < count; i++)
+			cellOffsets[m_remap[i] + 1]++;
+		for (size_t i = 0; i < count; i++)
+			cellOffsets[i + 1] += cellOffsets[i];
+		std::vector<uint32_t> cellVertices(count);
+		std::vector<uint32_t> fill(cellOffsets.begin(), cellOffsets.end() - 1);
+		for (size_t i = 0; i < count; i++)
+			cellVertices[fill[m_remap[i]]++] = static_cast<uint32_t>(i);
+
+		std::vector<uint32_t> welded(count);
+		const float toleranceSquared = tolerance * tolerance;
+		for (size_t i = 0; i < count; i++)
+		{
+			uint32_t target = static_cast<uint32_t>(i);
+			for (int z = -1; z <= 1; z++)
+			for (int y = -1; y <= 1; y++)
+			for (int x = -1; x <= 1; x++)
+			{
+				glm::ivec3 cell = cells[i] + glm::ivec3(x, y, z);
+				uint32_t first = findShard(hashKey(cell, attributeHashes[i]), [&](uint32_t other)
+				{
+					return cells[other] == cell && attributeHashes[other] == attributeHashes[i] && sameAttributes(keys[other], keys[i], position);
+				});
+				if (first == Empty)
+					continue;
+
+				// Earlier vertices which started a welded vertex, closest to the front first.
+				for (uint32_t c = cellOffsets[first]; c < cellOffsets[first + 1] && cellVertices[c] < target; c++)
+				{
+					uint32_t other = cellVertices[c];
+					glm::vec3 d = keys[other].*position - keys[i].*position;
+					if (welded[other] == other && glm::dot(d, d) <= toleranceSquared)
+					{
+						target = other;
+						break;
+					}
+				}
+			}
+			welded[i] = target;
+		}
+
+		m_remap.swap(welded);
+		return renumber();
+	}
+
+	const std::vector<uint32_t>& getRemap() const
+	{
+		return m_remap;
+	}
+
+	const std::vector<uint32_t>& getUniques() const
+	{
+		return m_uniques;
+	}
+
+private:
+	static const uint32_t Empty = ~0u;
+
+	struct Slot
+	{
+		uint64_t hash;
+		uint32_t key;
+	};
+
+	template<typename T>
+	static uint64_t hashKey(const T& value, uint64_t seed = 0x9E3779B97F4A7C15ull)
+	{
+		uint32_t words[sizeof(T) / sizeof(uint32_t)];
+		std::memcpy(words, &value, sizeof(T));
+
+		// Multiply and shift per word and a final avalanche, the shard and slot bits both depend on
+		// every input bit.
+		uint64_t hash = seed;
+		for (uint32_t word : words)
+		{
+			hash = (hash ^ word) * 0xFF51AFD7ED558CCDull;
+			hash ^= hash >> 32;
+		}
+		hash ^= hash >> 33;
+		hash *= 0xC4CEB9FE1A85EC53ull;
+		hash ^= hash >> 33;
+		return hash;
+	}
+
+	static bool sameAttributes(const Key& a, const Key& b, glm::vec3 Key::* position)
+	{
+		Key attributesA = a;
+		Key attributesB = b;
+		attributesA.*position = glm::vec3(0.0f);
+		attributesB.*position = glm::vec3(0.0f);
+		return std::memcmp(&attributesA, &attributesB, sizeof(Key)) == 0;
+	}
+
+	uint32_t getShard(uint64_t hash) const
+	{
+		return m_shardBits == 0 ? 0 : static_cast<uint32_t>(hash >> (64 - m_shardBits));
+	}
+
+	// Like getParallelRangeCount(), but with the thread count of the welder.
+	uint32_t getRangeCount(size_t count) const
+	{
+		return static_cast<uint32_t>((std::min)(static_cast<size_t>(m_nThreads), (std::max)(size_t(1), count / MinKeysPerThread)));
+	}
+
+	// Fills one table per shard with the first key of every group of equal keys and sets m_remap to
+	// the first key of the group of each key.
+	template<typename Equal>
+	void buildShards(size_t count, Equal equal)
+	{
+		m_remap.resize(count);
+
+		// A power of two of shards, at least one per thread.
+		uint32_t nRanges = getRangeCount(count);
+		m_shardBits = 0;
+		while ((size_t(1) << m_shardBits) < nRanges)
+			m_shardBits++;
+		const size_t nShards = size_t(1) << m_shardBits;
+
+		// The keys bucketed by shard in input order. Each range of keys counts its keys per shard, the
+		// prefix sum over shards, then ranges gives every range the place of its keys in each bucket.
+		std::vector<size_t> offsets(nShards * nRanges + 1, 0);
+		parallelForRanges(count, nRanges, [&](uint32_t range, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+				offsets[getShard(m_hashes[i]) * nRanges + range + 1]++;
+		});
+		for (size_t i = 0; i < nShards * nRanges; i++)
+			offsets[i + 1] += offsets[i];
+
+		std::vector<uint32_t> buckets(count);
+		std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+		parallelForRanges(count, nRanges, [&](uint32_t range, size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+				buckets[fill[getShard(m_hashes[i]) * nRanges + range]++] = static_cast<uint32_t>(i);
+		});
+
+		m_shards.assign(nShards, std::vector<Slot>());
+		parallelForRanges(nShards, nRanges, [&](uint32_t, size_t begin, size_t end)
+		{
+			for (size_t shard = begin; shard < end; shard++)
+			{
+				const size_t first = offsets[shard * nRanges];
+				const size_t last  = offsets[(shard + 1) * nRanges];
+
+				// At most half full.
+				size_t capacity = 16;
+				while (capacity < (last - first) * 2)
+					capacity *= 2;
+
+				std::vector<Slot>& slots = m_shards[shard];
+				slots.assign(capacity, Slot{ 0, Empty });
+				for (size_t b = first; b < last; b++)
+				{
+					uint32_t i = buckets[b];
+					uint64_t hash = m_hashes[i];
+					for (size_t s = hash & (capacity - 1);; s = (s + 1) & (capacity - 1))
+					{
+						Slot& slot = slots[s];
+						if (slot.key == Empty)
+						{
+							slot = { hash, i };
+							m_remap[i] = i;
+							break;
+						}
+						if (slot.hash == hash && equal(slot.key, i))
+						{
+							m_remap[i] = slot.key;
+							break;
+						}
+					}
+				}
+			}
+		});
+	}
+
+	// The first key equal to the one with this hash, or Empty.
+	template<typename Match>
+	uint32_t findShard(uint64_t hash, Match match) const
+	{
+		const std::vector<Slot>& slots = m_shards[getShard(hash)];
+		size_t mask = slots.size() - 1;
+		for (size_t s = hash & mask;; s = (s + 1) & mask)
+		{
+			if (slots[s].key == Empty)
+				return Empty;
+			if (slots[s].hash == hash && match(slots[s].key))
+				return slots[s].key;
+		}
+	}
+
+	// Turns the first keys in m_remap into welded indices. The first key of a group comes before the
+	// others, it is renumbered by the time they are reached.
+	uint32_t renumber()
+	{
+		m_uniques.clear();
+		for (size_t i = 0; i < m_remap.size(); i++)
+		{
+			if (m_remap[i] == i)
+			{
+				m_remap[i] = static_cast<uint32_t>(m_uniques.size());
+				m_uniques.push_back(static_cast<uint32_t>(i));
+			}
+			else
+			{
+				m_remap[i] = m_remap[m_remap[i]];
+			}
+		}
+		return static_cast<uint32_t>(m_uniques.size());
+	}
+
+	uint32_t                       m_nThreads;
+	uint32_t                       m_shardBits = 0;
+	std::vector<uint64_t>          m_hashes;
+	std::vector<std::vector<Slot>> m_shards;
+	std::vector<uint32_t>          m_remap;
+	std::vector<uint32_t>          m_uniques;
+};
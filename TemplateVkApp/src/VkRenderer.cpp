@@ -7,6 +7,7 @@
 #include <vector>
 #include <sstream>
 #include <array>
+#include <string.h>
 
 
 
@@ -19,12 +20,12 @@ VkRenderer::~VkRenderer()
 {
 }
 
-void VkRenderer::init(const char* applicationName, const std::vector<const char*>& instanceExtensions, const std::vector<const char*>& deviceExtensions)
+void VkRenderer::init(const char* applicationName, const std::vector<const char*>& instanceExtensions, const std::vector<const char*>& deviceExtensions, const std::vector<const char*>& optionalDeviceExtensions)
 {
 	setupDebug(instanceExtensions);
 	initInstance(applicationName);
 	initDebug();
-	initDevice(deviceExtensions);
+	initDevice(deviceExtensions, optionalDeviceExtensions);
 }
 
 void VkRenderer::createWindowSurface(GLFWwindow * windowPtr)
@@ -141,6 +142,36 @@ const VkRenderPass & VkRenderer::getVkRenderPass() const
 	return vkRenderPass;
 }
 
+VkFormat VkRenderer::getVkSurfaceFormat() const
+{
+	return vkSurfaceFormat.format;
+}
+
+VkFormat VkRenderer::getVkDepthStencilFormat() const
+{
+	return vkDepthStencilFormat;
+}
+
+VkImage VkRenderer::getVkDepthStencilImage() const
+{
+	return vkDepthStencilImage;
+}
+
+VkImageView VkRenderer::getVkDepthSampledImageView() const
+{
+	return vkDepthSampledImageView;
+}
+
+VkImageAspectFlags VkRenderer::getVkDepthStencilAspectMask() const
+{
+	return VK_IMAGE_ASPECT_DEPTH_BIT | (vkStencilBufferAvailable ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+}
+
+bool VkRenderer::isDepthSampleable() const
+{
+	return vkDepthSampleable;
+}
+
 const VkFramebuffer & VkRenderer::getVkActiveFrameBuffer() const
 {
 	return vkFrameBuffer[vkActiveSwapChainID];
@@ -148,9 +179,18 @@ const VkFramebuffer & VkRenderer::getVkActiveFrameBuffer() const
 
 void VkRenderer::initInstance(const char* applicationName)
 {
+	// Vulkan 1.1 is used when the loader has it, for subgroup operations. vkEnumerateInstanceVersion
+	// does not exist in 1.0 loaders.
+	vkInstanceApiVersion = VK_MAKE_VERSION(1, 0, 21);
+	auto enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(
+		vkGetInstanceProcAddr(VK_NULL_HANDLE, "vkEnumerateInstanceVersion"));
+	uint32_t loaderApiVersion = 0;
+	if (enumerateInstanceVersion && enumerateInstanceVersion(&loaderApiVersion) == VK_SUCCESS && loaderApiVersion >= VK_API_VERSION_1_1)
+		vkInstanceApiVersion = VK_API_VERSION_1_1;
+
 	VkApplicationInfo applicationInfo{};
 	applicationInfo.sType      = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-	applicationInfo.apiVersion = VK_MAKE_VERSION(1, 0, 21);
+	applicationInfo.apiVersion = vkInstanceApiVersion;
 	applicationInfo.applicationVersion = VK_MAKE_VERSION(0, 1, 0);
 	applicationInfo.pApplicationName = applicationName;
 
@@ -211,7 +251,7 @@ std::string getAPIVersionString(uint32_t apiVersion){
 	return apiVersionString.str();
 }
 
-void VkRenderer::initDevice(const std::vector<const char*>& deviceExtensions)
+void VkRenderer::initDevice(const std::vector<const char*>& requiredDeviceExtensions, const std::vector<const char*>& optionalDeviceExtensions)
 {
 	// ========================================
 	// Physical Devices extraction
@@ -229,6 +269,25 @@ void VkRenderer::initDevice(const std::vector<const char*>& deviceExtensions)
 	std::cout << "Device Name = " << vkGPUProperties.deviceName << std::endl;
 	std::cout << "Device Type = " << getDeviceTypeString(vkGPUProperties.deviceType) << std::endl;
 	std::cout << "Device API version = " << getAPIVersionString(vkGPUProperties.apiVersion) << std::endl;
+
+	// ========================================
+	// Subgroup Properties (Vulkan 1.1)
+	// ========================================
+	vkApiVersion = VK_API_VERSION_1_0;
+	vkSubgroupProperties = VkPhysicalDeviceSubgroupProperties{};
+	vkSubgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+	auto getPhysicalDeviceProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2>(
+		vkGetInstanceProcAddr(vkInstance, "vkGetPhysicalDeviceProperties2"));
+	if (vkInstanceApiVersion >= VK_API_VERSION_1_1 && vkGPUProperties.apiVersion >= VK_API_VERSION_1_1 && getPhysicalDeviceProperties2) {
+		VkPhysicalDeviceProperties2 properties2{};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &vkSubgroupProperties;
+		getPhysicalDeviceProperties2(vkGPU, &properties2);
+
+		vkApiVersion = VK_API_VERSION_1_1;
+		std::cout << "Subgroup size = " << vkSubgroupProperties.subgroupSize << std::endl;
+	}
 	
 	// =============================================
 	// Physical Device Memory Properties extraction
@@ -279,6 +338,53 @@ void VkRenderer::initDevice(const std::vector<const char*>& deviceExtensions)
 	}
 	std::cout << std::endl;*/
 
+	// ========================================
+	// Device Extensions
+	// ========================================
+	uint32_t deviceExtensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(vkGPU, nullptr, &deviceExtensionCount, nullptr);
+	std::vector<VkExtensionProperties> deviceExtensionPropertyList(deviceExtensionCount);
+	vkEnumerateDeviceExtensionProperties(vkGPU, nullptr, &deviceExtensionCount, deviceExtensionPropertyList.data());
+
+	std::vector<const char*> deviceExtensions = requiredDeviceExtensions;
+	for (auto optionalExtension : optionalDeviceExtensions) {
+		for (auto& extensionProperties : deviceExtensionPropertyList) {
+			if (strcmp(optionalExtension, extensionProperties.extensionName) == 0) {
+				deviceExtensions.push_back(optionalExtension);
+				break;
+			}
+		}
+	}
+	vkEnabledDeviceExtensions.assign(deviceExtensions.begin(), deviceExtensions.end());
+
+	// ========================================
+	// Device Features
+	// ========================================
+	// Only features which are used somewhere are enabled, and only if they are supported.
+	VkPhysicalDeviceFeatures supportedFeatures{};
+	vkGetPhysicalDeviceFeatures(vkGPU, &supportedFeatures);
+	vkEnabledFeatures = VkPhysicalDeviceFeatures{};
+	vkEnabledFeatures.multiDrawIndirect         = supportedFeatures.multiDrawIndirect;
+	vkEnabledFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+	vkEnabledFeatures.shaderInt64               = supportedFeatures.shaderInt64;
+
+	// 64-bit atomics on storage buffers (VK_KHR_shader_atomic_int64), queried through the
+	// Vulkan 1.1 features chain.
+	vkAtomicInt64Features = VkPhysicalDeviceShaderAtomicInt64FeaturesKHR{};
+	vkAtomicInt64Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_ATOMIC_INT64_FEATURES_KHR;
+
+	auto getPhysicalDeviceFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2>(
+		vkGetInstanceProcAddr(vkInstance, "vkGetPhysicalDeviceFeatures2"));
+	if (vkApiVersion >= VK_API_VERSION_1_1 && getPhysicalDeviceFeatures2 && isDeviceExtensionEnabled(VK_KHR_SHADER_ATOMIC_INT64_EXTENSION_NAME)) {
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &vkAtomicInt64Features;
+		getPhysicalDeviceFeatures2(vkGPU, &features2);
+
+		// Shared memory atomics are not used.
+		vkAtomicInt64Features.shaderSharedInt64Atomics = VK_FALSE;
+	}
+
 	// ========================================
 	// Queue Create Information
 	// ========================================
@@ -294,10 +400,12 @@ void VkRenderer::initDevice(const std::vector<const char*>& deviceExtensions)
 	// ========================================
 	VkDeviceCreateInfo deviceCreateInfo{};
 	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	deviceCreateInfo.pNext = vkAtomicInt64Features.shaderBufferInt64Atomics ? &vkAtomicInt64Features : nullptr;
 	deviceCreateInfo.queueCreateInfoCount		= 1;
 	deviceCreateInfo.pQueueCreateInfos			= &deviceQueueCreateInfo;
 	deviceCreateInfo.enabledExtensionCount		= static_cast<uint32_t>(deviceExtensions.size());
 	deviceCreateInfo.ppEnabledExtensionNames	= deviceExtensions.data();
+	deviceCreateInfo.pEnabledFeatures			= &vkEnabledFeatures;
 	deviceCreateInfo.enabledLayerCount			= 0;
 	deviceCreateInfo.ppEnabledLayerNames		= nullptr;
 	//deviceCreateInfo.enabledLayerCount		= static_cast<uint32_t>(vkLayerList.size());
@@ -528,6 +636,11 @@ void VkRenderer::initDepthStencilImage()
 	}
 
 
+	// Sampled depth is used for occlusion culling, see HiZPyramid.
+	VkFormatProperties depthFormatProperties{};
+	vkGetPhysicalDeviceFormatProperties(vkGPU, vkDepthStencilFormat, &depthFormatProperties);
+	vkDepthSampleable = (depthFormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+
 	if (
 		vkDepthStencilFormat == VK_FORMAT_D32_SFLOAT_S8_UINT ||
 		vkDepthStencilFormat == VK_FORMAT_D24_UNORM_S8_UINT ||
@@ -553,7 +666,7 @@ void VkRenderer::initDepthStencilImage()
 	imageCreateInfo.arrayLayers				= 1;
 	imageCreateInfo.samples					= VK_SAMPLE_COUNT_1_BIT;
 	imageCreateInfo.tiling					= VK_IMAGE_TILING_OPTIMAL;
-	imageCreateInfo.usage					= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	imageCreateInfo.usage					= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (vkDepthSampleable ? VK_IMAGE_USAGE_SAMPLED_BIT : 0);
 	imageCreateInfo.sharingMode				= VK_SHARING_MODE_EXCLUSIVE;
 	imageCreateInfo.queueFamilyIndexCount	= 1;
 	imageCreateInfo.pQueueFamilyIndices		= &queueFamilyIndex;
@@ -598,11 +711,21 @@ void VkRenderer::initDepthStencilImage()
 	imageViewCreateInfo.subresourceRange.layerCount			= 1;
 
 	vkCreateImageView(vkDevice, &imageViewCreateInfo, nullptr, &vkDepthStencilImageView);
+
+	// Views used for sampling can only have one aspect.
+	if (vkDepthSampleable) {
+		imageViewCreateInfo.subresourceRange.aspectMask		= VK_IMAGE_ASPECT_DEPTH_BIT;
+		vkCreateImageView(vkDevice, &imageViewCreateInfo, nullptr, &vkDepthSampledImageView);
+	}
 }
 
 void VkRenderer::deInitDepthStencilImage()
 {
 	vkDestroyImageView(vkDevice, vkDepthStencilImageView, nullptr);
+	if (vkDepthSampledImageView != VK_NULL_HANDLE) {
+		vkDestroyImageView(vkDevice, vkDepthSampledImageView, nullptr);
+		vkDepthSampledImageView = VK_NULL_HANDLE;
+	}
 	vkFreeMemory(vkDevice, vkDepthStencilImageMem, nullptr);
 	vkDestroyImage(vkDevice, vkDepthStencilImage, nullptr);
 }
@@ -619,7 +742,7 @@ void VkRenderer::initRenderPass()
 	attachments[0].format			= vkDepthStencilFormat;
 	attachments[0].samples			= VK_SAMPLE_COUNT_1_BIT;
 	attachments[0].loadOp			= VK_ATTACHMENT_LOAD_OP_CLEAR;
-	attachments[0].storeOp			= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[0].storeOp			= VK_ATTACHMENT_STORE_OP_STORE;		// Read after the pass to build the Hi-Z pyramid.
 	attachments[0].stencilLoadOp	= VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	attachments[0].stencilStoreOp	= VK_ATTACHMENT_STORE_OP_STORE;
 	attachments[0].initialLayout	= VK_IMAGE_LAYOUT_UNDEFINED;
@@ -728,6 +851,35 @@ uint32_t VkRenderer::getVkSurfaceHeight() const
 	return vkSurfaceHeight;
 }
 
+const VkPhysicalDeviceFeatures& VkRenderer::getVkEnabledFeatures() const
+{
+	return vkEnabledFeatures;
+}
+
+uint32_t VkRenderer::getVkApiVersion() const
+{
+	return vkApiVersion;
+}
+
+const VkPhysicalDeviceSubgroupProperties& VkRenderer::getVkSubgroupProperties() const
+{
+	return vkSubgroupProperties;
+}
+
+bool VkRenderer::isBufferInt64AtomicsEnabled() const
+{
+	return vkEnabledFeatures.shaderInt64 && vkAtomicInt64Features.shaderBufferInt64Atomics;
+}
+
+bool VkRenderer::isDeviceExtensionEnabled(const char* extensionName) const
+{
+	for (auto& extension : vkEnabledDeviceExtensions) {
+		if (extension == extensionName)
+			return true;
+	}
+	return false;
+}
+
 const BufferAllocator* VkRenderer::getBufferAllocator() const
 {
 	return m_bufferAllocatorPtr.get();
@@ -24,7 +24,8 @@ public:
 	VkRenderer();
 	~VkRenderer();
 
-	void init(const char* applicationName, const std::vector<const char*>& instanceExtensions, const std::vector<const char*>& deviceExtensions);
+	// Optional device extensions are only enabled when the device supports them, see isDeviceExtensionEnabled().
+	void init(const char* applicationName, const std::vector<const char*>& instanceExtensions, const std::vector<const char*>& deviceExtensions, const std::vector<const char*>& optionalDeviceExtensions = {});
 	void createWindowSurface(GLFWwindow* windowPtr);
 	void destroySurface();
 	void deInit();
@@ -37,9 +38,27 @@ public:
 	const uint32_t								getVkGraphicsQueueFamilyIndex()		const;
 	const VkPhysicalDeviceProperties&			getVkPhysicalDeviceProperties()		const;
 	const VkPhysicalDeviceMemoryProperties&		getVkPhysicalDeviceMemProperties()	const;
+	const VkPhysicalDeviceFeatures&				getVkEnabledFeatures()				const;
+	bool										isDeviceExtensionEnabled(const char* extensionName) const;
+
+	// VK_API_VERSION_1_1 if both the loader and the device have it, VK_API_VERSION_1_0 otherwise.
+	uint32_t									getVkApiVersion()					const;
+	// Zero unless the API version is 1.1.
+	const VkPhysicalDeviceSubgroupProperties&	getVkSubgroupProperties()			const;
+	// 64-bit integer atomics on storage buffers, needs the optional VK_KHR_shader_atomic_int64.
+	bool										isBufferInt64AtomicsEnabled()		const;
 	const VkSwapchainKHR&                       getVkSwapChain()                    const;
 
 	const VkRenderPass&                         getVkRenderPass()                   const;
+	VkFormat                                    getVkSurfaceFormat()                const;
+	VkFormat                                    getVkDepthStencilFormat()           const;
+	VkImage                                     getVkDepthStencilImage()            const;
+	VkImageAspectFlags                          getVkDepthStencilAspectMask()       const;
+
+	// The depth attachment is stored after the render pass and can be sampled if the format allows it,
+	// through a depth only view. Layout after the render pass: DEPTH_STENCIL_ATTACHMENT_OPTIMAL.
+	bool                                        isDepthSampleable()                 const;
+	VkImageView                                 getVkDepthSampledImageView()        const;
 	const VkFramebuffer&                        getVkActiveFrameBuffer()			const;
 
 	uint32_t                                    getVkSurfaceWidth()					const;
@@ -64,7 +83,7 @@ private:
 	void initInstance(const char* applicationName);
 	void deInitInstance();
 
-	void initDevice(const std::vector<const char*>& deviceExtension);
+	void initDevice(const std::vector<const char*>& deviceExtension, const std::vector<const char*>& optionalDeviceExtensions);
 	void deInitDevice();
 
 	void setupDebug(const std::vector<const char*>& requiredExtensions);
@@ -93,6 +112,12 @@ private:
 	VkPhysicalDevice					vkGPU					= VK_NULL_HANDLE;
 	VkPhysicalDeviceProperties			vkGPUProperties			= {};
 	VkPhysicalDeviceMemoryProperties    vkGPUMemProperties		= {};
+	VkPhysicalDeviceFeatures            vkEnabledFeatures		= {};
+	uint32_t                            vkInstanceApiVersion	= 0;
+	uint32_t                            vkApiVersion			= 0;
+	VkPhysicalDeviceSubgroupProperties  vkSubgroupProperties	= {};
+	VkPhysicalDeviceShaderAtomicInt64FeaturesKHR vkAtomicInt64Features = {};
+	std::vector<std::string>            vkEnabledDeviceExtensions;
 	uint32_t							vkGraphicsFamilyIndex	= 0;
 	VkQueue								vkQueue					= VK_NULL_HANDLE;
 	VkSurfaceKHR						vkSurface               = VK_NULL_HANDLE;
@@ -123,6 +148,8 @@ private:
 	VkImage								vkDepthStencilImage		= VK_NULL_HANDLE;
 	VkDeviceMemory						vkDepthStencilImageMem  = VK_NULL_HANDLE;
 	VkImageView							vkDepthStencilImageView	= VK_NULL_HANDLE;
+	bool								vkDepthSampleable		= false;
+	VkImageView							vkDepthSampledImageView	= VK_NULL_HANDLE;
 
 
 	// Layres and extensions
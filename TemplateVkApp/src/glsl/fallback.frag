@@ -0,0 +1,11 @@
+#version 430 core
+
+layout(location = 0) in vec4 worldPos;
+layout(location = 1) in vec3 worldNormal;
+
+layout(location = 0) out vec4 outColor;
+
+// Cheap stand-in used while the real material pipeline is still compiling.
+void main(){
+	outColor = vec4(0.4f, 0.7f, 0.5f, 1.0f);
+}
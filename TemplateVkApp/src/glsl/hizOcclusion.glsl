@@ -0,0 +1,57 @@
+// Occlusion test against the Hi-Z pyramid, shared by the culling shaders. Include it inside
+// #if OCCLUSION_CULLING, it takes bindings 4 and 5 of set 0.
+
+// Farthest depth per texel of the previous frame, see HiZPyramid.
+layout(set=0, binding=4) uniform sampler2D depthPyramid;
+
+layout(std140, set=0, binding=5) uniform Occlusion
+{
+    mat4 occlusionViewProj;   // the matrix the pyramid's depth was rendered with
+    vec4 pyramidSize;         // width, height of level 0, number of levels
+};
+
+// Conservative: the box around the sphere is projected, and it is occluded if its nearest depth is
+// behind the farthest depth of every pyramid texel its screen rectangle touches.
+bool isOccluded(vec3 center, float radius)
+{
+    vec2  minUV    = vec2(1.0f);
+    vec2  maxUV    = vec2(0.0f);
+    float minDepth = 1.0f;
+    for (int i = 0; i < 8; i++)
+    {
+        vec3 corner = center + radius * vec3(
+            (i & 1) != 0 ? 1.0f : -1.0f,
+            (i & 2) != 0 ? 1.0f : -1.0f,
+            (i & 4) != 0 ? 1.0f : -1.0f);
+
+        vec4 clip = occlusionViewProj * vec4(corner, 1.0f);
+        if (clip.w <= 0.0f)
+            return false;   // reaches behind the camera
+
+        vec3 ndc = clip.xyz / clip.w;
+        minUV    = min(minUV, ndc.xy * 0.5f + 0.5f);
+        maxUV    = max(maxUV, ndc.xy * 0.5f + 0.5f);
+        minDepth = min(minDepth, ndc.z);
+    }
+
+    minUV = clamp(minUV, vec2(0.0f), vec2(1.0f));
+    maxUV = clamp(maxUV, vec2(0.0f), vec2(1.0f));
+
+    // The level where the rectangle is at most one texel wide, so it touches at most 2x2 texels.
+    vec2  extent = (maxUV - minUV) * pyramidSize.xy;
+    float level  = ceil(log2(max(max(extent.x, extent.y), 1.0f)));
+    int   lod    = int(min(level, pyramidSize.z - 1.0f));
+
+    ivec2 levelSize = textureSize(depthPyramid, lod);
+    ivec2 minTexel  = clamp(ivec2(minUV * vec2(levelSize)), ivec2(0), levelSize - 1);
+    ivec2 maxTexel  = clamp(ivec2(maxUV * vec2(levelSize)), ivec2(0), levelSize - 1);
+
+    float maxDepth = 0.0f;
+    for (int y = minTexel.y; y <= maxTexel.y; y++)
+    {
+        for (int x = minTexel.x; x <= maxTexel.x; x++)
+            maxDepth = max(maxDepth, texelFetch(depthPyramid, ivec2(x, y), lod).r);
+    }
+
+    return minDepth > maxDepth;
+}
@@ -1,5 +1,14 @@
 #version 430 core
 
+// Permutation switches, set through ShaderDefines. The defaults give the shaded material.
+#ifndef SHADING_ENABLED
+#define SHADING_ENABLED 1
+#endif
+
+#ifndef NORMAL_AS_COLOR
+#define NORMAL_AS_COLOR 0
+#endif
+
 layout(std140, set=0, binding=0) uniform Transformations {
     mat4 projMatrix;
     mat4 viewMatrix;
@@ -12,14 +21,17 @@ layout(location = 1) in vec3 worldNormal;
 layout(location = 0) out vec4 outColor;
 
 void main(){
+#if NORMAL_AS_COLOR
+	vec4 color = vec4((normalize(worldNormal) + 1.0f) * 0.5f, 1.0f);
+#else
+	vec4 color = vec4(0.4f, 0.7f, 0.5f, 1.0f);
+#endif
+
+#if SHADING_ENABLED
 	vec3 diffuse_albedo  = vec3(1.0f, 1.0f, 1.0f);
 	vec3 specular_albedo = vec3(0.7f);
 	float specular_power = 128.0f; 
 
-	float shading_level = 1.0;
-
-	vec4 color = vec4(0.4f, 0.7f, 0.5f, 1.0f);
-
 	vec4 v = normalize(viewMatrix * worldPos);
 	vec3 l = normalize(vec3(1.0f, 1.0f, 1.0f));
 	vec3 n = normalize(mat3(viewMatrix) * worldNormal);
@@ -30,5 +42,8 @@ void main(){
 	vec3 diffuse_factor  = diffuse_albedo * max(dot(n,l), 0.0f);
 	vec3 specular_factor = specular_albedo * pow(max(dot(r, v.xyz), 0.0f), specular_power); 
 
-	outColor = color * mix(vec4(0.0), vec4( ambient_factor + diffuse_factor + specular_factor, 1.0), shading_level);
-}
\ No newline at end of file
+	outColor = color * vec4( ambient_factor + diffuse_factor + specular_factor, 1.0);
+#else
+	outColor = color;
+#endif
+}
@@ -1,19 +1,115 @@
 #version 430 core
 
+// Set through ShaderDefines: objects are drawn with indirect draws from the GPU culler, and the
+// object index comes in as gl_InstanceIndex.
+#ifndef OBJECT_TRANSFORMS
+#define OBJECT_TRANSFORMS 0
+#endif
+
+// Set through ShaderDefines: the vertices are fetched from storage buffers by gl_VertexIndex instead of
+// the vertex input stage. Strides and offsets are in floats, 6 and 0/3 for the interleaved vertices
+// the mesh processor writes, 3 and 0 for separate position and normal streams.
+#ifndef VERTEX_PULLING
+#define VERTEX_PULLING 0
+#endif
+
+#ifndef POSITION_STRIDE
+#define POSITION_STRIDE 6
+#endif
+
+#ifndef POSITION_OFFSET
+#define POSITION_OFFSET 0
+#endif
+
+#ifndef NORMAL_STRIDE
+#define NORMAL_STRIDE 6
+#endif
+
+#ifndef NORMAL_OFFSET
+#define NORMAL_OFFSET 3
+#endif
+
+// Set through ShaderDefines: 16-bit UNORM positions relative to the mesh box and octahedral normals
+// from the vertex input stage, see VertexQuantizer.
+#ifndef QUANTIZED_VERTICES
+#define QUANTIZED_VERTICES 0
+#endif
+
 layout(std140, set=0, binding=0) uniform Transformations {
     mat4 projMatrix;
     mat4 viewMatrix;
     mat4 worldMatrix;
 } ;
 
+#if OBJECT_TRANSFORMS
+struct CullObject
+{
+    vec4 boundingSphere;
+    mat4 transform;
+    uint firstIndex;
+    uint indexCount;
+    int  vertexOffset;
+    uint unused;
+};
+
+layout(std430, set=0, binding=1) readonly buffer Objects {
+    CullObject objects[];
+};
+#endif
+
+#if VERTEX_PULLING
+layout(std430, set=1, binding=0) readonly buffer Positions {
+    float positions[];
+};
+
+layout(std430, set=1, binding=1) readonly buffer Normals {
+    float normals[];
+};
+#elif QUANTIZED_VERTICES
+// position = positionOffset + positionScale * quantizedPos
+layout(push_constant) uniform Dequantization {
+    vec4 positionScale;
+    vec4 positionOffset;
+};
+
+layout( location = 0 ) in vec3 quantizedPos;
+layout( location = 1 ) in vec2 octNormal;
+
+vec3 decodeOctahedral(vec2 encoded) {
+    vec3  n = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float t = max(-n.z, 0.0f);
+    n.xy += vec2(n.x >= 0.0f ? -t : t, n.y >= 0.0f ? -t : t);
+    return normalize(n);
+}
+#else
 layout( location = 0 ) in vec3 pos;
 layout( location = 1 ) in vec3 normal;
+#endif
 
 layout(location = 0) out vec4 worldPos;
 layout(location = 1) out vec3 worldNormal;
 
 void main(){
-    worldPos    = worldMatrix * vec4(pos, 1.0f);
-    worldNormal = normalize( mat3(worldMatrix) * normal ); 
+#if VERTEX_PULLING
+    // gl_VertexIndex already includes the vertexOffset of the draw.
+    uint vertexID = uint(gl_VertexIndex);
+    vec3 pos    = vec3(positions[POSITION_STRIDE * vertexID + POSITION_OFFSET + 0],
+                       positions[POSITION_STRIDE * vertexID + POSITION_OFFSET + 1],
+                       positions[POSITION_STRIDE * vertexID + POSITION_OFFSET + 2]);
+    vec3 normal = vec3(normals[NORMAL_STRIDE * vertexID + NORMAL_OFFSET + 0],
+                       normals[NORMAL_STRIDE * vertexID + NORMAL_OFFSET + 1],
+                       normals[NORMAL_STRIDE * vertexID + NORMAL_OFFSET + 2]);
+#elif QUANTIZED_VERTICES
+    vec3 pos    = positionOffset.xyz + positionScale.xyz * quantizedPos;
+    vec3 normal = decodeOctahedral(octNormal);
+#endif
+
+#if OBJECT_TRANSFORMS
+    mat4 modelMatrix = worldMatrix * objects[gl_InstanceIndex].transform;
+#else
+    mat4 modelMatrix = worldMatrix;
+#endif
+    worldPos    = modelMatrix * vec4(pos, 1.0f);
+    worldNormal = normalize( mat3(modelMatrix) * normal ); 
     gl_Position = projMatrix * viewMatrix * worldPos;
-}
\ No newline at end of file
+}
@@ -0,0 +1,20 @@
+#version 450
+
+// Resolved by pointResolve.comp, one texel per pixel.
+layout(set=0, binding=3) uniform sampler2D pointColor;
+layout(set=0, binding=4) uniform sampler2D pointDepth;
+
+layout(location = 0) out vec4 outColor;
+
+// Writes the depth of the points, so the depth test composes them with the meshes.
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+
+    vec4 color = texelFetch(pointColor, pixel, 0);
+    if (color.a == 0.0f)
+        discard;
+
+    outColor     = vec4(color.rgb, 1.0f);
+    gl_FragDepth = texelFetch(pointDepth, pixel, 0).r;
+}
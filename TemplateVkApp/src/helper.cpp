@@ -1,5 +1,7 @@
 #include "helper.h"
 
+#include <algorithm>
+
 #if defined(_WIN32)
 	#include <windows.h>
 #else
@@ -121,4 +123,24 @@ bool deleteFile(const char* path)
 #if defined(_WIN32)
 	return DeleteFileA(path);
 #endif
-}
\ No newline at end of file
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+uint32_t getParallelRangeCount(size_t count, size_t minRangeSize)
+{
+	// Parenthesized, windows.h defines min and max macros.
+	size_t nThreads = (std::max)(std::thread::hardware_concurrency(), 1u);
+	size_t nRanges  = (std::min)(nThreads, count / (std::max)(minRangeSize, size_t(1)));
+	return static_cast<uint32_t>((std::max)(nRanges, size_t(1)));
+}
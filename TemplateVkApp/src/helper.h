@@ -6,6 +6,7 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <thread>
 
 // GLM
 #include "glm/glm.hpp"
@@ -28,4 +29,36 @@ uint32_t FindVkMemoryTypeIndex(
 
 bool executeCommand(char* cmd, const char* directory);
 bool deleteFile(const char* path);
+
+// 64-bit FNV-1a hash of a block of memory. Pass the previous result as seed to chain several blocks.
+const uint64_t HashSeed = 14695981039346656037ull;
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed = HashSeed);
+
+template<typename T>
+uint64_t hashValue(const T& value, uint64_t seed = HashSeed)
+{
+	return hashBytes(&value, sizeof(T), seed);
+}
+
+// Number of contiguous ranges parallelForRanges() should split count elements into: one per hardware
+// thread, but none smaller than minRangeSize elements, so small inputs stay on the calling thread.
+uint32_t getParallelRangeCount(size_t count, size_t minRangeSize);
+
+// Calls func(range, begin, end) for nRanges contiguous ranges of [0, count), each on its own thread.
+// Range 0 runs on the calling thread, which returns when all ranges are done.
+template<typename Func>
+void parallelForRanges(size_t count, uint32_t nRanges, Func func)
+{
+	if (nRanges == 0)
+		return;
+
+	std::vector<std::thread> threads;
+	for (uint32_t range = 1; range < nRanges; range++)
+		threads.emplace_back(func, range, count * range / nRanges, count * (range + 1) / nRanges);
+
+	func(0u, size_t(0), count / nRanges);
+
+	for (auto& thread : threads)
+		thread.join();
+}
 #endif
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "application.h"
 
+#include <string.h>
+
 //#define  DEBUG_MEM_LEAKS
 #ifdef   DEBUG_MEM_LEAKS
 # define _CRTDBG_MAP_ALLOC
@@ -9,7 +11,7 @@
 
 Application app;
 
-int main() {
+int main(int argc, char** argv) {
 #ifdef DEBUG_MEM_LEAKS
   _CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
   //_CrtSetReportMode(_CRT_ERROR, _CRTDBG_MODE_DEBUG);
@@ -17,6 +19,34 @@ int main() {
 
   app.init(800, 600);
 
+  // --test-gpu-primitives [count]: checks and times the GPU primitives before the application starts.
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--test-gpu-primitives") == 0) {
+      uint32_t count = i + 1 < argc ? static_cast<uint32_t>(atoi(argv[i + 1])) : 0;
+      app.testGpuPrimitives(count > 0 ? count : 1 << 20);
+    }
+    // --vertex-input: draws the mesh with fixed function vertex input instead of vertex pulling.
+    if (strcmp(argv[i], "--vertex-input") == 0)
+      app.setVertexPulling(false);
+    // --no-mesh-optimization: draws the triangles and vertices in file order.
+    if (strcmp(argv[i], "--no-mesh-optimization") == 0)
+      app.setMeshOptimization(false);
+    // --no-mesh-deformation: draws the mesh as loaded, without the compute passes.
+    if (strcmp(argv[i], "--no-mesh-deformation") == 0)
+      app.setMeshDeformation(false);
+    // --meshlet-backface-culling: skips meshlets facing away, for closed meshes without deformation.
+    if (strcmp(argv[i], "--meshlet-backface-culling") == 0)
+      app.setMeshletBackfaceCulling(true);
+    // --stream-mesh: draws the mesh while it is loaded on a background thread.
+    if (strcmp(argv[i], "--stream-mesh") == 0)
+      app.setMeshStreaming(true);
+    // --quantize-vertices [8|16]: draws the mesh with 16-bit positions and octahedral normals.
+    if (strcmp(argv[i], "--quantize-vertices") == 0) {
+      uint32_t normalBits = i + 1 < argc ? static_cast<uint32_t>(atoi(argv[i + 1])) : 0;
+      app.setVertexQuantization(normalBits == 8 ? 8 : 16);
+    }
+  }
+
   app.run();
     
   app.shutdown();
@@ -1,57 +1,904 @@
 #include "plydatareader.h"
 
+#include "helper.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <type_traits>
+
+// ======================================
+// Binary fast path
+// ======================================
+// rply calls back once per scalar. For binary files the records of an element have a layout known
+// from the header, so whole blocks of records are converted here, one property at a time.
+namespace
+{
+  // A scalar property which is written into the target, Color writes an unsigned byte.
+  struct VertexField
+  {
+    const char* Name;
+    size_t TargetOffset;
+    bool Color;
+  };
+
+  struct PlyProperty
+  {
+    const char* Name;
+    e_ply_type Type;
+    e_ply_type LengthType;
+    e_ply_type ValueType;
+  };
+
+  // Where the block decoders write. Without batches the whole vertex element goes to Vertices and
+  // all indices to Indices, the caller's buffers. With batches Vertices holds BatchVertices records,
+  // Indices grows in IndexStorage, and both are handed to the flush functions and reused.
+  struct ElementOutput
+  {
+    char* Vertices;
+    size_t VertexStride;
+    uint64_t BatchVertices;
+    std::function<bool(uint64_t, uint64_t)> FlushVertices;             // first vertex, vertex count
+
+    unsigned int* Indices;
+    size_t IndexCount;
+    size_t IndexCapacity;
+    std::vector<unsigned int>* IndexStorage;
+    uint64_t BatchFaces;
+    std::function<bool(uint64_t, uint64_t, size_t)> FlushFaces;        // first face, face count, index count
+
+    bool Stopped;                                                       // a flush function returned false
+
+    ElementOutput(char* _pVertices, size_t _pVertexStride, unsigned int* _pIndices) :
+      Vertices(_pVertices), VertexStride(_pVertexStride), BatchVertices(0),
+      Indices(_pIndices), IndexCount(0), IndexCapacity(std::numeric_limits<size_t>::max()), IndexStorage(0), BatchFaces(0),
+      Stopped(false)
+    {
+    }
+  };
+
+  // The data section in blocks of at least 1 MB, read through rply. For a mapped file, the blocks
+  // point into the mapping and nothing is copied.
+  class BinaryBlockReader
+  {
+  public:
+    BinaryBlockReader(p_ply _pPlyParser) : m_PlyParser(_pPlyParser), m_Buffer(1 << 20), m_Data(0), m_First(0), m_Last(0)
+    {
+    }
+
+    BinaryBlockReader(const char* _pData, size_t _pSize) : m_PlyParser(0), m_Data(_pData), m_First(0), m_Last(_pSize)
+    {
+    }
+
+    // Makes _pSize bytes available at data(), false if the file ends before.
+    bool require(size_t _pSize)
+    {
+      if (m_Last - m_First >= _pSize || m_Data != 0)
+        return m_Last - m_First >= _pSize;
+
+      memmove(m_Buffer.data(), m_Buffer.data() + m_First, m_Last - m_First);
+      m_Last -= m_First;
+      m_First = 0;
+
+      if (m_Buffer.size() < _pSize)
+        m_Buffer.resize(_pSize);
+
+      m_Last += ply_read_raw(m_PlyParser, m_Buffer.data() + m_Last, m_Buffer.size() - m_Last);
+      return m_Last - m_First >= _pSize;
+    }
+
+    const char* data() const
+    {
+      return (m_Data != 0 ? m_Data : m_Buffer.data()) + m_First;
+    }
+
+    void consume(size_t _pSize)
+    {
+      m_First += _pSize;
+    }
+
+  private:
+    p_ply m_PlyParser;
+    std::vector<char> m_Buffer;
+    const char* m_Data;
+    size_t m_First;
+    size_t m_Last;
+  };
+
+  // The byte reversal is recognized by compilers and becomes a single bswap.
+  template <typename T, bool Swap>
+  T loadScalar(const char* _pData)
+  {
+    T Value;
+    if (Swap)
+    {
+      char Bytes[sizeof(T)];
+      for (size_t i = 0; i < sizeof(T); i++)
+        Bytes[i] = _pData[sizeof(T) - 1 - i];
+      memcpy(&Value, Bytes, sizeof(T));
+    }
+    else
+    {
+      memcpy(&Value, _pData, sizeof(T));
+    }
+    return Value;
+  }
+
+  // Floats in [0, 1] are scaled to bytes, integers are clamped.
+  template <typename T>
+  unsigned char toColor(T _pValue)
+  {
+    double Value = std::is_floating_point<T>::value ? (double)_pValue * 255.0 : (double)_pValue;
+    Value = Value < 0.0 ? 0.0 : (Value > 255.0 ? 255.0 : Value);
+    return (unsigned char)(Value + 0.5);
+  }
+
+  // One property of _pCount records, the loop has no branches left for the compiler to vectorize.
+  template <typename T, bool Swap, bool Color>
+  void convertField(const char* _pSource, size_t _pSourceStride, char* _pTarget, size_t _pTargetStride, size_t _pCount)
+  {
+    for (size_t i = 0; i < _pCount; i++)
+    {
+      T Value = loadScalar<T, Swap>(_pSource + i * _pSourceStride);
+      if (Color)
+      {
+        _pTarget[i * _pTargetStride] = (char)toColor(Value);
+      }
+      else
+      {
+        float Converted = (float)Value;
+        memcpy(_pTarget + i * _pTargetStride, &Converted, sizeof(float));
+      }
+    }
+  }
+
+  template <bool Swap, bool Color>
+  void convertField(e_ply_type _pType, const char* _pSource, size_t _pSourceStride, char* _pTarget, size_t _pTargetStride, size_t _pCount)
+  {
+    switch (_pType)
+    {
+    case PLY_INT8: case PLY_CHAR:     convertField<int8_t, Swap, Color>(_pSource, _pSourceStride, _pTarget, _pTargetStride, _pCount); break;
+    case PLY_UINT8: case PLY_UCHAR:   convertField<uint8_t, Swap, Color>(_pSource, _pSourceStride, _pTarget, _pTargetStride, _pCount); break;
+    case PLY_INT16: case PLY_SHORT:   convertField<int16_t, Swap, Color>(_pSource, _pSourceStride, _pTarget, _pTargetStride, _pCount); break;
+    case PLY_UINT16: case PLY_USHORT: convertField<uint16_t, Swap, Color>(_pSource, _pSourceStride, _pTarget, _pTargetStride, _pCount); break;
+    case PLY_INT32: case PLY_INT:     convertField<int32_t, Swap, Color>(_pSource, _pSourceStride, _pTarget, _pTargetStride, _pCount); break;
+    case PLY_UIN32: case PLY_UINT:    convertField<uint32_t, Swap, Color>(_pSource, _pSourceStride, _pTarget, _pTargetStride, _pCount); break;
+    case PLY_FLOAT32: case PLY_FLOAT: convertField<float, Swap, Color>(_pSource, _pSourceStride, _pTarget, _pTargetStride, _pCount); break;
+    case PLY_FLOAT64: case PLY_DOUBLE: convertField<double, Swap, Color>(_pSource, _pSourceStride, _pTarget, _pTargetStride, _pCount); break;
+    default: break;
+    }
+  }
+
+  // List lengths and face indices, one value at a time.
+  template <bool Swap>
+  unsigned int loadIndex(e_ply_type _pType, const char* _pData)
+  {
+    switch (_pType)
+    {
+    case PLY_INT8: case PLY_CHAR:      return (unsigned int)loadScalar<int8_t, Swap>(_pData);
+    case PLY_UINT8: case PLY_UCHAR:    return (unsigned int)loadScalar<uint8_t, Swap>(_pData);
+    case PLY_INT16: case PLY_SHORT:    return (unsigned int)loadScalar<int16_t, Swap>(_pData);
+    case PLY_UINT16: case PLY_USHORT:  return (unsigned int)loadScalar<uint16_t, Swap>(_pData);
+    case PLY_INT32: case PLY_INT:      return (unsigned int)loadScalar<int32_t, Swap>(_pData);
+    case PLY_UIN32: case PLY_UINT:     return loadScalar<uint32_t, Swap>(_pData);
+    case PLY_FLOAT32: case PLY_FLOAT:  return (unsigned int)loadScalar<float, Swap>(_pData);
+    case PLY_FLOAT64: case PLY_DOUBLE: return (unsigned int)loadScalar<double, Swap>(_pData);
+    default: return 0;
+    }
+  }
+
+  std::vector<PlyProperty> getProperties(p_ply_element _pElement)
+  {
+    std::vector<PlyProperty> Properties;
+    p_ply_property CurrProperty = ply_get_next_property(_pElement, 0);
+    while (CurrProperty != 0)
+    {
+      PlyProperty Property;
+      ply_get_property_info(CurrProperty, &Property.Name, &Property.Type, &Property.LengthType, &Property.ValueType);
+      Properties.push_back(Property);
+      CurrProperty = ply_get_next_property(_pElement, CurrProperty);
+    }
+    return Properties;
+  }
+
+  // Walks one record with list properties. The values of the list _pIndexList are appended to the
+  // indices of _pOutput, everything else is skipped.
+  template <bool Swap>
+  bool readListRecord(BinaryBlockReader& _pReader, const std::vector<PlyProperty>& _pProperties, const char* _pIndexList, ElementOutput& _pOutput)
+  {
+    for (const PlyProperty& Property : _pProperties)
+    {
+      if (Property.Type != PLY_LIST)
+      {
+        size_t Size = PlyDataReader::getTypeLength(Property.Type);
+        if (!_pReader.require(Size))
+          return false;
+        _pReader.consume(Size);
+        continue;
+      }
+
+      size_t LengthSize = PlyDataReader::getTypeLength(Property.LengthType);
+      if (!_pReader.require(LengthSize))
+        return false;
+      size_t Length = loadIndex<Swap>(Property.LengthType, _pReader.data());
+      _pReader.consume(LengthSize);
+
+      size_t ValueSize = PlyDataReader::getTypeLength(Property.ValueType);
+      if (!_pReader.require(Length * ValueSize))
+        return false;
+
+      if (_pOutput.Indices != 0 && _pIndexList != 0 && !strcmp(Property.Name, _pIndexList))
+      {
+        if (_pOutput.IndexCount + Length > _pOutput.IndexCapacity)
+        {
+          _pOutput.IndexStorage->resize((std::max)(2 * _pOutput.IndexStorage->size(), _pOutput.IndexCount + Length));
+          _pOutput.Indices = _pOutput.IndexStorage->data();
+          _pOutput.IndexCapacity = _pOutput.IndexStorage->size();
+        }
+
+        for (size_t i = 0; i < Length; i++)
+          _pOutput.Indices[_pOutput.IndexCount++] = loadIndex<Swap>(Property.ValueType, _pReader.data() + i * ValueSize);
+      }
+      _pReader.consume(Length * ValueSize);
+    }
+    return true;
+  }
+
+  // Reads the whole data section. The vertex element is converted with _pFields, the face indices
+  // are appended, see ElementOutput.
+  template <bool Swap>
+  bool readBinaryElements(p_ply _pPlyParser, BinaryBlockReader& _pReader, const std::vector<VertexField>& _pFields, ElementOutput& _pOutput)
+  {
+    p_ply_element CurrElement = ply_get_next_element(_pPlyParser, 0);
+    while (CurrElement != 0)
+    {
+      const char* ElementName;
+      long long nElements;
+      ply_get_element_info(CurrElement, &ElementName, 0);
+      ply_get_element_count(CurrElement, &nElements);
+
+      std::vector<PlyProperty> Properties = getProperties(CurrElement);
+
+      size_t RecordSize = 0;
+      bool HasList = false;
+      for (const PlyProperty& Property : Properties)
+      {
+        HasList = HasList || Property.Type == PLY_LIST;
+        RecordSize += Property.Type == PLY_LIST ? 0 : PlyDataReader::getTypeLength(Property.Type);
+      }
+
+      if (HasList)
+      {
+        // Faces: vertex_indices, some exporters write vertex_index.
+        const char* IndexList = 0;
+        if (!strcmp(ElementName, "face"))
+        {
+          for (const PlyProperty& Property : Properties)
+          {
+            if (Property.Type == PLY_LIST && (!strcmp(Property.Name, "vertex_indices") || !strcmp(Property.Name, "vertex_index")))
+              IndexList = Property.Name;
+          }
+        }
+
+        uint64_t BatchFirst = 0;
+        for (uint64_t i = 0; i < (uint64_t)nElements; i++)
+        {
+          if (!readListRecord<Swap>(_pReader, Properties, IndexList, _pOutput))
+            return false;
 
-char* PlyDataReader::m_VertexDataPtr = 0;
-int PlyDataReader::m_CurrVertexByte = 0;
-unsigned int PlyDataReader::m_nVertices = 0;
-unsigned int PlyDataReader::m_nFaces = 0;
+          if (_pOutput.BatchFaces != 0 && IndexList != 0 && (i + 1 - BatchFirst == _pOutput.BatchFaces || i + 1 == (uint64_t)nElements))
+          {
+            _pOutput.Stopped = !_pOutput.FlushFaces(BatchFirst, i + 1 - BatchFirst, _pOutput.IndexCount);
+            if (_pOutput.Stopped)
+              return false;
 
-char* PlyDataReader::m_IndexDataPtr = 0;
-int PlyDataReader::m_CurrIndexByte = 0;
+            BatchFirst = i + 1;
+            _pOutput.IndexCount = 0;
+          }
+        }
+      }
+      else if (!strcmp(ElementName, "vertex") && _pOutput.Vertices != 0)
+      {
+        // The source offset of every field, once per file.
+        std::vector<std::pair<size_t, e_ply_type>> Sources(_pFields.size(), std::make_pair((size_t)0, PLY_LIST));
+        size_t Offset = 0;
+        for (const PlyProperty& Property : Properties)
+        {
+          for (size_t f = 0; f < _pFields.size(); f++)
+          {
+            if (!strcmp(Property.Name, _pFields[f].Name))
+              Sources[f] = std::make_pair(Offset, Property.Type);
+          }
+          Offset += PlyDataReader::getTypeLength(Property.Type);
+        }
 
-PlyDataReader* PlyDataReader::m_SingletonPtr = 0;
-PlyDataReaderDestructor PlyDataReader::m_DestructorObject;
-p_ply PlyDataReader::m_PlyParser;
+        uint64_t BatchSize = _pOutput.BatchVertices != 0 ? _pOutput.BatchVertices : (uint64_t)nElements;
+        uint64_t BlockRecords = (std::max)((uint64_t)1, ((uint64_t)1 << 20) / (std::max)(RecordSize, (size_t)1));
+        uint64_t BatchFirst = 0;
+        for (uint64_t First = 0; First < (uint64_t)nElements;)
+        {
+          size_t Count = (size_t)(std::min)((std::min)(BlockRecords, (uint64_t)nElements - First), BatchFirst + BatchSize - First);
+          if (!_pReader.require(Count * RecordSize))
+            return false;
 
-PlyDataReader::PlyDataReader()
+          char* Target = _pOutput.Vertices + (size_t)(First - BatchFirst) * _pOutput.VertexStride;
+          for (size_t f = 0; f < _pFields.size(); f++)
+          {
+            if (Sources[f].second == PLY_LIST)
+              continue;
+
+            const char* Source = _pReader.data() + Sources[f].first;
+            if (_pFields[f].Color)
+              convertField<Swap, true>(Sources[f].second, Source, RecordSize, Target + _pFields[f].TargetOffset, _pOutput.VertexStride, Count);
+            else
+              convertField<Swap, false>(Sources[f].second, Source, RecordSize, Target + _pFields[f].TargetOffset, _pOutput.VertexStride, Count);
+          }
+          _pReader.consume(Count * RecordSize);
+          First += Count;
+
+          if (_pOutput.BatchVertices != 0 && (First - BatchFirst == BatchSize || First == (uint64_t)nElements))
+          {
+            _pOutput.Stopped = !_pOutput.FlushVertices(BatchFirst, First - BatchFirst);
+            if (_pOutput.Stopped)
+              return false;
+
+            BatchFirst = First;
+          }
+        }
+      }
+      else
+      {
+        uint64_t Remaining = (uint64_t)nElements * RecordSize;
+        while (Remaining > 0)
+        {
+          size_t Size = (size_t)(std::min)(Remaining, (uint64_t)1 << 20);
+          if (!_pReader.require(Size))
+            return false;
+          _pReader.consume(Size);
+          Remaining -= Size;
+        }
+      }
+
+      CurrElement = ply_get_next_element(_pPlyParser, CurrElement);
+    }
+
+    return true;
+  }
+
+  bool isHostLittleEndian()
+  {
+    const unsigned int One = 1;
+    return *(const unsigned char*)&One == 1;
+  }
+}
+
+// Decodes binary files without the rply callbacks, from _pMappedFile if it is open. False if rply has
+// to read the file, the data was not touched then. _pSuccess is false if the file ended early or a
+// flush function stopped the reading.
+static bool readBinaryData(p_ply _pPlyParser, const MappedFile& _pMappedFile, size_t _pDataOffset, const std::vector<VertexField>& _pFields,
+  ElementOutput& _pOutput, bool& _pSuccess)
 {
+  e_ply_storage_mode StorageMode;
+  if (!ply_get_storage_mode(_pPlyParser, &StorageMode) || StorageMode == PLY_ASCII)
+    return false;
+
+  // Vertices with list properties have no fixed layout, rply reads those.
+  p_ply_element CurrElement = ply_get_next_element(_pPlyParser, 0);
+  while (CurrElement != 0 && _pOutput.Vertices != 0)
+  {
+    const char* ElementName;
+    ply_get_element_info(CurrElement, &ElementName, 0);
+    for (const PlyProperty& Property : getProperties(CurrElement))
+    {
+      if (!strcmp(ElementName, "vertex") && Property.Type == PLY_LIST)
+        return false;
+    }
+    CurrElement = ply_get_next_element(_pPlyParser, CurrElement);
+  }
+
+  bool Swap = (StorageMode == PLY_LITTLE_ENDIAN) != isHostLittleEndian();
+  BinaryBlockReader Reader = _pMappedFile.isOpen() ?
+    BinaryBlockReader((const char*)_pMappedFile.data() + _pDataOffset, _pMappedFile.size() - _pDataOffset) : BinaryBlockReader(_pPlyParser);
+
+  _pSuccess = Swap ? readBinaryElements<true>(_pPlyParser, Reader, _pFields, _pOutput)
+                   : readBinaryElements<false>(_pPlyParser, Reader, _pFields, _pOutput);
+
+  if (!_pSuccess && !_pOutput.Stopped)
+    std::cout << "===> PLY Parser Message: Unexpected end of binary data" << std::endl;
+
+  return true;
 }
 
-PlyDataReader::~PlyDataReader()
+// The vertex properties of readData() which exist are written as floats, in the order of the file.
+static std::vector<VertexField> getMeshFields(p_ply _pPlyParser)
 {
+  static const char* const VertexProperties[] = { "x", "y", "z", "nx", "ny", "nz" };
+  std::vector<VertexField> Fields;
+
+  p_ply_element CurrElement = ply_get_next_element(_pPlyParser, 0);
+  while (CurrElement != 0)
+  {
+    const char* ElementName;
+    ply_get_element_info(CurrElement, &ElementName, 0);
+    if (!strcmp(ElementName, "vertex"))
+    {
+      for (const PlyProperty& Property : getProperties(CurrElement))
+      {
+        for (const char* Name : VertexProperties)
+        {
+          if (!strcmp(Property.Name, Name))
+            Fields.push_back({ Name, Fields.size() * sizeof(float), false });
+        }
+      }
+    }
+    CurrElement = ply_get_next_element(_pPlyParser, CurrElement);
+  }
+
+  return Fields;
 }
 
-PlyDataReader* PlyDataReader::getSingletonPtr()
+// ======================================
+// ASCII fast path
+// ======================================
+// rply reads ASCII files one token at a time with strtod. Here the mapped data section is split
+// into line aligned chunks which are parsed on all cores, one record per line as every exporter
+// writes them. Numbers which are exact in double, the mantissa below 2^53 and a power of ten up to
+// 10^22, take the locale free fast path of Clinger, everything else strtod like rply, so the
+// results are the same bits.
+namespace
 {
-  if (m_SingletonPtr == 0)
+  // The smallest chunk of text parsed on a thread of its own, see getParallelRangeCount(). A megabyte
+  // holds more than ten thousand vertex records.
+  const size_t MinAsciiBytesPerThread = 1 << 20;
+
+  struct AsciiElement
+  {
+    std::vector<PlyProperty> Properties;
+    std::vector<int> Fields;           // per property, the index of the vertex field or -1
+    const char* IndexList;             // the face list which is read, or 0
+    size_t FirstRecord;
+    size_t Count;
+    bool Vertex;
+  };
+
+  inline bool isBlank(char _pChar)
+  {
+    return _pChar == ' ' || _pChar == '\t' || _pChar == '\r' || _pChar == '\n';
+  }
+
+  // The next token of a line, false if the line has no more.
+  inline bool nextToken(const char*& _pCursor, const char* _pLineEnd, const char*& _pTokenEnd)
+  {
+    while (_pCursor < _pLineEnd && isBlank(*_pCursor))
+      _pCursor++;
+
+    _pTokenEnd = _pCursor;
+    while (_pTokenEnd < _pLineEnd && !isBlank(*_pTokenEnd))
+      _pTokenEnd++;
+
+    return _pTokenEnd != _pCursor;
+  }
+
+  // strtod and strtol need a terminated string, tokens in the mapping are not.
+  template <typename Parse>
+  bool parseTerminated(const char* _pToken, const char* _pTokenEnd, Parse _pParse)
   {
-    m_SingletonPtr = new PlyDataReader;
-    m_DestructorObject.setSingletonPointer(m_SingletonPtr);
+    char Buffer[128];
+    size_t Length = _pTokenEnd - _pToken;
+    if (Length >= sizeof(Buffer))
+      return false;
+
+    memcpy(Buffer, _pToken, Length);
+    Buffer[Length] = '\0';
+
+    char* End;
+    _pParse(Buffer, &End);
+    return *End == '\0';
   }
 
-  return m_SingletonPtr;
+  bool parseDouble(const char* _pToken, const char* _pTokenEnd, double& _pValue)
+  {
+    static const double PowersOfTen[] = {
+      1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char* Cursor = _pToken;
+    bool Negative = Cursor < _pTokenEnd && *Cursor == '-';
+    if (Cursor < _pTokenEnd && (*Cursor == '-' || *Cursor == '+'))
+      Cursor++;
+
+    uint64_t Mantissa = 0;
+    int Digits = 0;
+    int Exponent = 0;
+    bool AnyDigit = false;
+
+    for (; Cursor < _pTokenEnd && *Cursor >= '0' && *Cursor <= '9'; Cursor++)
+    {
+      AnyDigit = true;
+      if (Mantissa != 0 || *Cursor != '0')
+      {
+        Mantissa = Mantissa * 10 + (*Cursor - '0');
+        Digits++;
+      }
+    }
+
+    if (Cursor < _pTokenEnd && *Cursor == '.')
+    {
+      for (Cursor++; Cursor < _pTokenEnd && *Cursor >= '0' && *Cursor <= '9'; Cursor++)
+      {
+        AnyDigit = true;
+        if (Mantissa != 0 || *Cursor != '0')
+        {
+          Mantissa = Mantissa * 10 + (*Cursor - '0');
+          Digits++;
+        }
+        Exponent--;
+      }
+    }
+
+    if (AnyDigit && Cursor < _pTokenEnd && (*Cursor == 'e' || *Cursor == 'E'))
+    {
+      const char* ExponentCursor = Cursor + 1;
+      bool ExponentNegative = ExponentCursor < _pTokenEnd && *ExponentCursor == '-';
+      if (ExponentCursor < _pTokenEnd && (*ExponentCursor == '-' || *ExponentCursor == '+'))
+        ExponentCursor++;
+
+      int ExplicitExponent = 0;
+      bool AnyExponentDigit = false;
+      for (; ExponentCursor < _pTokenEnd && *ExponentCursor >= '0' && *ExponentCursor <= '9'; ExponentCursor++)
+      {
+        AnyExponentDigit = true;
+        ExplicitExponent = (std::min)(ExplicitExponent * 10 + (*ExponentCursor - '0'), 100000);
+      }
+
+      if (AnyExponentDigit)
+      {
+        Exponent += ExponentNegative ? -ExplicitExponent : ExplicitExponent;
+        Cursor = ExponentCursor;
+      }
+    }
+
+    // Both factors exact, the single rounding of the product is the rounding of strtod.
+    if (AnyDigit && Cursor == _pTokenEnd && Digits <= 19 && Mantissa <= ((uint64_t)1 << 53) && Exponent >= -22 && Exponent <= 22)
+    {
+      double Value = (double)Mantissa;
+      Value = Exponent < 0 ? Value / PowersOfTen[-Exponent] : Value * PowersOfTen[Exponent];
+      _pValue = Negative ? -Value : Value;
+      return true;
+    }
+
+    return parseTerminated(_pToken, _pTokenEnd, [&_pValue](const char* _pString, char** _pEnd) { _pValue = strtod(_pString, _pEnd); });
+  }
+
+  // As strtol, which clamps to the range of long.
+  bool parseLong(const char* _pToken, const char* _pTokenEnd, long& _pValue)
+  {
+    const char* Cursor = _pToken;
+    bool Negative = Cursor < _pTokenEnd && *Cursor == '-';
+    if (Cursor < _pTokenEnd && (*Cursor == '-' || *Cursor == '+'))
+      Cursor++;
+
+    if (Cursor == _pTokenEnd || _pTokenEnd - Cursor > 18)
+      return parseTerminated(_pToken, _pTokenEnd, [&_pValue](const char* _pString, char** _pEnd) { _pValue = strtol(_pString, _pEnd, 10); });
+
+    int64_t Value = 0;
+    for (; Cursor < _pTokenEnd; Cursor++)
+    {
+      if (*Cursor < '0' || *Cursor > '9')
+        return false;
+      Value = Value * 10 + (*Cursor - '0');
+    }
+
+    Value = Negative ? -Value : Value;
+    Value = (std::min)((std::max)(Value, (int64_t)std::numeric_limits<long>::min()), (int64_t)std::numeric_limits<long>::max());
+    _pValue = (long)Value;
+    return true;
+  }
+
+  // One value with the range checks of rply.
+  bool parseValue(e_ply_type _pType, const char* _pToken, const char* _pTokenEnd, double& _pValue)
+  {
+    double Min, Max;
+    switch (_pType)
+    {
+    case PLY_INT8: case PLY_CHAR:      Min = -128.0; Max = 127.0; break;
+    case PLY_UINT8: case PLY_UCHAR:    Min = 0.0; Max = 255.0; break;
+    case PLY_INT16: case PLY_SHORT:    Min = -32768.0; Max = 32767.0; break;
+    case PLY_UINT16: case PLY_USHORT:  Min = 0.0; Max = 65535.0; break;
+    case PLY_INT32: case PLY_INT:      Min = -2147483648.0; Max = 2147483647.0; break;
+    case PLY_UIN32: case PLY_UINT:     Min = 0.0; Max = 4294967295.0; break;
+    case PLY_FLOAT32: case PLY_FLOAT:  Min = -FLT_MAX; Max = FLT_MAX; break;
+    case PLY_FLOAT64: case PLY_DOUBLE: Min = -DBL_MAX; Max = DBL_MAX; break;
+    default: return false;
+    }
+
+    if (_pType == PLY_FLOAT32 || _pType == PLY_FLOAT || _pType == PLY_FLOAT64 || _pType == PLY_DOUBLE)
+    {
+      if (!parseDouble(_pToken, _pTokenEnd, _pValue))
+        return false;
+    }
+    else
+    {
+      long Value;
+      if (!parseLong(_pToken, _pTokenEnd, Value))
+        return false;
+      _pValue = (double)Value;
+    }
+
+    return _pValue >= Min && _pValue <= Max;
+  }
+
+  // One record, written like the rply handlers write it. False if the line does not match the header.
+  bool readAsciiRecord(const AsciiElement& _pElement, const char* _pLine, const char* _pLineEnd, const std::vector<VertexField>& _pFields,
+    char* _pVertex, std::vector<unsigned int>& _pIndices)
+  {
+    const char* Cursor = _pLine;
+    const char* TokenEnd;
+    double Value;
+
+    for (size_t p = 0; p < _pElement.Properties.size(); p++)
+    {
+      const PlyProperty& Property = _pElement.Properties[p];
+      if (Property.Type != PLY_LIST)
+      {
+        if (!nextToken(Cursor, _pLineEnd, TokenEnd) || !parseValue(Property.Type, Cursor, TokenEnd, Value))
+          return false;
+        Cursor = TokenEnd;
+
+        int Field = _pElement.Fields.empty() ? -1 : _pElement.Fields[p];
+        if (Field >= 0 && _pFields[Field].Color)
+        {
+          bool FloatColor = Property.Type == PLY_FLOAT32 || Property.Type == PLY_FLOAT || Property.Type == PLY_FLOAT64 || Property.Type == PLY_DOUBLE;
+          _pVertex[_pFields[Field].TargetOffset] = (char)(FloatColor ? toColor(Value) : toColor((long)Value));
+        }
+        else if (Field >= 0)
+        {
+          float Converted = (float)Value;
+          memcpy(_pVertex + _pFields[Field].TargetOffset, &Converted, sizeof(float));
+        }
+        continue;
+      }
+
+      if (!nextToken(Cursor, _pLineEnd, TokenEnd) || !parseValue(Property.LengthType, Cursor, TokenEnd, Value))
+        return false;
+      Cursor = TokenEnd;
+
+      bool Indices = _pElement.IndexList != 0 && !strcmp(Property.Name, _pElement.IndexList);
+      for (long i = 0; i < (long)Value; i++)
+      {
+        double Index;
+        if (!nextToken(Cursor, _pLineEnd, TokenEnd) || !parseValue(Property.ValueType, Cursor, TokenEnd, Index))
+          return false;
+        Cursor = TokenEnd;
+
+        if (Indices)
+          _pIndices.push_back((unsigned int)Index);
+      }
+    }
+
+    // Nothing may follow the record on its line.
+    return !nextToken(Cursor, _pLineEnd, TokenEnd);
+  }
+
+  // The first byte of the line after _pPosition.
+  const char* nextLine(const char* _pPosition, const char* _pEnd)
+  {
+    const char* NewLine = (const char*)memchr(_pPosition, '\n', _pEnd - _pPosition);
+    return NewLine != 0 ? NewLine + 1 : _pEnd;
+  }
+
+  bool isBlankLine(const char* _pLine, const char* _pLineEnd)
+  {
+    while (_pLine < _pLineEnd && isBlank(*_pLine))
+      _pLine++;
+    return _pLine == _pLineEnd;
+  }
+}
+
+// Parses ASCII files from _pMappedFile on all cores. False if rply has to read the file, because
+// there is no mapping or a line does not hold exactly one record.
+static bool readAsciiData(p_ply _pPlyParser, const MappedFile& _pMappedFile, size_t _pDataOffset, const std::vector<VertexField>& _pFields,
+  char* _pVertices, size_t _pVertexStride, unsigned int* _pIndices, size_t& _pIndexCount)
+{
+  e_ply_storage_mode StorageMode;
+  if (!_pMappedFile.isOpen() || !ply_get_storage_mode(_pPlyParser, &StorageMode) || StorageMode != PLY_ASCII)
+    return false;
+
+  // The records of every element, in the order of the file.
+  std::vector<AsciiElement> Elements;
+  size_t nRecords = 0;
+
+  p_ply_element CurrElement = ply_get_next_element(_pPlyParser, 0);
+  while (CurrElement != 0)
+  {
+    const char* ElementName;
+    long long nElements;
+    ply_get_element_info(CurrElement, &ElementName, 0);
+    ply_get_element_count(CurrElement, &nElements);
+
+    AsciiElement Element;
+    Element.Properties = getProperties(CurrElement);
+    Element.IndexList = 0;
+    Element.FirstRecord = nRecords;
+    Element.Count = (size_t)nElements;
+    Element.Vertex = !strcmp(ElementName, "vertex") && _pVertices != 0;
+
+    for (const PlyProperty& Property : Element.Properties)
+    {
+      int Field = -1;
+      for (size_t f = 0; f < _pFields.size() && Element.Vertex; f++)
+      {
+        if (!strcmp(Property.Name, _pFields[f].Name))
+          Field = (int)f;
+      }
+      Element.Fields.push_back(Field);
+
+      if (!strcmp(ElementName, "face") && _pIndices != 0 && Property.Type == PLY_LIST &&
+        (!strcmp(Property.Name, "vertex_indices") || !strcmp(Property.Name, "vertex_index")))
+        Element.IndexList = Property.Name;
+    }
+
+    nRecords += Element.Count;
+    Elements.push_back(Element);
+    CurrElement = ply_get_next_element(_pPlyParser, CurrElement);
+  }
+
+  const char* Data = (const char*)_pMappedFile.data() + _pDataOffset;
+  const char* DataEnd = (const char*)_pMappedFile.data() + _pMappedFile.size();
+
+  // Line aligned chunks.
+  uint32_t nChunks = getParallelRangeCount(DataEnd - Data, MinAsciiBytesPerThread);
+  std::vector<const char*> ChunkBegins(nChunks + 1, DataEnd);
+  ChunkBegins[0] = Data;
+  for (uint32_t c = 1; c < nChunks; c++)
+    ChunkBegins[c] = (std::max)(ChunkBegins[c - 1], nextLine(Data + (DataEnd - Data) * c / nChunks - 1, DataEnd));
+
+  // Pass 1: records per chunk, blank lines hold none.
+  std::vector<size_t> ChunkRecords(nChunks + 1, 0);
+  parallelForRanges(nChunks, nChunks, [&ChunkBegins, &ChunkRecords](uint32_t _pChunk, size_t, size_t)
+  {
+    size_t Records = 0;
+    for (const char* Line = ChunkBegins[_pChunk]; Line < ChunkBegins[_pChunk + 1];)
+    {
+      const char* LineEnd = nextLine(Line, ChunkBegins[_pChunk + 1]);
+      Records += isBlankLine(Line, LineEnd) ? 0 : 1;
+      Line = LineEnd;
+    }
+    ChunkRecords[_pChunk + 1] = Records;
+  });
+
+  for (uint32_t c = 0; c < nChunks; c++)
+    ChunkRecords[c + 1] += ChunkRecords[c];
+
+  if (ChunkRecords[nChunks] < nRecords)
+    return false;
+
+  // Pass 2: every chunk parses its records, indices are gathered per chunk.
+  std::vector<std::vector<unsigned int>> ChunkIndices(nChunks);
+  std::vector<char> ChunkValid(nChunks, 1);
+  parallelForRanges(nChunks, nChunks, [&](uint32_t _pChunk, size_t, size_t)
+  {
+    size_t Record = ChunkRecords[_pChunk];
+    size_t ElementIndex = 0;
+
+    for (const char* Line = ChunkBegins[_pChunk]; Line < ChunkBegins[_pChunk + 1] && Record < nRecords;)
+    {
+      const char* LineEnd = nextLine(Line, ChunkBegins[_pChunk + 1]);
+      if (!isBlankLine(Line, LineEnd))
+      {
+        while (Record >= Elements[ElementIndex].FirstRecord + Elements[ElementIndex].Count)
+          ElementIndex++;
+
+        const AsciiElement& Element = Elements[ElementIndex];
+        char* Vertex = Element.Vertex ? _pVertices + (Record - Element.FirstRecord) * _pVertexStride : 0;
+        if (!readAsciiRecord(Element, Line, LineEnd, _pFields, Vertex, ChunkIndices[_pChunk]))
+        {
+          ChunkValid[_pChunk] = 0;
+          return;
+        }
+        Record++;
+      }
+      Line = LineEnd;
+    }
+  });
+
+  if (std::find(ChunkValid.begin(), ChunkValid.end(), 0) != ChunkValid.end())
+    return false;
+
+  _pIndexCount = 0;
+  for (const std::vector<unsigned int>& Indices : ChunkIndices)
+  {
+    if (!Indices.empty())
+      memcpy(_pIndices + _pIndexCount, Indices.data(), Indices.size() * sizeof(unsigned int));
+    _pIndexCount += Indices.size();
+  }
+
+  return true;
 }
 
-void PlyDataReader::readDataInfo(const char* _pFileName, void* _pUserDataPtr, const long int& _pUserDataLen)
+PlyDataReader::PlyDataReader() :
+  m_PlyParser(0),
+  m_nVertices(0),
+  m_nFaces(0),
+  m_VertexDataPtr(0),
+  m_CurrVertexByte(0),
+  m_IndexDataPtr(0),
+  m_CurrIndexByte(0),
+  m_PointDataPtr(0),
+  m_PointStride(0),
+  m_MappedDataOffset(0),
+  m_UseMemoryMapping(true),
+  m_BatchCallback(0),
+  m_BatchVertices(0),
+  m_BatchFaces(0),
+  m_BatchFirstVertex(0),
+  m_BatchFirstFace(0),
+  m_BatchFaceCount(0),
+  m_BatchVertexStride(0)
 {
+}
+
+PlyDataReader::~PlyDataReader()
+{
+  close();
+}
+
+void PlyDataReader::close()
+{
+  if (m_PlyParser != 0)
+    ply_close(m_PlyParser);
+
+  m_PlyParser = 0;
+  m_MappedFile.close();
+}
+
+bool PlyDataReader::readDataInfo(const char* _pFileName)
+{
+  // The counts of a previous file must not leak into this one, point clouds have no face element.
+  close();
+  m_nVertices = 0;
+  m_nFaces = 0;
+  m_CurrVertexByte = 0;
+  m_CurrIndexByte = 0;
+
   // Open the PLY file
-  m_PlyParser = ply_open(_pFileName, PlyParserMessageHandlerProc, _pUserDataLen, _pUserDataPtr);
+  m_PlyParser = ply_open(_pFileName, PlyParserMessageHandlerProc, 0, this);
+  if (m_PlyParser == 0)
+    return false;
 
   /**  Read the header of the ply which shows that which data is offered by PLY file. For example, the vertices has which format and how many vertices
   * exists. The same information for other elements (Faces, Normal Vectors, ...) of the PLY object.
   */
-  ply_read_header(m_PlyParser);
+  if (!ply_read_header(m_PlyParser))
+  {
+    close();
+    return false;
+  }
+
+  // The data is decoded straight from the mapped file, rply only parses the header.
+  long long DataOffset = 0;
+  if (m_UseMemoryMapping && ply_get_data_offset(m_PlyParser, &DataOffset) && m_MappedFile.open(_pFileName))
+  {
+    m_MappedDataOffset = (size_t)DataOffset;
+    if (m_MappedDataOffset > m_MappedFile.size())
+      m_MappedFile.close();
+  }
 
   p_ply_element CurrElement;
   CurrElement = ply_get_next_element(m_PlyParser, NULL);
 
   while (CurrElement != 0)
   {
-    long nElements;
+    long long nElements;
     const char* ElementName;
 
-    ply_get_element_info(CurrElement, ((const char**)&ElementName), &nElements);
+    ply_get_element_info(CurrElement, ((const char**)&ElementName), 0);
+    ply_get_element_count(CurrElement, &nElements);
 
     if (!strcmp(ElementName, "vertex"))
     {
@@ -66,14 +913,21 @@ void PlyDataReader::readDataInfo(const char* _pFileName, void* _pUserDataPtr, co
 
     ElementName = 0;
   }
+
+  return true;
 }
 
-unsigned int PlyDataReader::getNumVertices()
+uint64_t PlyDataReader::getNumVertices()
 {
   return m_nVertices;
 }
 
-unsigned int PlyDataReader::getNumFaces()
+void PlyDataReader::setMemoryMapping(bool _pEnabled)
+{
+  m_UseMemoryMapping = _pEnabled;
+}
+
+uint64_t PlyDataReader::getNumFaces()
 {
   return m_nFaces;
 }
@@ -83,66 +937,253 @@ void PlyDataReader::readData(void* _pVertexBuffer, void* _pIndexBuffer)
   m_VertexDataPtr = (char*)_pVertexBuffer;
   m_IndexDataPtr = (char*)_pIndexBuffer;
 
-  ply_set_read_cb(m_PlyParser, "vertex", "x", VertexHandler, 0, 0);
-  ply_set_read_cb(m_PlyParser, "vertex", "y", VertexHandler, 0, 0);
-  ply_set_read_cb(m_PlyParser, "vertex", "z", VertexHandler, 0, 0);
-  ply_set_read_cb(m_PlyParser, "vertex", "nx", VertexHandler, 0, 0);
-  ply_set_read_cb(m_PlyParser, "vertex", "ny", VertexHandler, 0, 0);
-  ply_set_read_cb(m_PlyParser, "vertex", "nz", VertexHandler, 0, 0);
+  std::vector<VertexField> Fields = getMeshFields(m_PlyParser);
+
+  bool Success = false;
+  ElementOutput Output(m_VertexDataPtr + m_CurrVertexByte, Fields.size() * sizeof(float), (unsigned int*)(m_IndexDataPtr + m_CurrIndexByte));
+  if (readBinaryData(m_PlyParser, m_MappedFile, m_MappedDataOffset, Fields, Output, Success) ||
+    readAsciiData(m_PlyParser, m_MappedFile, m_MappedDataOffset, Fields, Output.Vertices, Output.VertexStride, Output.Indices, Output.IndexCount))
+  {
+    m_CurrVertexByte += (size_t)m_nVertices * Output.VertexStride;
+    m_CurrIndexByte += Output.IndexCount * sizeof(unsigned int);
+    close();
+    return;
+  }
+
+  // The reader is passed as user data, the handlers write into its buffers.
+  ply_set_read_cb(m_PlyParser, "vertex", "x", VertexHandler, this, 0);
+  ply_set_read_cb(m_PlyParser, "vertex", "y", VertexHandler, this, 0);
+  ply_set_read_cb(m_PlyParser, "vertex", "z", VertexHandler, this, 0);
+  ply_set_read_cb(m_PlyParser, "vertex", "nx", VertexHandler, this, 0);
+  ply_set_read_cb(m_PlyParser, "vertex", "ny", VertexHandler, this, 0);
+  ply_set_read_cb(m_PlyParser, "vertex", "nz", VertexHandler, this, 0);
 
-  ply_set_read_cb(m_PlyParser, "face", "vertex_indices", FaceHandler, 0, 0);
+  // Faces: vertex_indices, some exporters write vertex_index.
+  if (!ply_set_read_cb(m_PlyParser, "face", "vertex_indices", FaceHandler, this, 0))
+    ply_set_read_cb(m_PlyParser, "face", "vertex_index", FaceHandler, this, 0);
 
   ply_read(m_PlyParser);
+  close();
 }
 
-int PlyDataReader::VertexHandler(p_ply_argument _pArgument)
+void PlyDataReader::readPointData(void* _pPointBuffer, unsigned int _pStride)
 {
-  p_ply_property Property;
-  const char* PropertyName;
-  e_ply_type PropertyType;
-  e_ply_type PropertyValueType;
+  m_PointDataPtr = (char*)_pPointBuffer;
+  m_PointStride = _pStride;
+
+  // Opaque white for files without colors.
+  for (uint64_t i = 0; i < m_nVertices; i++)
+    memset(m_PointDataPtr + (size_t)i * m_PointStride + 3 * sizeof(float), 0xff, 4);
+
+  static const std::vector<VertexField> Fields = {
+    { "x", 0, false }, { "y", 4, false }, { "z", 8, false },
+    { "red", 12, true }, { "green", 13, true }, { "blue", 14, true }, { "alpha", 15, true }
+  };
+
+  bool Success = false;
+  ElementOutput Output(m_PointDataPtr, m_PointStride, 0);
+  if (readBinaryData(m_PlyParser, m_MappedFile, m_MappedDataOffset, Fields, Output, Success) ||
+    readAsciiData(m_PlyParser, m_MappedFile, m_MappedDataOffset, Fields, m_PointDataPtr, m_PointStride, 0, Output.IndexCount))
+  {
+    close();
+    return;
+  }
+
+  // The reader and the byte offset of the value in the point are passed as user data.
+  ply_set_read_cb(m_PlyParser, "vertex", "x", PointHandler, this, 0);
+  ply_set_read_cb(m_PlyParser, "vertex", "y", PointHandler, this, 4);
+  ply_set_read_cb(m_PlyParser, "vertex", "z", PointHandler, this, 8);
+  ply_set_read_cb(m_PlyParser, "vertex", "red", PointColorHandler, this, 12);
+  ply_set_read_cb(m_PlyParser, "vertex", "green", PointColorHandler, this, 13);
+  ply_set_read_cb(m_PlyParser, "vertex", "blue", PointColorHandler, this, 14);
+  ply_set_read_cb(m_PlyParser, "vertex", "alpha", PointColorHandler, this, 15);
+
+  ply_read(m_PlyParser);
+  close();
+}
+
+bool PlyDataReader::readBatches(uint64_t _pBatchVertices, uint64_t _pBatchFaces, const BatchCallback& _pCallback)
+{
+  if (m_PlyParser == 0 || _pBatchVertices == 0 || _pBatchFaces == 0)
+    return false;
+
+  std::vector<VertexField> Fields = getMeshFields(m_PlyParser);
+
+  m_BatchCallback = &_pCallback;
+  m_BatchVertices = _pBatchVertices;
+  m_BatchFaces = _pBatchFaces;
+  m_BatchFirstVertex = 0;
+  m_BatchFirstFace = 0;
+  m_BatchFaceCount = 0;
+  m_BatchVertexStride = (uint32_t)(Fields.size() * sizeof(float));
+
+  // One batch of each, triangles need no growth of the indices.
+  m_BatchVertexStorage.resize((size_t)_pBatchVertices * m_BatchVertexStride);
+  m_BatchIndexStorage.resize((size_t)_pBatchFaces * 3);
+  m_VertexDataPtr = m_BatchVertexStorage.data();
+  m_IndexDataPtr = (char*)m_BatchIndexStorage.data();
+  m_CurrVertexByte = 0;
+  m_CurrIndexByte = 0;
+
+  ElementOutput Output(m_VertexDataPtr, m_BatchVertexStride, m_BatchIndexStorage.data());
+  Output.IndexCapacity = m_BatchIndexStorage.size();
+  Output.IndexStorage = &m_BatchIndexStorage;
+  Output.BatchVertices = _pBatchVertices;
+  Output.BatchFaces = _pBatchFaces;
+  Output.FlushVertices = [this](uint64_t _pFirst, uint64_t _pCount) { return emitBatch(_pFirst, _pCount, 0, 0, 0); };
+  Output.FlushFaces = [this](uint64_t _pFirst, uint64_t _pCount, size_t _pIndexCount) { return emitBatch(0, 0, _pFirst, _pCount, _pIndexCount); };
+
+  // ASCII files go through rply, the parallel parser needs the whole element in memory.
+  bool Success = false;
+  if (!readBinaryData(m_PlyParser, m_MappedFile, m_MappedDataOffset, Fields, Output, Success))
+  {
+    for (const VertexField& Field : Fields)
+      ply_set_read_cb(m_PlyParser, "vertex", Field.Name, VertexHandler, this, 0);
+    if (!ply_set_read_cb(m_PlyParser, "face", "vertex_indices", FaceHandler, this, 0))
+      ply_set_read_cb(m_PlyParser, "face", "vertex_index", FaceHandler, this, 0);
+
+    Success = ply_read(m_PlyParser) &&
+      (m_CurrVertexByte == 0 || flushVertexBatch()) &&
+      (m_BatchFaceCount == 0 || flushFaceBatch());
+  }
+
+  m_BatchCallback = 0;
+  std::vector<char>().swap(m_BatchVertexStorage);
+  std::vector<unsigned int>().swap(m_BatchIndexStorage);
+  close();
+
+  return Success;
+}
+
+bool PlyDataReader::emitBatch(uint64_t _pFirstVertex, uint64_t _pVertexCount, uint64_t _pFirstFace, uint64_t _pFaceCount, size_t _pIndexCount)
+{
+  Batch CurrBatch;
+  CurrBatch.FirstVertex = _pFirstVertex;
+  CurrBatch.VertexCount = _pVertexCount;
+  CurrBatch.Vertices = _pVertexCount != 0 ? (const float*)m_BatchVertexStorage.data() : 0;
+  CurrBatch.VertexStride = m_BatchVertexStride;
+  CurrBatch.FirstFace = _pFirstFace;
+  CurrBatch.FaceCount = _pFaceCount;
+  CurrBatch.Indices = _pFaceCount != 0 ? m_BatchIndexStorage.data() : 0;
+  CurrBatch.IndexCount = _pIndexCount;
+
+  return (*m_BatchCallback)(CurrBatch);
+}
+
+bool PlyDataReader::flushVertexBatch()
+{
+  uint64_t Count = m_CurrVertexByte / m_BatchVertexStride;
+  m_CurrVertexByte = 0;
+
+  bool Continue = emitBatch(m_BatchFirstVertex, Count, 0, 0, 0);
+  m_BatchFirstVertex += Count;
+  return Continue;
+}
+
+bool PlyDataReader::flushFaceBatch()
+{
+  size_t IndexCount = m_CurrIndexByte / sizeof(unsigned int);
+  m_CurrIndexByte = 0;
+
+  bool Continue = emitBatch(0, 0, m_BatchFirstFace, m_BatchFaceCount, IndexCount);
+  m_BatchFirstFace += m_BatchFaceCount;
+  m_BatchFaceCount = 0;
+  return Continue;
+}
+
+int PlyDataReader::PointHandler(p_ply_argument _pArgument)
+{
+  PlyDataReader* Reader = 0;
+  long long Index = 0;
+  long Offset = 0;
+  ply_get_argument_element(_pArgument, 0, &Index);
+  ply_get_argument_user_data(_pArgument, (void**)&Reader, &Offset);
 
   float Value = (float)ply_get_argument_value(_pArgument);
+  memcpy(Reader->m_PointDataPtr + (size_t)Index * Reader->m_PointStride + Offset, &Value, sizeof(float));
+
+  return 1;
+}
 
+int PlyDataReader::PointColorHandler(p_ply_argument _pArgument)
+{
+  PlyDataReader* Reader = 0;
+  long long Index = 0;
+  long Offset = 0;
+  ply_get_argument_element(_pArgument, 0, &Index);
+  ply_get_argument_user_data(_pArgument, (void**)&Reader, &Offset);
+
+  p_ply_property Property;
+  e_ply_type PropertyType;
   ply_get_argument_property(_pArgument, &Property, 0, 0);
-  ply_get_property_info(Property, &PropertyName, &PropertyType, 0, &PropertyValueType);
+  ply_get_property_info(Property, 0, &PropertyType, 0, 0);
+
+  // Some files store colors as floats in [0, 1].
+  double Value = ply_get_argument_value(_pArgument);
+  if (PropertyType == PLY_FLOAT || PropertyType == PLY_FLOAT32 || PropertyType == PLY_DOUBLE || PropertyType == PLY_FLOAT64)
+    Value *= 255.0;
 
-  int WriteLength = getTypeLength(PropertyType);
-  memcpy(m_VertexDataPtr + m_CurrVertexByte, &Value, WriteLength);
-  m_CurrVertexByte += WriteLength;
+  Value = Value < 0.0 ? 0.0 : (Value > 255.0 ? 255.0 : Value);
+  Reader->m_PointDataPtr[(size_t)Index * Reader->m_PointStride + Offset] = (char)(unsigned char)(Value + 0.5);
+
+  return 1;
+}
+
+int PlyDataReader::VertexHandler(p_ply_argument _pArgument)
+{
+  PlyDataReader* Reader = 0;
+  ply_get_argument_user_data(_pArgument, (void**)&Reader, 0);
+
+  // Floats whatever the type in the file, like the block decoders.
+  float Value = (float)ply_get_argument_value(_pArgument);
+  memcpy(Reader->m_VertexDataPtr + Reader->m_CurrVertexByte, &Value, sizeof(float));
+  Reader->m_CurrVertexByte += sizeof(float);
+
+  if (Reader->m_BatchCallback != 0 && Reader->m_CurrVertexByte == Reader->m_BatchVertexStorage.size())
+    return Reader->flushVertexBatch();
 
   return 1;
 }
 
 int PlyDataReader::FaceHandler(p_ply_argument _pArgument)
 {
+  PlyDataReader* Reader = 0;
   p_ply_property Property;
 
   unsigned int Value = (unsigned int)ply_get_argument_value(_pArgument);
   long Value_Index = -1;
 
   ply_get_argument_property(_pArgument, &Property, 0, &Value_Index);
+  ply_get_argument_user_data(_pArgument, (void**)&Reader, 0);
+
+  // The length of the list comes first. In readBatches() it starts a face, which may complete the
+  // pending batches.
+  if (Value_Index < 0 && Reader->m_BatchCallback != 0)
+  {
+    if (Reader->m_CurrVertexByte != 0 && !Reader->flushVertexBatch())
+      return 0;
+    if (Reader->m_BatchFaceCount == Reader->m_BatchFaces && !Reader->flushFaceBatch())
+      return 0;
+
+    size_t IndexCount = Reader->m_CurrIndexByte / sizeof(unsigned int) + Value;
+    if (IndexCount > Reader->m_BatchIndexStorage.size())
+    {
+      Reader->m_BatchIndexStorage.resize((std::max)(2 * Reader->m_BatchIndexStorage.size(), IndexCount));
+      Reader->m_IndexDataPtr = (char*)Reader->m_BatchIndexStorage.data();
+    }
+    Reader->m_BatchFaceCount++;
+  }
 
   if (Value_Index >= 0)
   {
     int WriteLength = 4;
-    memcpy(m_IndexDataPtr + m_CurrIndexByte, &Value, sizeof(unsigned int));
-    m_CurrIndexByte += WriteLength;
+    memcpy(Reader->m_IndexDataPtr + Reader->m_CurrIndexByte, &Value, sizeof(unsigned int));
+    Reader->m_CurrIndexByte += WriteLength;
   }
 
   return 1;
 }
 
-void PlyDataReader::releaseDataHandles()
-{
-  //m_VertexDataPtr = 0;
-  m_CurrVertexByte = 0;
-
-
-  //m_IndexDataPtr = 0;
-  m_CurrIndexByte = 0;
-}
-
 void PlyDataReader::PlyParserMessageHandlerProc(p_ply _pPlyObj, const char* _pMessage)
 {
   std::cout << "===> PLY Parser Message: " << _pMessage << std::endl;
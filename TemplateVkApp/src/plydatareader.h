@@ -1,65 +1,116 @@
+#pragma once
+
 #include "rply.h"
+#include "MappedFile.h"
 #include <stdio.h>
 #include <string.h>
 
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <vector>
 
-class PlyDataReaderDestructor;				//!< Forward Decleration
-
+// Reads one PLY file. Every reader has its own state, which reaches the rply callbacks through their
+// user data, so separate readers can load files on separate threads at the same time. A single
+// reader must not be used from two threads at once. The file is closed after readData() or
+// readPointData(), by the next readDataInfo() or when the reader is destroyed.
 class PlyDataReader
 {
-  friend PlyDataReaderDestructor;
 private:
-  static PlyDataReader* m_SingletonPtr;
-  static PlyDataReaderDestructor m_DestructorObject;
+  p_ply m_PlyParser;
+
+  uint64_t m_nVertices;
+  uint64_t m_nFaces;
+
+  char* m_VertexDataPtr;
+  size_t m_CurrVertexByte;
+  char* m_IndexDataPtr;
+  size_t m_CurrIndexByte;
 
-  static p_ply m_PlyParser;
+  char* m_PointDataPtr;
+  unsigned int m_PointStride;
+
+  MappedFile m_MappedFile;
+  size_t m_MappedDataOffset;
+  bool m_UseMemoryMapping;
+
+public:
+  // A part of the file from readBatches(), either vertices or whole faces. The vertices are laid out
+  // like in readData(), VertexStride bytes apart. The memory is reused for the next batch.
+  struct Batch
+  {
+    uint64_t FirstVertex;
+    uint64_t VertexCount;
+    const float* Vertices;
+    uint32_t VertexStride;
 
-  static unsigned int m_nVertices;
-  static unsigned int m_nFaces;
+    uint64_t FirstFace;
+    uint64_t FaceCount;
+    const unsigned int* Indices;
+    uint64_t IndexCount;
+  };
 
-  static char* m_VertexDataPtr;
-  static int m_CurrVertexByte;
-  static char* m_IndexDataPtr;
-  static int m_CurrIndexByte;
+  // Returns false to stop reading.
+  typedef std::function<bool(const Batch&)> BatchCallback;
 
 private:
+  // readBatches() state of the rply callbacks, m_BatchCallback is 0 outside of it.
+  const BatchCallback* m_BatchCallback;
+  uint64_t m_BatchVertices;
+  uint64_t m_BatchFaces;
+  uint64_t m_BatchFirstVertex;
+  uint64_t m_BatchFirstFace;
+  uint64_t m_BatchFaceCount;
+  uint32_t m_BatchVertexStride;
+  std::vector<char> m_BatchVertexStorage;
+  std::vector<unsigned int> m_BatchIndexStorage;
+
+  bool emitBatch(uint64_t _pFirstVertex, uint64_t _pVertexCount, uint64_t _pFirstFace, uint64_t _pFaceCount, size_t _pIndexCount);
+  bool flushVertexBatch();
+  bool flushFaceBatch();
+
+public:
   PlyDataReader();
   ~PlyDataReader();
 
-public:
-  static PlyDataReader* getSingletonPtr();
-  void readDataInfo(const char* _pFileName, void* _pUserDataPtr, const long int& _pUserDataLen);
+  PlyDataReader(const PlyDataReader&) = delete;
+  PlyDataReader& operator=(const PlyDataReader&) = delete;
+
+  // Reads the header. Returns false if the file cannot be opened or is not a PLY file. Files without
+  // a face element, like point clouds, report 0 faces.
+  bool readDataInfo(const char* _pFileName);
+
+  // Closes the file, readDataInfo() has to be called again before the next read.
+  void close();
 
-  unsigned int getNumVertices();
-  unsigned int getNumFaces();
+  // Files are mapped into memory by readDataInfo(), readData() and readPointData() then convert the
+  // records from the mapping straight into the caller's buffers, which may be mapped GPU memory.
+  // ASCII files are parsed on all cores from the mapping. On by default, without it the data is read
+  // through rply's file buffer.
+  void setMemoryMapping(bool _pEnabled);
 
+  uint64_t getNumVertices();
+  uint64_t getNumFaces();
+
+  // Reads x, y, z, nx, ny, nz as far as the file has them, as floats in the order of the file, and
+  // the face indices as unsigned ints. Binary files are decoded in blocks of records without the
+  // rply callbacks, mapped ASCII files in parallel with the same results as rply.
   void readData(void* _pVertexBuffer, void* _pIndexBuffer);
+
+  // Reads the vertices as points, _pStride bytes apart: x, y, z as floats followed by red, green,
+  // blue and alpha as bytes. Colors which are missing in the file are 255. Binary files take the
+  // same block decoder as readData().
+  void readPointData(void* _pPointBuffer, unsigned int _pStride);
+
+  // Reads the same data as readData() in batches of at most _pBatchVertices vertices or _pBatchFaces
+  // faces, so host memory stays at one batch whatever the size of the file and every batch can be
+  // uploaded as it arrives. False if the file ended early or the callback stopped the reading.
+  bool readBatches(uint64_t _pBatchVertices, uint64_t _pBatchFaces, const BatchCallback& _pCallback);
+
   static int VertexHandler(p_ply_argument _pArgument);
   static int FaceHandler(p_ply_argument _pArgument);
-  static void releaseDataHandles();
+  static int PointHandler(p_ply_argument _pArgument);
+  static int PointColorHandler(p_ply_argument _pArgument);
   static void PlyParserMessageHandlerProc(p_ply _pPlyObj, const char* _pMessage);
   static int getTypeLength(e_ply_type _pType);
 };
-
-class PlyDataReaderDestructor
-{
-private:
-  PlyDataReader* m_SingletonPtr;
-
-public:
-  PlyDataReaderDestructor()
-  {
-  }
-
-  void setSingletonPointer(PlyDataReader* _pSingletonPtr)
-  {
-    m_SingletonPtr = _pSingletonPtr;
-  }
-
-  ~PlyDataReaderDestructor()
-  {
-    delete m_SingletonPtr;
-  }
-};
\ No newline at end of file
@@ -97,7 +97,7 @@ static const char *const ply_type_list[] = {
        * ---------------------------------------------------------------------- */
 typedef struct t_ply_argument_ {
   p_ply_element element;
-  long instance_index;
+  long long instance_index;
   p_ply_property property;
   long length, value_index;
   double value;
@@ -135,7 +135,7 @@ typedef struct t_ply_property_ {
 * ---------------------------------------------------------------------- */
 typedef struct t_ply_element_ {
   char name[WORDSIZE];
-  long ninstances;
+  long long ninstances;
   p_ply_property property;
   long nproperties;
 } t_ply_element;
@@ -593,7 +593,7 @@ int ply_write_header(p_ply ply) {
     p_ply_element element = &ply->element[i];
     assert(element->property || element->nproperties == 0);
     assert(!element->property || element->nproperties > 0);
-    if (fprintf(ply->fp, "element %s %ld\n", element->name,
+    if (fprintf(ply->fp, "element %s %lld\n", element->name,
       element->ninstances) <= 0) goto error;
     for (j = 0; j < element->nproperties; j++) {
       p_ply_property property = &element->property[j];
@@ -660,6 +660,39 @@ int ply_write(p_ply ply, double value) {
   return !breakafter || putc('\n', ply->fp) > 0;
 }
 
+int ply_get_storage_mode(p_ply ply, e_ply_storage_mode *storage_mode) {
+  assert(ply && ply->io_mode == PLY_READ);
+  if (!ply->idriver) return 0;
+  if (storage_mode) *storage_mode = ply->storage_mode;
+  return 1;
+}
+
+size_t ply_read_raw(p_ply ply, void *anybuffer, size_t size) {
+  char *buffer = (char *)anybuffer;
+  size_t buffered = BSIZE(ply);
+  assert(ply && ply->fp && ply->io_mode == PLY_READ);
+  /* first what the header parser has read ahead, then the file */
+  if (buffered > size) buffered = size;
+  memcpy(buffer, BFIRST(ply), buffered);
+  BSKIP(ply, buffered);
+  if (buffered == size) return size;
+  return buffered + fread(buffer + buffered, 1, size - buffered, ply->fp);
+}
+
+int ply_get_data_offset(p_ply ply, long long *offset) {
+  long long position;
+  assert(ply && ply->fp && ply->io_mode == PLY_READ);
+#ifdef _WIN32
+  position = _ftelli64(ply->fp);
+#else
+  position = ftello(ply->fp);
+#endif
+  if (position < 0) return 0;
+  /* the header parser reads ahead into the buffer */
+  if (offset) *offset = position - (long long)BSIZE(ply);
+  return 1;
+}
+
 int ply_close(p_ply ply) {
   long i;
   assert(ply && ply->fp);
@@ -706,6 +739,12 @@ int ply_get_element_info(p_ply_element element, const char** name,
   return 1;
 }
 
+int ply_get_element_count(p_ply_element element, long long *ninstances) {
+  assert(element);
+  if (ninstances) *ninstances = element->ninstances;
+  return 1;
+}
+
 p_ply_property ply_get_next_property(p_ply_element element,
   p_ply_property last) {
   assert(element);
@@ -746,7 +785,7 @@ const char *ply_get_next_obj_info(p_ply ply, const char *last) {
 * Callback argument support functions
 * ---------------------------------------------------------------------- */
 int ply_get_argument_element(p_ply_argument argument,
-  p_ply_element *element, long *instance_index) {
+  p_ply_element *element, long long *instance_index) {
   assert(argument);
   if (!argument) return 0;
   if (element) *element = argument->element;
@@ -799,7 +838,7 @@ static int ply_read_list_property(p_ply ply, p_ply_element element,
   p_ply_ihandler handler = driver[property->length_type];
   double length;
   if (!handler(ply, &length)) {
-    ply_ferror(ply, "Error reading '%s' of '%s' number %d",
+    ply_ferror(ply, "Error reading '%s' of '%s' number %lld",
       property->name, element->name, argument->instance_index);
     return 0;
   }
@@ -819,7 +858,7 @@ static int ply_read_list_property(p_ply ply, p_ply_element element,
     argument->value_index = l;
     if (!handler(ply, &argument->value)) {
       ply_ferror(ply, "Error reading value number %d of '%s' of "
-        "'%s' number %d", l + 1, property->name,
+        "'%s' number %lld", l + 1, property->name,
         element->name, argument->instance_index);
       return 0;
     }
@@ -840,7 +879,7 @@ static int ply_read_scalar_property(p_ply ply, p_ply_element element,
   argument->length = 1;
   argument->value_index = 0;
   if (!handler(ply, &argument->value)) {
-    ply_ferror(ply, "Error reading '%s' of '%s' number %d",
+    ply_ferror(ply, "Error reading '%s' of '%s' number %lld",
       property->name, element->name, argument->instance_index);
     return 0;
   }
@@ -861,7 +900,8 @@ static int ply_read_property(p_ply ply, p_ply_element element,
 
 static int ply_read_element(p_ply ply, p_ply_element element,
   p_ply_argument argument) {
-  long j, k;
+  long long j;
+  long k;
   /* for each element of this type */
   for (j = 0; j < element->ninstances; j++) {
     argument->instance_index = j;
@@ -1232,7 +1272,7 @@ static int ply_read_header_property(p_ply ply) {
 
 static int ply_read_header_element(p_ply ply) {
   p_ply_element element = NULL;
-  long dummy;
+  long long dummy;
   assert(ply && ply->fp && ply->io_mode == PLY_READ);
   if (strcmp(BWORD(ply), "element")) return 0;
   /* allocate room for new element */
@@ -1243,7 +1283,7 @@ static int ply_read_header_element(p_ply ply) {
   strcpy(element->name, BWORD(ply));
   /* get number of elements of this type */
   if (!ply_read_word(ply)) return 0;
-  if (sscanf(BWORD(ply), "%ld", &dummy) != 1) {
+  if (sscanf(BWORD(ply), "%lld", &dummy) != 1 || dummy < 0) {
     ply_ferror(ply, "Expected number got '%s'", BWORD(ply));
     return 0;
   }
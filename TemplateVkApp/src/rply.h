@@ -9,6 +9,8 @@
 * at the end of this file.
 * ---------------------------------------------------------------------- */
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -116,7 +118,7 @@ extern "C" {
   * Returns 1 if successfull, 0 otherwise
   * ---------------------------------------------------------------------- */
   int ply_get_argument_element(p_ply_argument argument,
-    p_ply_element *element, long *instance_index);
+    p_ply_element *element, long long *instance_index);
 
   /* ----------------------------------------------------------------------
   * Returns information about the property originating a callback
@@ -206,6 +208,17 @@ extern "C" {
   int ply_get_element_info(p_ply_element element, const char** name,
     long *ninstances);
 
+  /* ----------------------------------------------------------------------
+  * Returns the number of instances of an element, which may not fit into
+  * the long of ply_get_element_info
+  *
+  * element: handle returned by ply_get_next_element
+  * ninstances: receives the number of instances
+  *
+  * Returns 1 if successfull, 0 otherwise
+  * ---------------------------------------------------------------------- */
+  int ply_get_element_count(p_ply_element element, long long *ninstances);
+
   /* ----------------------------------------------------------------------
   * Iterates over all properties by returning the next property.
   * Call with NULL to return handle to first property.
@@ -337,6 +350,39 @@ extern "C" {
   * ---------------------------------------------------------------------- */
   int ply_write(p_ply ply, double value);
 
+  /* ----------------------------------------------------------------------
+  * Gets the storage mode of a file after its header was read
+  *
+  * ply: handle returned by ply_open
+  * storage_mode: receives PLY_ASCII, PLY_BIG_ENDIAN or PLY_LITTLE_ENDIAN
+  *
+  * Returns 1 if successfull, 0 otherwise
+  * ---------------------------------------------------------------------- */
+  int ply_get_storage_mode(p_ply ply, e_ply_storage_mode *storage_mode);
+
+  /* ----------------------------------------------------------------------
+  * Reads the data section without decoding it, for readers which decode
+  * binary elements themselves. Call after ply_read_header instead of
+  * ply_read.
+  *
+  * ply: handle returned by ply_open
+  * buffer: receives up to size bytes
+  *
+  * Returns the number of bytes read, less than size at the end of the file
+  * ---------------------------------------------------------------------- */
+  size_t ply_read_raw(p_ply ply, void *buffer, size_t size);
+
+  /* ----------------------------------------------------------------------
+  * Gets the position of the data section in the file, for readers which
+  * map the file. Call after ply_read_header, before reading any data.
+  *
+  * ply: handle returned by ply_open
+  * offset: receives the byte offset of the first data byte
+  *
+  * Returns 1 if successfull, 0 otherwise
+  * ---------------------------------------------------------------------- */
+  int ply_get_data_offset(p_ply ply, long long *offset);
+
   /* ----------------------------------------------------------------------
   * Closes a PLY file handle. Releases all memory used by handle
   *
@@ -2,6 +2,7 @@
 #include "HelloTriangleApp.h"
 #include "ShaderHelper.h"
 #include "VkHelper.h"
+#include "../../TemplateVkApp/src/VertexWelder.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -902,7 +903,7 @@ void HelloTriangleApp::createCommandBuffers()
 		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, descSets, 0, nullptr);
 		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, buffers, offsets);
-		vkCmdBindIndexBuffer(cmdBuffer, mesh->indexBufferId, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdBindIndexBuffer(cmdBuffer, mesh->indexBufferId, 0, mesh->getIndexType());
 		vkCmdDrawIndexed(cmdBuffer, static_cast<uint32_t>(mesh->getIndexCount()), 1, 0, 0, 0);
 
 		vkCmdEndRenderPass(cmdBuffer);
@@ -1112,23 +1113,6 @@ void HelloTriangleApp::drawFrame()
 	}
 }
 
-#include <unordered_map>
-#include <glm/gtx/hash.hpp>
-
-namespace std
-{
-	template<> struct hash<Mesh3D::Vertex>
-	{
-		size_t operator()(const Mesh3D::Vertex& vertex) const
-		{
-			return 
-				((std::hash<glm::vec3>()(vertex.pos) ^
-				(std::hash<glm::vec3>()(vertex.color) << 1)) >> 1)  ^
-				(std::hash<glm::vec2>()(vertex.texCoord) << 1);
-		}
-	};
-};
-
 void HelloTriangleApp::loadMesh()
 {
 	//mesh = std::make_unique<ScreenSpaceMesh>(device);
@@ -1147,7 +1131,6 @@ void HelloTriangleApp::loadMesh()
 	std::vector<Mesh3D::Vertex> vertices;
 	std::vector<uint32_t> indices;
 
-#if 1
 	auto nVertices = attrib.vertices.size() / 3;
 	auto nTexCoords = attrib.texcoords.size() / 2;
 
@@ -1155,62 +1138,42 @@ void HelloTriangleApp::loadMesh()
 	assert(nTexCoords * 2 == attrib.texcoords.size() && "The number of texture coordinates is not even.");
 	assert(nVertices == nTexCoords && "The number of vertices and texture coordinates are not the same.");
 
-	std::map<std::pair<uint32_t, uint32_t>, uint32_t> vertexIndexMap;
-	for (const auto& shape : shapes)
+	// A vertex is a pair of position and texture coordinate index.
+	struct VertexKey
 	{
-		for (const auto& idx : shape.mesh.indices)
-		{
-			auto vIdx = idx.vertex_index;
-			auto tIdx = idx.texcoord_index;
-			auto pair = std::make_pair(vIdx, tIdx);
-			if (vertexIndexMap.find(pair) == vertexIndexMap.end())
-			{
-				Mesh3D::Vertex vertex;
-
-				vertex.pos.x = attrib.vertices[3 * vIdx + 0];
-				vertex.pos.z = attrib.vertices[3 * vIdx + 1];
-				vertex.pos.y = attrib.vertices[3 * vIdx + 2];
-
-				vertex.texCoord.x = attrib.texcoords[2 * tIdx + 0];
-				vertex.texCoord.y = 1.0f - attrib.texcoords[2 * tIdx + 1];
-
-				vertex.color = glm::vec3(1.0f, 1.0f, 1.0f);
-
-				vertexIndexMap[pair] = vertices.size();
-				vertices.push_back(vertex);
-			}
-
-			indices.push_back(vertexIndexMap[pair]);
-		}
-	}
-#else
-	std::unordered_map<Mesh3D::Vertex, int> vertexIndexMap;
+		int vertexIndex;
+		int texcoordIndex;
+	};
 
+	std::vector<VertexKey> keys;
 	for (const auto& shape : shapes)
 	{
 		for (const auto& idx : shape.mesh.indices)
 		{
-			Mesh3D::Vertex vertex;
+			keys.push_back({ idx.vertex_index, idx.texcoord_index });
+		}
+	}
 
-			vertex.pos.x = attrib.vertices[3 * idx.vertex_index + 0];
-			vertex.pos.z = attrib.vertices[3 * idx.vertex_index + 1];
-			vertex.pos.y = attrib.vertices[3 * idx.vertex_index + 2];
+	VertexWelder<VertexKey> welder;
+	uint32_t nWelded = welder.weld(keys.data(), keys.size());
 
-			vertex.texCoord.x = attrib.texcoords[2 * idx.texcoord_index + 0];
-			vertex.texCoord.y = 1.0f - attrib.texcoords[2 * idx.texcoord_index + 1];
+	vertices.resize(nWelded);
+	for (uint32_t w = 0; w < nWelded; ++w)
+	{
+		const VertexKey& key = keys[welder.getUniques()[w]];
+		Mesh3D::Vertex& vertex = vertices[w];
 
-			vertex.color = glm::vec3(1.0f, 1.0f, 1.0f);
+		vertex.pos.x = attrib.vertices[3 * key.vertexIndex + 0];
+		vertex.pos.z = attrib.vertices[3 * key.vertexIndex + 1];
+		vertex.pos.y = attrib.vertices[3 * key.vertexIndex + 2];
 
-			if (vertexIndexMap.count(vertex) == 0)
-			{
-				vertexIndexMap[vertex] = vertices.size();
-				vertices.push_back(vertex);
-			}	
+		vertex.texCoord.x = attrib.texcoords[2 * key.texcoordIndex + 0];
+		vertex.texCoord.y = 1.0f - attrib.texcoords[2 * key.texcoordIndex + 1];
 
-			indices.push_back(vertexIndexMap[vertex]);
-		}
+		vertex.color = glm::vec3(1.0f, 1.0f, 1.0f);
 	}
-#endif
+
+	indices = welder.getRemap();
 
 	std::cout	<< "======================\n"
 				<< "== Mesh Info:\n"
@@ -96,7 +96,12 @@ size_t ScreenSpaceMesh::getIndexCount()
 
 size_t ScreenSpaceMesh::getIndexStide()
 {
-	return sizeof(uint32_t);
+	return sizeof(uint16_t);
+}
+
+VkIndexType ScreenSpaceMesh::getIndexType()
+{
+	return VK_INDEX_TYPE_UINT16;
 }
 
 // ===============================================================
@@ -117,7 +122,7 @@ Mesh3D::Mesh3D(const VkDeleter<VkDevice>& device) : Mesh(device)
 		{ { -0.5f, -0.2f, -0.5f, },{ 0.5f, 0.5f, 0.5f },{ 0.0f, 0.0f } },
 	};
 
-	indices = {
+	indices16 = {
 		0, 1, 2, 2, 3, 0,
 		4, 5, 6, 6, 7, 4
 	};
@@ -165,6 +170,8 @@ const void * Mesh3D::getVertices() const
 
 const void * Mesh3D::getIndices() const
 {
+	if (indices.empty())
+		return indices16.data();
 	return indices.data();
 }
 
@@ -180,12 +187,17 @@ size_t Mesh3D::getVertexStride()
 
 size_t Mesh3D::getIndexCount()
 {
-	return indices.size();
+	return indices.empty() ? indices16.size() : indices.size();
 }
 
 size_t Mesh3D::getIndexStide()
 {
-	return sizeof(uint32_t);
+	return indices.empty() ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+VkIndexType Mesh3D::getIndexType()
+{
+	return indices.empty() ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
 }
 
 void Mesh3D::setVertices(const std::vector<Vertex>& _vertices)
@@ -195,5 +207,11 @@ void Mesh3D::setVertices(const std::vector<Vertex>& _vertices)
 
 void Mesh3D::setIndices(const std::vector<uint32_t>& _indices)
 {
-	indices = _indices;
+	indices16.clear();
+	indices.clear();
+
+	if (vertices.size() <= 65536)
+		indices16.assign(_indices.begin(), _indices.end());
+	else
+		indices = _indices;
 }
@@ -20,6 +20,7 @@ public:
 	virtual size_t getVertexStride() = 0;
 	virtual size_t getIndexCount() = 0;
 	virtual size_t getIndexStide() = 0;
+	virtual VkIndexType getIndexType() = 0;
 
 	VkDeleter<VkDeviceMemory> vertexBufferMem;
 	VkDeleter<VkBuffer> vertexBufferId;
@@ -49,6 +50,7 @@ public:
 
 	size_t getIndexCount() override;
 	size_t getIndexStide() override;
+	VkIndexType getIndexType() override;
 
 	struct Vertex
 	{
@@ -58,7 +60,7 @@ public:
 
 private:
 	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
+	std::vector<uint16_t> indices;
 };
 
 class Mesh3D : public Mesh
@@ -78,6 +80,7 @@ public:
 
 	size_t getIndexCount() override;
 	size_t getIndexStide() override;
+	VkIndexType getIndexType() override;
 
 	struct Vertex
 	{
@@ -92,9 +95,14 @@ public:
 	};
 
 	void setVertices(const std::vector<Vertex>& _vertices);
+
+	// Stored as 16-bit indices when the vertices set before allow it.
 	void setIndices(const std::vector<uint32_t>& _indices);
 
 private:
 	std::vector<Vertex> vertices;
+
+	// Only one of them is used: 16-bit indices address up to 65536 vertices with half the memory.
+	std::vector<uint16_t> indices16;
 	std::vector<uint32_t> indices;
 };
\ No newline at end of file